@@ -0,0 +1,110 @@
+/*********************************************************************
+-------------------------- END-OF-HEADER -----------------------------
+File    : Ascii2Usage.c
+Purpose : ASCII to keyboard usage ID lookup (US layout).
+
+Additional information:
+  Every 7-bit ASCII character is an index into a table of modifier and
+  usage ID, a lookup takes constant time. The module has no target
+  dependencies, Host/Ascii2Usage_Bench.c compares it with the linear
+  scan of the original sample.
+*/
+
+/*********************************************************************
+*
+*       #include section
+*
+**********************************************************************
+*/
+#include <stddef.h>
+#include "Ascii2Usage.h"
+
+/*********************************************************************
+*
+*       Defines, fixed
+*
+**********************************************************************
+*/
+#define KEY(Usage)              { 0u,                     (unsigned char)(Usage) }
+#define KEY_SHIFT(Usage)        { ASCII2USAGE_MOD_LSHIFT, (unsigned char)(Usage) }
+
+/*********************************************************************
+*
+*       Static const data
+*
+**********************************************************************
+*/
+
+/*********************************************************************
+*
+*       _aAscii2Usage
+*
+*  Maps every 7-bit ASCII character to modifier and usage ID
+*  of a US keyboard layout. Characters without a key have Usage == 0.
+*/
+static const ASCII_TO_USAGE _aAscii2Usage[128] = {
+  ['\b']  = KEY(0x2A),        ['\t']  = KEY(0x2B),        ['\n']  = KEY(0x28),
+  ['\r']  = KEY(0x28),        [0x1B]  = KEY(0x29),        [0x7F]  = KEY(0x4C),
+  [' ']   = KEY(0x2C),
+  ['a']   = KEY(0x04),        ['b']   = KEY(0x05),        ['c']   = KEY(0x06),
+  ['d']   = KEY(0x07),        ['e']   = KEY(0x08),        ['f']   = KEY(0x09),
+  ['g']   = KEY(0x0A),        ['h']   = KEY(0x0B),        ['i']   = KEY(0x0C),
+  ['j']   = KEY(0x0D),        ['k']   = KEY(0x0E),        ['l']   = KEY(0x0F),
+  ['m']   = KEY(0x10),        ['n']   = KEY(0x11),        ['o']   = KEY(0x12),
+  ['p']   = KEY(0x13),        ['q']   = KEY(0x14),        ['r']   = KEY(0x15),
+  ['s']   = KEY(0x16),        ['t']   = KEY(0x17),        ['u']   = KEY(0x18),
+  ['v']   = KEY(0x19),        ['w']   = KEY(0x1A),        ['x']   = KEY(0x1B),
+  ['y']   = KEY(0x1C),        ['z']   = KEY(0x1D),
+  ['A']   = KEY_SHIFT(0x04),  ['B']   = KEY_SHIFT(0x05),  ['C']   = KEY_SHIFT(0x06),
+  ['D']   = KEY_SHIFT(0x07),  ['E']   = KEY_SHIFT(0x08),  ['F']   = KEY_SHIFT(0x09),
+  ['G']   = KEY_SHIFT(0x0A),  ['H']   = KEY_SHIFT(0x0B),  ['I']   = KEY_SHIFT(0x0C),
+  ['J']   = KEY_SHIFT(0x0D),  ['K']   = KEY_SHIFT(0x0E),  ['L']   = KEY_SHIFT(0x0F),
+  ['M']   = KEY_SHIFT(0x10),  ['N']   = KEY_SHIFT(0x11),  ['O']   = KEY_SHIFT(0x12),
+  ['P']   = KEY_SHIFT(0x13),  ['Q']   = KEY_SHIFT(0x14),  ['R']   = KEY_SHIFT(0x15),
+  ['S']   = KEY_SHIFT(0x16),  ['T']   = KEY_SHIFT(0x17),  ['U']   = KEY_SHIFT(0x18),
+  ['V']   = KEY_SHIFT(0x19),  ['W']   = KEY_SHIFT(0x1A),  ['X']   = KEY_SHIFT(0x1B),
+  ['Y']   = KEY_SHIFT(0x1C),  ['Z']   = KEY_SHIFT(0x1D),
+  ['1']   = KEY(0x1E),        ['2']   = KEY(0x1F),        ['3']   = KEY(0x20),
+  ['4']   = KEY(0x21),        ['5']   = KEY(0x22),        ['6']   = KEY(0x23),
+  ['7']   = KEY(0x24),        ['8']   = KEY(0x25),        ['9']   = KEY(0x26),
+  ['0']   = KEY(0x27),
+  ['!']   = KEY_SHIFT(0x1E),  ['@']   = KEY_SHIFT(0x1F),  ['#']   = KEY_SHIFT(0x20),
+  ['$']   = KEY_SHIFT(0x21),  ['%']   = KEY_SHIFT(0x22),  ['^']   = KEY_SHIFT(0x23),
+  ['&']   = KEY_SHIFT(0x24),  ['*']   = KEY_SHIFT(0x25),  ['(']   = KEY_SHIFT(0x26),
+  [')']   = KEY_SHIFT(0x27),
+  ['-']   = KEY(0x2D),        ['_']   = KEY_SHIFT(0x2D),  ['=']   = KEY(0x2E),
+  ['+']   = KEY_SHIFT(0x2E),  ['[']   = KEY(0x2F),        ['{']   = KEY_SHIFT(0x2F),
+  [']']   = KEY(0x30),        ['}']   = KEY_SHIFT(0x30),  ['\\']  = KEY(0x31),
+  ['|']   = KEY_SHIFT(0x31),  [';']   = KEY(0x33),        [':']   = KEY_SHIFT(0x33),
+  ['\'']  = KEY(0x34),        ['"']   = KEY_SHIFT(0x34),  ['`']   = KEY(0x35),
+  ['~']   = KEY_SHIFT(0x35),  [',']   = KEY(0x36),        ['<']   = KEY_SHIFT(0x36),
+  ['.']   = KEY(0x37),        ['>']   = KEY_SHIFT(0x37),  ['/']   = KEY(0x38),
+  ['?']   = KEY_SHIFT(0x38)
+};
+
+/*********************************************************************
+*
+*       Public code
+*
+**********************************************************************
+*/
+
+/*********************************************************************
+*
+*       ASCII2USAGE_Get
+*
+*  Function description
+*    Returns modifier and usage ID of a character.
+*
+*  Return value
+*    != NULL: Table entry, Usage == 0 if no key produces the character.
+*    == NULL: Not a 7-bit ASCII character.
+*/
+const ASCII_TO_USAGE * ASCII2USAGE_Get(unsigned char c) {
+  if (c >= sizeof(_aAscii2Usage) / sizeof(_aAscii2Usage[0])) {
+    return NULL;
+  }
+  return &_aAscii2Usage[c];
+}
+
+/*************************** End of file ****************************/
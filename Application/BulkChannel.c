@@ -0,0 +1,253 @@
+/*********************************************************************
+-------------------------- END-OF-HEADER -----------------------------
+File    : BulkChannel.c
+Purpose : Double buffered bulk transfer state machine of the bulk benchmark.
+
+Additional information:
+  Each channel (one endpoint direction) owns two buffers. While one
+  buffer is transferred by the USB stack, the other one is filled (IN)
+  or consumed (OUT) by the task. The completion of a transfer, reported
+  from the USB interrupt, starts the transfer of the other buffer right
+  away, so the endpoint only NAKs if the task falls behind.
+
+  The USB interrupt only moves buffers out of BULK_BUFFER_BUSY and
+  starts the next transfer, so the task may look at its buffer with
+  BULK_CHANNEL_GetTaskBuffer() without locking. All other task calls
+  have to lock out the USB interrupt (USB_OS_IncDI()/USB_OS_DecRI()).
+
+  The module has no target dependencies: the transfer is started by a
+  callback and time stamps are passed in. The host test in Host/ runs
+  it against a simulated endpoint.
+*/
+
+/*********************************************************************
+*
+*       #include section
+*
+**********************************************************************
+*/
+#include <string.h>
+#include "BulkChannel.h"
+
+/*********************************************************************
+*
+*       Static code
+*
+**********************************************************************
+*/
+
+/*********************************************************************
+*
+*       _StartTransfer
+*
+*  Function description
+*    Starts the transfer of the buffer at USBIndex if it is ready (IN)
+*    or free (OUT). Must be called with the USB interrupt locked out
+*    or from within the USB interrupt.
+*/
+static void _StartTransfer(BULK_CHANNEL * pChannel, unsigned long Now) {
+  unsigned Index;
+
+  Index = pChannel->USBIndex;
+  if ((pChannel->IsBusy != 0u) || (pChannel->IsStopped != 0u)) {
+    return;
+  }
+  if (pChannel->aState[Index] != (pChannel->InDir ? BULK_BUFFER_READY : BULK_BUFFER_FREE)) {
+    return;
+  }
+  pChannel->aState[Index] = BULK_BUFFER_BUSY;
+  pChannel->IsBusy        = 1;
+  pChannel->StartTime     = Now;
+  pChannel->pfStart(pChannel, pChannel->pBuffer + Index * pChannel->NumBytesPerBuffer, pChannel->NumBytesPerBuffer);
+}
+
+/*********************************************************************
+*
+*       Public code
+*
+**********************************************************************
+*/
+
+/*********************************************************************
+*
+*       BULK_CHANNEL_Init
+*
+*  Function description
+*    Initializes a channel with all buffers owned by the task.
+*
+*  Parameters
+*    pChannel          : Channel to initialize.
+*    InDir             : 1: IN (device to host), 0: OUT.
+*    pBuffer           : BULK_CHANNEL_NUM_BUFFERS * NumBytesPerBuffer bytes.
+*    NumBytesPerBuffer : Transfer size, a multiple of the max. packet size.
+*    TicksPerUs        : Time stamp ticks per microsecond.
+*    pfStart           : Starts a transfer on the endpoint.
+*    pContext          : User context, stored in pChannel->pContext.
+*/
+void BULK_CHANNEL_Init(BULK_CHANNEL * pChannel, unsigned InDir, unsigned char * pBuffer, unsigned NumBytesPerBuffer, unsigned long TicksPerUs, BULK_START_FUNC * pfStart, void * pContext) {
+  memset(pChannel, 0, sizeof(*pChannel));
+  pChannel->pBuffer           = pBuffer;
+  pChannel->NumBytesPerBuffer = NumBytesPerBuffer;
+  pChannel->InDir             = InDir;
+  pChannel->TicksPerUs        = TicksPerUs;
+  pChannel->pfStart           = pfStart;
+  pChannel->pContext          = pContext;
+}
+
+/*********************************************************************
+*
+*       BULK_CHANNEL_OnComplete
+*
+*  Function description
+*    Reports the end of the transfer in flight. Called from the
+*    completion callback in the USB interrupt.
+*
+*  Parameters
+*    pChannel : Channel of the endpoint.
+*    Status   : 0: Transfer complete, else failed.
+*    NumBytes : Number of bytes transferred.
+*    Now      : Time stamp.
+*
+*  Additional information
+*    On a failed transfer (bus reset, disconnect) the buffer is given
+*    back to the task and the channel stops until the task restarts it
+*    once the device is configured again. Without the stop, a buffer
+*    submitted in between would be sent ahead of an older one.
+*/
+void BULK_CHANNEL_OnComplete(BULK_CHANNEL * pChannel, int Status, unsigned NumBytes, unsigned long Now) {
+  unsigned Index;
+
+  Index            = pChannel->USBIndex;
+  pChannel->IsBusy = 0;
+  if (Status != 0) {
+    pChannel->aState[Index] = BULK_BUFFER_FREE;
+    pChannel->IsStopped     = 1;
+    BULK_CHANNEL_CountTransfer(pChannel, -1, 0);
+  } else {
+    BULK_CHANNEL_CountTransfer(pChannel, (int)NumBytes, Now - pChannel->StartTime);
+    if (pChannel->InDir) {
+      pChannel->aState[Index] = BULK_BUFFER_FREE;
+    } else {
+      pChannel->aNumBytes[Index] = NumBytes;
+      pChannel->aState[Index]    = BULK_BUFFER_READY;
+    }
+    pChannel->USBIndex = (Index + 1u) % BULK_CHANNEL_NUM_BUFFERS;
+    _StartTransfer(pChannel, Now);
+  }
+}
+
+/*********************************************************************
+*
+*       BULK_CHANNEL_GetTaskBuffer
+*
+*  Function description
+*    Returns the next buffer the task has to fill (IN) or to consume (OUT).
+*
+*  Parameters
+*    pChannel  : Channel.
+*    pNumBytes : OUT: Receives the number of bytes in the buffer. May be NULL.
+*
+*  Return value
+*    != NULL: Buffer owned by the task, hand it back with BULK_CHANNEL_Submit().
+*    == NULL: The task has nothing to do.
+*/
+unsigned char * BULK_CHANNEL_GetTaskBuffer(const BULK_CHANNEL * pChannel, unsigned * pNumBytes) {
+  unsigned Index;
+
+  Index = pChannel->TaskIndex;
+  if (pChannel->aState[Index] != (pChannel->InDir ? BULK_BUFFER_FREE : BULK_BUFFER_READY)) {
+    return NULL;
+  }
+  if (pNumBytes != NULL) {
+    *pNumBytes = pChannel->InDir ? pChannel->NumBytesPerBuffer : pChannel->aNumBytes[Index];
+  }
+  return pChannel->pBuffer + Index * pChannel->NumBytesPerBuffer;
+}
+
+/*********************************************************************
+*
+*       BULK_CHANNEL_Submit
+*
+*  Function description
+*    Hands the buffer returned by BULK_CHANNEL_GetTaskBuffer() to the
+*    USB stack and starts its transfer if the endpoint is idle.
+*    Must be called with the USB interrupt locked out.
+*/
+void BULK_CHANNEL_Submit(BULK_CHANNEL * pChannel, unsigned long Now) {
+  unsigned Index;
+
+  Index                   = pChannel->TaskIndex;
+  pChannel->aState[Index] = pChannel->InDir ? BULK_BUFFER_READY : BULK_BUFFER_FREE;
+  pChannel->TaskIndex     = (Index + 1u) % BULK_CHANNEL_NUM_BUFFERS;
+  _StartTransfer(pChannel, Now);
+}
+
+/*********************************************************************
+*
+*       BULK_CHANNEL_Restart
+*
+*  Function description
+*    Returns all buffers to the task after a failed transfer and
+*    restarts the channel. Called by the task when the device has been
+*    configured, with the USB interrupt locked out. Buffers the task
+*    has filled but the stack has not sent are dropped.
+*/
+void BULK_CHANNEL_Restart(BULK_CHANNEL * pChannel, unsigned long Now) {
+  unsigned i;
+
+  if (pChannel->IsBusy == 0u) {
+    for (i = 0; i < BULK_CHANNEL_NUM_BUFFERS; i++) {
+      pChannel->aState[i] = BULK_BUFFER_FREE;
+    }
+    pChannel->TaskIndex = 0;
+    pChannel->USBIndex  = 0;
+    pChannel->IsStopped = 0;
+    _StartTransfer(pChannel, Now);       // OUT only, an IN transfer needs a filled buffer.
+  }
+}
+
+/*********************************************************************
+*
+*       BULK_CHANNEL_CountTransfer
+*
+*  Function description
+*    Adds a transfer to the statistics.
+*
+*  Parameters
+*    pChannel : Channel.
+*    NumBytes : Number of bytes transferred, < 0 for a failed transfer.
+*    Ticks    : Duration of the transfer in time stamp ticks.
+*/
+void BULK_CHANNEL_CountTransfer(BULK_CHANNEL * pChannel, int NumBytes, unsigned long Ticks) {
+  unsigned long Us;
+  unsigned      Bucket;
+
+  if (NumBytes < 0) {
+    pChannel->Stats.NumErrors++;
+    return;
+  }
+  Us     = Ticks / pChannel->TicksPerUs;
+  Bucket = 0;
+  while ((Us > 1u) && (Bucket < BULK_CHANNEL_NUM_BUCKETS - 1u)) {
+    Us >>= 1;
+    Bucket++;
+  }
+  pChannel->Stats.aNumLatency[Bucket]++;
+  pChannel->Stats.NumBytes += (unsigned long)NumBytes;
+  pChannel->Stats.NumTransfers++;
+}
+
+/*********************************************************************
+*
+*       BULK_CHANNEL_GetStats
+*
+*  Function description
+*    Copies the statistics and resets them. Must be called with the
+*    USB interrupt locked out.
+*/
+void BULK_CHANNEL_GetStats(BULK_CHANNEL * pChannel, BULK_STATS * pStats) {
+  *pStats = pChannel->Stats;
+  memset(&pChannel->Stats, 0, sizeof(pChannel->Stats));
+}
+
+/*************************** End of file ****************************/
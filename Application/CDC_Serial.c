@@ -0,0 +1,588 @@
+/*********************************************************************
+-------------------------- END-OF-HEADER -----------------------------
+File    : CDC_Serial.c
+Purpose : CDC-ACM virtual COM port with a zero-copy transmit ring.
+
+Additional information:
+  All data for the host goes through one ring buffer. Producers
+  either reserve space in the ring, write into it in place and
+  commit it (CDC_SERIAL_Reserve() / CDC_SERIAL_Commit()), or copy
+  data with CDC_SERIAL_Write() / CDC_SERIAL_Write1().
+
+  The bulk IN endpoint is fed with USBD_WriteAsync() directly from
+  the ring. Each transfer covers the whole contiguous span between
+  read and write position, so the driver copies the data from the
+  ring into the USB FIFO and no intermediate buffer is needed.
+  The completion callback runs in the USB interrupt, frees the span
+  and starts the next one. Data written while the endpoint is idle is
+  started by the writer if it may call the USB stack (see below), else
+  by the start-of-frame callback within 1 ms.
+
+  The read and write callbacks follow BSP_UART.c, so the port can
+  replace the UART for embOSView (OS_VIEW_IFSELECT = OS_VIEW_IF_USB_CDC
+  in RTOSInit_STM32F4xx.c).
+
+  Locking:
+    The ring is shared between tasks, the USB interrupt and other
+    embOS interrupts (e.g. embOSView on the UART), so it is locked
+    with OS_INT_IncDI() / OS_INT_DecRI(), which works in every context
+    and never blocks. USB_OS_IncDI() can not be used for this: with
+    USBD_OS_USE_USBD_X_INTERRUPT it does nothing in any interrupt and
+    takes a mutex in a task, which is illegal inside embOS, where
+    OS_COM_Send1() calls CDC_SERIAL_Write1().
+    The USB stack itself is only called from the OTG_FS interrupt and
+    from tasks:
+      CDC_SERIAL_Write()      Tasks and interrupts. Starts the transfer
+                              from a task or the OTG_FS interrupt.
+      CDC_SERIAL_Write1()     Tasks, interrupts and embOS internals.
+                              Starts the transfer and calls the write
+                              callback only in the OTG_FS interrupt.
+      CDC_SERIAL_Reserve()
+      CDC_SERIAL_Commit()     One task.
+    While a reservation is open, CDC_SERIAL_Write() writes nothing and
+    CDC_SERIAL_Write1() keeps one byte aside which is appended on
+    commit, so embOSView is never blocked by a producer.
+
+  Data written while no host has configured the device is discarded
+  and counted (CDC_SERIAL_GetNumBytesDropped()).
+*/
+
+/*********************************************************************
+*
+*       #include section
+*
+**********************************************************************
+*/
+#include <string.h>
+#include "RTOS.h"
+#include "USB.h"
+#include "USB_CDC.h"
+#include "BSP_USB.h"
+#include "CDC_Serial.h"
+#include "stm32f4xx.h"
+
+/*********************************************************************
+*
+*       Defines, configurable
+*
+**********************************************************************
+*/
+//
+// Size of the transmit ring in bytes, must be a power of 2.
+// Should be several times the amount of data the host fetches per
+// frame. USB 2.0 allows up to 19 bulk packets of 64 bytes per
+// full-speed frame, how much a host actually fetches has not been
+// measured.
+//
+#ifndef CDC_SERIAL_BUFFER_SIZE
+#define CDC_SERIAL_BUFFER_SIZE   4096u
+#endif
+
+#if (CDC_SERIAL_BUFFER_SIZE & (CDC_SERIAL_BUFFER_SIZE - 1u)) != 0u
+  #error "CDC_SERIAL_BUFFER_SIZE must be a power of 2"
+#endif
+
+/*********************************************************************
+*
+*       Defines, fixed
+*
+**********************************************************************
+*/
+#define RING_MASK                (CDC_SERIAL_BUFFER_SIZE - 1u)
+//
+// The notification endpoint only carries SERIAL_STATE (10 bytes).
+//
+#define EP_INT_MAX_PACKET_SIZE   16u
+#define EP_INT_INTERVAL          64u      // In units of 125 us, 8 ms.
+
+/*********************************************************************
+*
+*       Static data
+*
+**********************************************************************
+*/
+static U8                   _abRing[CDC_SERIAL_BUFFER_SIZE];
+static volatile U32         _WrPos;               // Free running, only changed with embOS interrupts disabled.
+static volatile U32         _RdPos;               // Free running, only changed with embOS interrupts disabled.
+static volatile U8          _IsReserved;          // A Reserve/Commit pair is open.
+static volatile U8          _IsTxBusy;            // A span of the ring is transferred.
+static volatile U8          _HasPendingChar;
+static U8                   _PendingChar;         // Byte of CDC_SERIAL_Write1() during an open reservation.
+static volatile U8          _IsTxCBActive;        // The write callback has more data to send.
+static volatile U8          _IsInTxCB;            // The write callback is being served, also a recursion guard.
+static volatile U32         _NumBytesDropped;
+static unsigned             _EPIn;
+static unsigned             _EPOut;
+static USB_ASYNC_IO_CONTEXT _TxContext;
+static USB_ASYNC_IO_CONTEXT _RxContext;
+static U8                   _abRxBuffer[USB_FS_BULK_MAX_PACKET_SIZE];
+static volatile U8          _IsRxActive;
+static CDC_SERIAL_RX_CB   * _pfOnRx;
+static CDC_SERIAL_TX_CB   * _pfOnTx;
+static USB_HOOK             _UsbStateHook;
+static USB_SOF_CALLBACK_HOOK _SofHook;
+
+/*********************************************************************
+*
+*       Static code
+*
+**********************************************************************
+*/
+
+/*********************************************************************
+*
+*       _IsConfigured
+*/
+static int _IsConfigured(void) {
+  return (USBD_GetState() & (USB_STAT_CONFIGURED | USB_STAT_SUSPENDED)) == USB_STAT_CONFIGURED;
+}
+
+/*********************************************************************
+*
+*       _IsInUSBInt
+*
+*  Function description
+*    Returns != 0 if called from the OTG_FS interrupt, which is the
+*    only interrupt allowed to call the USB stack.
+*/
+static int _IsInUSBInt(void) {
+  return __get_IPSR() == (U32)((int)OTG_FS_IRQn + 16);
+}
+
+/*********************************************************************
+*
+*       _GetNumFree
+*/
+static unsigned _GetNumFree(void) {
+  return CDC_SERIAL_BUFFER_SIZE - (unsigned)(_WrPos - _RdPos);
+}
+
+/*********************************************************************
+*
+*       _StartTx
+*
+*  Function description
+*    Starts the transfer of the contiguous span at the read position.
+*    Must be called from a task or from within the USB interrupt.
+*/
+static void _StartTx(void) {
+  unsigned Off;
+  unsigned NumBytes;
+
+  OS_INT_IncDI();
+  NumBytes = (unsigned)(_WrPos - _RdPos);
+  if ((_IsTxBusy != 0u) || (NumBytes == 0u)) {
+    OS_INT_DecRI();
+    return;
+  }
+  if (_IsConfigured() == 0) {
+    _NumBytesDropped += NumBytes;
+    _RdPos            = _WrPos;
+    OS_INT_DecRI();
+    return;
+  }
+  Off = _RdPos & RING_MASK;
+  if (NumBytes > CDC_SERIAL_BUFFER_SIZE - Off) {
+    NumBytes = CDC_SERIAL_BUFFER_SIZE - Off;       // Up to the end of the ring, the rest follows with the next transfer.
+  }
+  _IsTxBusy = 1;                                   // Claims the endpoint, the span stays owned by it until completion.
+  OS_INT_DecRI();
+  _TxContext.pData              = &_abRing[Off];
+  _TxContext.NumBytesToTransfer = NumBytes;
+  USBD_WriteAsync(_EPIn, &_TxContext, 1);
+}
+
+/*********************************************************************
+*
+*       _Put1
+*
+*  Function description
+*    Appends one byte. Ring must have space, embOS interrupts disabled.
+*/
+static void _Put1(U8 Data) {
+  _abRing[_WrPos & RING_MASK] = Data;
+  _WrPos++;
+}
+
+/*********************************************************************
+*
+*       _FillFromTxCB
+*
+*  Function description
+*    Appends the byte kept aside during a reservation and fetches
+*    data from the write callback while the ring has space.
+*    Must be called from a task or from within the USB interrupt.
+*/
+static void _FillFromTxCB(void) {
+  OS_INT_IncDI();
+  if ((_IsReserved != 0u) || (_IsInTxCB != 0u)) {
+    OS_INT_DecRI();
+    return;
+  }
+  _IsInTxCB = 1;
+  if ((_HasPendingChar != 0u) && (_GetNumFree() != 0u)) {
+    _Put1(_PendingChar);
+    _HasPendingChar = 0;
+  }
+  OS_INT_DecRI();
+  if (_pfOnTx != NULL) {
+    while ((_IsTxCBActive != 0u) && (_GetNumFree() != 0u)) {
+      if (_pfOnTx() != 0) {                        // Calls CDC_SERIAL_Write1() unless done.
+        _IsTxCBActive = 0;
+      }
+    }
+  }
+  _IsInTxCB = 0;
+}
+
+/*********************************************************************
+*
+*       _OnTxComplete
+*
+*  Function description
+*    Completion callback of USBD_WriteAsync(). Runs in the USB interrupt.
+*
+*  Additional information
+*    On a failed transfer (bus reset, disconnect) the ring content is
+*    stale and is discarded.
+*/
+static void _OnTxComplete(USB_ASYNC_IO_CONTEXT_POI pContext) {
+  OS_INT_IncDI();
+  _IsTxBusy = 0;
+  if (pContext->Status == 0) {
+    _RdPos += pContext->NumBytesTransferred;
+  } else {
+    _NumBytesDropped += (U32)(_WrPos - _RdPos);
+    _RdPos            = _WrPos;
+  }
+  OS_INT_DecRI();
+  _FillFromTxCB();
+  _StartTx();
+}
+
+/*********************************************************************
+*
+*       _OnSOF
+*
+*  Function description
+*    Start-of-frame callback. Runs in the USB interrupt once per frame
+*    and sends what has been written from contexts which may not call
+*    the USB stack.
+*/
+static void _OnSOF(void * pContext) {
+  USB_USE_PARA(pContext);
+  if ((_IsTxCBActive != 0u) || (_HasPendingChar != 0u)) {
+    _FillFromTxCB();
+  }
+  if (_IsTxBusy == 0u) {
+    _StartTx();
+  }
+}
+
+/*********************************************************************
+*
+*       _StartRx
+*
+*  Function description
+*    Arms the bulk OUT endpoint. Runs in the USB interrupt.
+*/
+static void _StartRx(void) {
+  if (_IsRxActive == 0u) {
+    _IsRxActive                   = 1;
+    _RxContext.pData              = _abRxBuffer;
+    _RxContext.NumBytesToTransfer = sizeof(_abRxBuffer);
+    USBD_ReadAsync(_EPOut, &_RxContext, 1);
+  }
+}
+
+/*********************************************************************
+*
+*       _OnRxComplete
+*
+*  Function description
+*    Completion callback of USBD_ReadAsync(). Runs in the USB interrupt.
+*    Passes the received bytes to the read callback and re-arms the
+*    endpoint. A failed read is restarted by _OnStateChange().
+*/
+static void _OnRxComplete(USB_ASYNC_IO_CONTEXT_POI pContext) {
+  const U8 * pData;
+  unsigned   NumBytes;
+
+  _IsRxActive = 0;
+  if (pContext->Status != 0) {
+    return;
+  }
+  pData    = (const U8 *)pContext->pData;
+  NumBytes = pContext->NumBytesTransferred;
+  if (_pfOnRx != NULL) {
+    while (NumBytes--) {
+      _pfOnRx(*pData++);
+    }
+  }
+  _StartRx();
+}
+
+/*********************************************************************
+*
+*       _OnStateChange
+*
+*  Function description
+*    Arms the bulk OUT endpoint when the device has been configured.
+*/
+static void _OnStateChange(void * pContext, U8 NewState) {
+  USB_USE_PARA(pContext);
+  if ((NewState & (USB_STAT_CONFIGURED | USB_STAT_SUSPENDED)) == USB_STAT_CONFIGURED) {
+    _StartRx();
+  }
+}
+
+/*********************************************************************
+*
+*       Public code
+*
+**********************************************************************
+*/
+
+/*********************************************************************
+*
+*       CDC_SERIAL_Add
+*
+*  Function description
+*    Adds the CDC-ACM interfaces to the USB stack.
+*
+*  Additional information
+*    Must be called after USBD_Init() and before USBD_Start().
+*    The communication and the data interface are grouped by an
+*    interface association descriptor, so the port can be combined
+*    with other interfaces.
+*/
+void CDC_SERIAL_Add(void) {
+  static U8           _abOutBuffer[USB_FS_BULK_MAX_PACKET_SIZE];
+  USB_CDC_INIT_DATA   InitData;
+  USB_ADD_EP_INFO     EPBulkIn;
+  USB_ADD_EP_INFO     EPBulkOut;
+  USB_ADD_EP_INFO     EPIntIn;
+
+  memset(&InitData, 0, sizeof(InitData));
+  EPBulkIn.Flags          = 0;                             // Flags not used.
+  EPBulkIn.InDir          = USB_DIR_IN;                    // IN direction (Device to Host)
+  EPBulkIn.Interval       = 0;                             // Interval not used for Bulk endpoints.
+  EPBulkIn.MaxPacketSize  = USB_FS_BULK_MAX_PACKET_SIZE;   // Maximum packet size (64 for Bulk in full-speed).
+  EPBulkIn.TransferType   = USB_TRANSFER_TYPE_BULK;        // Endpoint type - Bulk.
+  InitData.EPIn  = (U8)USBD_AddEPEx(&EPBulkIn, NULL, 0);
+  BSP_USB_FIFO_AddEP(USB_DIR_IN, EPBulkIn.MaxPacketSize);
+
+  EPBulkOut.Flags         = 0;                             // Flags not used.
+  EPBulkOut.InDir         = USB_DIR_OUT;                   // OUT direction (Host to Device)
+  EPBulkOut.Interval      = 0;                             // Interval not used for Bulk endpoints.
+  EPBulkOut.MaxPacketSize = USB_FS_BULK_MAX_PACKET_SIZE;   // Maximum packet size (64 for Bulk in full-speed).
+  EPBulkOut.TransferType  = USB_TRANSFER_TYPE_BULK;        // Endpoint type - Bulk.
+  InitData.EPOut = (U8)USBD_AddEPEx(&EPBulkOut, _abOutBuffer, sizeof(_abOutBuffer));
+  BSP_USB_FIFO_AddEP(USB_DIR_OUT, EPBulkOut.MaxPacketSize);
+
+  EPIntIn.Flags           = 0;                             // Flags not used.
+  EPIntIn.InDir           = USB_DIR_IN;                    // IN direction (Device to Host)
+  EPIntIn.Interval        = EP_INT_INTERVAL;               // In units of 125 us, converted to frames by the stack.
+  EPIntIn.MaxPacketSize   = EP_INT_MAX_PACKET_SIZE;        // Large enough for SERIAL_STATE notifications.
+  EPIntIn.TransferType    = USB_TRANSFER_TYPE_INT;         // Endpoint type - Interrupt.
+  InitData.EPInt = (U8)USBD_AddEPEx(&EPIntIn, NULL, 0);
+  BSP_USB_FIFO_AddEP(USB_DIR_IN, EPIntIn.MaxPacketSize);
+
+  _EPIn                    = InitData.EPIn;
+  _EPOut                   = InitData.EPOut;
+  _TxContext.pfOnComplete  = _OnTxComplete;
+  _RxContext.pfOnComplete  = _OnRxComplete;
+  USBD_EnableIAD();
+  USBD_CDC_Add(&InitData);
+  USBD_RegisterSCHook(&_UsbStateHook, _OnStateChange, NULL);
+  USBD_SetOnSOF(_OnSOF, 1, NULL, &_SofHook);
+}
+
+/*********************************************************************
+*
+*       CDC_SERIAL_Reserve
+*
+*  Function description
+*    Reserves contiguous space in the transmit ring.
+*
+*  Parameters
+*    ppData  : Receives the start of the reserved space.
+*    NumBytes: Number of bytes requested.
+*
+*  Return value
+*    Number of bytes reserved, may be less than NumBytes at the end of
+*    the ring or if the ring is almost full. 0 if nothing is free.
+*
+*  Additional information
+*    Every successful call must be followed by CDC_SERIAL_Commit().
+*    Must be called from a task.
+*/
+unsigned CDC_SERIAL_Reserve(U8 ** ppData, unsigned NumBytes) {
+  unsigned Off;
+  unsigned NumFree;
+
+  OS_INT_IncDI();
+  Off     = _WrPos & RING_MASK;
+  NumFree = _GetNumFree();
+  if (NumFree > CDC_SERIAL_BUFFER_SIZE - Off) {
+    NumFree = CDC_SERIAL_BUFFER_SIZE - Off;
+  }
+  if (NumBytes > NumFree) {
+    NumBytes = NumFree;
+  }
+  if (NumBytes != 0u) {
+    _IsReserved = 1;
+    *ppData     = &_abRing[Off];
+  }
+  OS_INT_DecRI();
+  return NumBytes;
+}
+
+/*********************************************************************
+*
+*       CDC_SERIAL_Commit
+*
+*  Function description
+*    Publishes data written into space returned by CDC_SERIAL_Reserve().
+*
+*  Parameters
+*    NumBytes: Number of bytes written, at most the number reserved.
+*
+*  Additional information
+*    Must be called from a task.
+*/
+void CDC_SERIAL_Commit(unsigned NumBytes) {
+  OS_INT_IncDI();
+  _WrPos      += NumBytes;
+  _IsReserved  = 0;
+  OS_INT_DecRI();
+  _FillFromTxCB();
+  _StartTx();
+}
+
+/*********************************************************************
+*
+*       CDC_SERIAL_Write
+*
+*  Function description
+*    Copies data into the transmit ring without waiting.
+*
+*  Return value
+*    Number of bytes written. Less than NumBytes if the ring is full
+*    or a reservation is open.
+*
+*  Additional information
+*    May be called from tasks and interrupts. The data is copied with
+*    embOS interrupts disabled. Called from a task or the OTG_FS
+*    interrupt, the transfer is started right away, else with the
+*    next start of frame.
+*/
+unsigned CDC_SERIAL_Write(const void * pData, unsigned NumBytes) {
+  const U8 * p;
+  unsigned   NumBytesWritten;
+  unsigned   NumBytesToCopy;
+  unsigned   Off;
+  unsigned   NumBytesAtOnce;
+
+  p               = (const U8 *)pData;
+  NumBytesWritten = 0;
+  OS_INT_IncDI();
+  if (_IsReserved == 0u) {
+    NumBytesToCopy = NumBytes;
+    if (NumBytesToCopy > _GetNumFree()) {
+      NumBytesToCopy = _GetNumFree();
+    }
+    while (NumBytesWritten < NumBytesToCopy) {
+      Off            = _WrPos & RING_MASK;
+      NumBytesAtOnce = NumBytesToCopy - NumBytesWritten;
+      if (NumBytesAtOnce > CDC_SERIAL_BUFFER_SIZE - Off) {
+        NumBytesAtOnce = CDC_SERIAL_BUFFER_SIZE - Off;
+      }
+      memcpy(&_abRing[Off], p + NumBytesWritten, NumBytesAtOnce);
+      _WrPos          += NumBytesAtOnce;
+      NumBytesWritten += NumBytesAtOnce;
+    }
+  }
+  _NumBytesDropped += NumBytes - NumBytesWritten;
+  OS_INT_DecRI();
+  if ((OS_INT_InInterrupt() == 0) || _IsInUSBInt()) {
+    _StartTx();
+  }
+  return NumBytesWritten;
+}
+
+/*********************************************************************
+*
+*       CDC_SERIAL_Write1
+*
+*  Function description
+*    Writes one byte into the transmit ring without waiting.
+*
+*  Additional information
+*    Starts a transmission: The write callback is then called until it
+*    reports that it has nothing more to send, the same way BSP_UART.c
+*    calls it from the TX interrupt. This is how embOS (OS_COM_Send1())
+*    sends messages.
+*
+*    May be called from any context, including embOS internals, and
+*    never blocks: Only the OTG_FS interrupt serves the write callback
+*    and starts the transfer right away, other callers leave this to
+*    the next start of frame.
+*/
+void CDC_SERIAL_Write1(unsigned char Data) {
+  OS_INT_IncDI();
+  if ((_IsReserved != 0u) || (_GetNumFree() == 0u)) {
+    if (_HasPendingChar == 0u) {
+      _PendingChar    = Data;
+      _HasPendingChar = 1;
+    } else {
+      _NumBytesDropped++;
+    }
+  } else {
+    _Put1(Data);
+  }
+  if (_pfOnTx != NULL) {
+    _IsTxCBActive = 1;                 // Harmless from within the callback, which then keeps running.
+  }
+  OS_INT_DecRI();
+  if ((_IsInTxCB == 0u) && _IsInUSBInt()) {
+    _FillFromTxCB();
+    _StartTx();
+  }
+}
+
+/*********************************************************************
+*
+*       CDC_SERIAL_SetReadCallback
+*
+*  Function description
+*    Sets the function called for each byte received from the host.
+*/
+void CDC_SERIAL_SetReadCallback(CDC_SERIAL_RX_CB * pf) {
+  _pfOnRx = pf;
+}
+
+/*********************************************************************
+*
+*       CDC_SERIAL_SetWriteCallback
+*
+*  Function description
+*    Sets the function called when the ring can take more data.
+*/
+void CDC_SERIAL_SetWriteCallback(CDC_SERIAL_TX_CB * pf) {
+  _pfOnTx = pf;
+}
+
+/*********************************************************************
+*
+*       CDC_SERIAL_GetNumBytesDropped
+*
+*  Function description
+*    Returns the number of bytes discarded because the ring was full
+*    or no host was attached.
+*/
+U32 CDC_SERIAL_GetNumBytesDropped(void) {
+  return _NumBytesDropped;
+}
+
+/*************************** End of file ****************************/
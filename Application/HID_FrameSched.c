@@ -0,0 +1,278 @@
+/*********************************************************************
+-------------------------- END-OF-HEADER -----------------------------
+File    : HID_FrameSched.c
+Purpose : Schedules HID input reports relative to the host's polls
+          of an interrupt IN endpoint.
+
+Additional information:
+  A task which sends reports whenever it wakes up hits the poll of
+  the host at a random point of the poll interval. The time between
+  the report being ready and the host fetching it therefore varies
+  by up to one poll interval.
+
+  The scheduler counts the start-of-frame interrupts (USBD_SetOnSOF())
+  and learns the frames in which the host polls from the completion
+  of the transfers. A full-speed host runs the periodic transfers at
+  the start of a frame, so a report queued shortly before the SOF of
+  a poll frame is fetched right after that SOF. On request of the
+  producer, HID_SCHED_RequestSlot(), a one-shot timer (BSP_TIMER.c)
+  signals the producer task LeadUs before that SOF. The producer then
+  builds the report from the latest input and queues it with
+  HID_SCHED_Put().
+
+  The timer interrupt (TIM2) preempts the USB interrupt, see BSP_IRQ.h.
+  It therefore only sets a task event and never runs application code
+  which might call the stack or the report queue.
+
+  For every report queued into an empty queue, the time until the
+  host fetched it is counted in a histogram which HID_SCHED_Export()
+  sends to SystemView.
+
+  The scheduler installs itself as the "on sent" callback of the
+  report queue and calls the callback set before HID_SCHED_Init().
+*/
+
+/*********************************************************************
+*
+*       #include section
+*
+**********************************************************************
+*/
+#include <string.h>
+#include "USB.h"
+#include "HID_FrameSched.h"
+#include "BSP_USB.h"
+#include "BSP_TIMER.h"
+#include "SEGGER_SYSVIEW.h"
+#include "stm32f4xx.h"
+
+/*********************************************************************
+*
+*       Defines, fixed
+*
+**********************************************************************
+*/
+#define FRAME_US                1000u   // Full-speed frame.
+
+/*********************************************************************
+*
+*       Static data
+*
+**********************************************************************
+*/
+static unsigned _NumInstances;
+
+/*********************************************************************
+*
+*       Static code
+*
+**********************************************************************
+*/
+
+/*********************************************************************
+*
+*       _OnSlot
+*
+*  Function description
+*    One-shot timer callback, runs in the TIM2 interrupt.
+*    Wakes the producer task.
+*/
+static void _OnSlot(void * pContext) {
+  HID_SCHED * pSched;
+
+  pSched = (HID_SCHED *)pContext;
+  if (pSched->pSlotTask != NULL) {
+    OS_TASKEVENT_Set(pSched->pSlotTask, pSched->SlotEvent);
+  }
+}
+
+/*********************************************************************
+*
+*       _OnSOF
+*
+*  Function description
+*    Start-of-frame callback, runs in the USB interrupt. Starts the
+*    slot timer in the frame before the next expected poll.
+*/
+static void _OnSOF(void * pContext) {
+  HID_SCHED * pSched;
+  U32         ElapsedUs;
+  unsigned    Phase;
+
+  pSched = (HID_SCHED *)pContext;
+  Phase  = pSched->Phase + 1u;
+  if (Phase >= pSched->IntervalFrames) {
+    Phase = 0;
+  }
+  pSched->Phase = Phase;
+  if ((pSched->IsSlotRequested != 0u) && (Phase + 1u >= pSched->IntervalFrames)) {
+    pSched->IsSlotRequested = 0;
+    //
+    // The timer is relative to the SOF, the time the USB interrupt
+    // took to get here is subtracted.
+    //
+    ElapsedUs = (DWT->CYCCNT - BSP_USB_GetISRTimeStamp()) / (SystemCoreClock / 1000000u);
+    if (ElapsedUs + pSched->LeadUs < FRAME_US) {
+      if (BSP_TIMER_Start(FRAME_US - pSched->LeadUs - ElapsedUs, _OnSlot, pSched) >= 0) {
+        return;
+      }
+    }
+    _OnSlot(pSched);                       // Too late or no timer available, signal right away.
+  }
+}
+
+/*********************************************************************
+*
+*       _OnSent
+*
+*  Function description
+*    "On sent" callback of the report queue, runs in the USB interrupt.
+*    A completed transfer marks the current frame as poll frame.
+*/
+static void _OnSent(void * pContext, int Status) {
+  HID_SCHED * pSched;
+  U32         Us;
+  unsigned    Bucket;
+
+  pSched = (HID_SCHED *)pContext;
+  if (pSched->IsMeasuring != 0u) {
+    pSched->IsMeasuring = 0;
+    if (Status == 0) {
+      Us     = (DWT->CYCCNT - pSched->ReadyCycles) / (SystemCoreClock / 1000000u);
+      Bucket = 0;
+      while ((Us > 1u) && (Bucket < HID_SCHED_NUM_BUCKETS - 1u)) {
+        Us >>= 1;
+        Bucket++;
+      }
+      pSched->aNumReady2In[Bucket]++;
+#if HID_SCHED_USE_SYSVIEW
+      SEGGER_SYSVIEW_MarkStop(pSched->MarkerId);
+#endif
+    }
+  }
+  if (Status == 0) {
+    pSched->Phase = 0;
+  }
+  if (pSched->pfOnSent != NULL) {
+    pSched->pfOnSent(pSched->pOnSentContext, Status);
+  }
+}
+
+/*********************************************************************
+*
+*       Public code
+*
+**********************************************************************
+*/
+
+/*********************************************************************
+*
+*       HID_SCHED_Init
+*
+*  Function description
+*    Initializes a scheduler for a report queue.
+*
+*  Parameters
+*    pSched     : Scheduler to initialize.
+*    pQueue     : Initialized report queue of the interrupt IN endpoint.
+*    IntervalUs : Actual poll interval of the endpoint in microseconds.
+*    LeadUs     : Time of the slot before the start of the poll frame,
+*                 less than one frame.
+*
+*  Additional information
+*    Must be called before USBD_Start().
+*/
+void HID_SCHED_Init(HID_SCHED * pSched, HID_REPORT_QUEUE * pQueue, unsigned IntervalUs, unsigned LeadUs) {
+  memset(pSched, 0, sizeof(*pSched));
+  pSched->pQueue         = pQueue;
+  pSched->IntervalFrames = (IntervalUs < FRAME_US) ? 1u : IntervalUs / FRAME_US;
+  pSched->LeadUs         = LeadUs;
+  pSched->MarkerId       = HID_SCHED_MARKER_ID + _NumInstances++;
+  pSched->pfOnSent       = pQueue->pfOnSent;
+  pSched->pOnSentContext = pQueue->pOnSentContext;
+  HID_RQ_SetOnSent(pQueue, _OnSent, pSched);
+  USBD_SetOnSOF(_OnSOF, 1, pSched, &pSched->SofHook);
+}
+
+/*********************************************************************
+*
+*       HID_SCHED_SetSlotTask
+*
+*  Function description
+*    Sets the task event which signals a requested slot to the producer.
+*
+*  Parameters
+*    pSched : Scheduler.
+*    pTask  : Producer task, usually the one calling HID_SCHED_Put().
+*    Event  : Task event set once per requested slot.
+*/
+void HID_SCHED_SetSlotTask(HID_SCHED * pSched, OS_TASK * pTask, OS_TASKEVENT Event) {
+  USB_OS_IncDI();
+  pSched->SlotEvent = Event;
+  pSched->pSlotTask = pTask;
+  USB_OS_DecRI();
+}
+
+/*********************************************************************
+*
+*       HID_SCHED_RequestSlot
+*
+*  Function description
+*    Requests one call of the slot callback before the next poll.
+*/
+void HID_SCHED_RequestSlot(HID_SCHED * pSched) {
+  pSched->IsSlotRequested = 1;
+}
+
+/*********************************************************************
+*
+*       HID_SCHED_Put
+*
+*  Function description
+*    Queues a report, see HID_RQ_Put(). If the queue was empty, the
+*    time until the host fetches the report is measured.
+*/
+int HID_SCHED_Put(HID_SCHED * pSched, const void * pReport) {
+  int r;
+
+  USB_OS_IncDI();
+  if (HID_RQ_GetDepth(pSched->pQueue) == 0u) {
+    pSched->ReadyCycles = DWT->CYCCNT;
+    pSched->IsMeasuring = 1;
+#if HID_SCHED_USE_SYSVIEW
+    SEGGER_SYSVIEW_MarkStart(pSched->MarkerId);
+#endif
+  }
+  r = HID_RQ_Put(pSched->pQueue, pReport);
+  USB_OS_DecRI();
+  return r;
+}
+
+/*********************************************************************
+*
+*       HID_SCHED_Export
+*
+*  Function description
+*    Sends the report-ready to IN-token histogram to SystemView
+*    and clears it.
+*
+*  Parameters
+*    pSched : Scheduler.
+*    sName  : Shown in front of each line, e.g. the interface name.
+*/
+void HID_SCHED_Export(HID_SCHED * pSched, const char * sName) {
+  U32      aNum[HID_SCHED_NUM_BUCKETS];
+  unsigned i;
+
+  USB_OS_IncDI();
+  memcpy(aNum, pSched->aNumReady2In, sizeof(aNum));
+  memset(pSched->aNumReady2In, 0, sizeof(pSched->aNumReady2In));
+  USB_OS_DecRI();
+  for (i = 0; i < HID_SCHED_NUM_BUCKETS; i++) {
+    if (aNum[i] != 0u) {
+      SEGGER_SYSVIEW_PrintfTarget("%s ready to IN: %u us: %u", sName, 1u << i, (unsigned)aNum[i]);
+    }
+  }
+}
+
+/*************************** End of file ****************************/
@@ -0,0 +1,272 @@
+/*********************************************************************
+-------------------------- END-OF-HEADER -----------------------------
+File    : HID_ReportQueue.c
+Purpose : Non-blocking queue of HID input reports.
+
+Additional information:
+  Reports are copied into a ring of fixed size slots and sent with
+  USBD_WriteAsync() on the interrupt IN endpoint of the HID instance.
+  The completion callback runs in the USB interrupt and starts the
+  transfer of the next queued report, so the producer never waits
+  for the host to poll the endpoint.
+
+  HID_RQ_Put() must be called from task context only. It locks out
+  the USB interrupt with USB_OS_IncDI() / USB_OS_DecRI() while the
+  ring is modified. The completion callback runs inside the USB
+  interrupt and therefore needs no lock.
+
+  While a transfer is in flight, a new report may be merged into the
+  last queued report by an optional coalesce function (e.g. adding up
+  relative mouse movements).
+
+  Every report put into a slot gets the next sequence number. A
+  producer can remember HID_RQ_GetQueuedSeq() after queuing a report
+  and compare it with HID_RQ_GetSentSeq() to learn when the host has
+  fetched it. Reports dropped on a failed transfer are never sent.
+*/
+
+/*********************************************************************
+*
+*       #include section
+*
+**********************************************************************
+*/
+#include <string.h>
+#include "USB.h"
+#include "HID_ReportQueue.h"
+
+/*********************************************************************
+*
+*       Static code
+*
+**********************************************************************
+*/
+
+/*********************************************************************
+*
+*       _StartNext
+*
+*  Function description
+*    Starts the transfer of the report at RdIndex.
+*    Must be called with the USB interrupt locked out or from
+*    within the USB interrupt.
+*/
+static void _StartNext(HID_REPORT_QUEUE * pQueue) {
+  USB_ASYNC_IO_CONTEXT * pContext;
+
+  pContext                     = &pQueue->AsyncContext;
+  pContext->pData              = &pQueue->pBuffer[pQueue->RdIndex * pQueue->ReportSize];
+  pContext->NumBytesToTransfer = pQueue->ReportSize;
+  pQueue->IsBusy               = 1;
+  USBD_WriteAsync(pQueue->EPIndex, pContext, 0);
+}
+
+/*********************************************************************
+*
+*       _OnComplete
+*
+*  Function description
+*    Completion callback of USBD_WriteAsync(). Runs in the USB interrupt.
+*
+*  Additional information
+*    On a failed transfer (bus reset, disconnect, endpoint halted)
+*    all queued reports are stale and are dropped. Restarting a
+*    transfer from here would fail again immediately.
+*/
+static void _OnComplete(USB_ASYNC_IO_CONTEXT_POI pContext) {
+  HID_REPORT_QUEUE * pQueue;
+
+  pQueue         = (HID_REPORT_QUEUE *)pContext->pContext;
+  pQueue->IsBusy = 0;
+  if (pContext->Status == 0) {
+    pQueue->Stats.NumSent++;
+    pQueue->SentSeq = pQueue->QueuedSeq - (pQueue->Depth - 1u);
+    pQueue->RdIndex++;
+    if (pQueue->RdIndex == pQueue->NumReports) {
+      pQueue->RdIndex = 0;
+    }
+    pQueue->Depth--;
+    if (pQueue->Depth != 0u) {
+      _StartNext(pQueue);
+    }
+  } else {
+    pQueue->Stats.NumDropped += pQueue->Depth;
+    pQueue->RdIndex           = pQueue->WrIndex;
+    pQueue->Depth             = 0;
+  }
+  if (pQueue->pfOnSent != NULL) {
+    pQueue->pfOnSent(pQueue->pOnSentContext, pContext->Status);
+  }
+}
+
+/*********************************************************************
+*
+*       Public code
+*
+**********************************************************************
+*/
+
+/*********************************************************************
+*
+*       HID_RQ_Init
+*
+*  Function description
+*    Initializes a report queue.
+*
+*  Parameters
+*    pQueue     : Queue to initialize.
+*    EPIndex    : Interrupt IN endpoint of the HID instance (returned by USBD_AddEPEx()).
+*    pBuffer    : Storage for NumReports reports of ReportSize bytes each.
+*    ReportSize : Size of one report in bytes.
+*    NumReports : Number of report slots in pBuffer.
+*/
+void HID_RQ_Init(HID_REPORT_QUEUE * pQueue, unsigned EPIndex, U8 * pBuffer, unsigned ReportSize, unsigned NumReports) {
+  memset(pQueue, 0, sizeof(*pQueue));
+  pQueue->pBuffer                   = pBuffer;
+  pQueue->ReportSize                = ReportSize;
+  pQueue->NumReports                = NumReports;
+  pQueue->EPIndex                   = EPIndex;
+  pQueue->AsyncContext.pfOnComplete = _OnComplete;
+  pQueue->AsyncContext.pContext     = pQueue;
+}
+
+/*********************************************************************
+*
+*       HID_RQ_SetCoalesceFunc
+*
+*  Function description
+*    Sets the function used to merge a report into the last queued report.
+*/
+void HID_RQ_SetCoalesceFunc(HID_REPORT_QUEUE * pQueue, HID_RQ_COALESCE_FUNC * pf) {
+  pQueue->pfCoalesce = pf;
+}
+
+/*********************************************************************
+*
+*       HID_RQ_SetOnSent
+*
+*  Function description
+*    Sets a callback which is called from the USB interrupt whenever
+*    a slot of the queue becomes free.
+*/
+void HID_RQ_SetOnSent(HID_REPORT_QUEUE * pQueue, HID_RQ_ON_SENT_FUNC * pf, void * pContext) {
+  pQueue->pOnSentContext = pContext;
+  pQueue->pfOnSent       = pf;
+}
+
+/*********************************************************************
+*
+*       HID_RQ_Put
+*
+*  Function description
+*    Queues a report without waiting.
+*
+*  Parameters
+*    pQueue  : Queue to add the report to.
+*    pReport : Report of ReportSize bytes. Copied, may be reused on return.
+*
+*  Return value
+*    == 0: Report queued.
+*    == 1: Report merged into a report which is not yet in flight.
+*    <  0: Queue full, report dropped.
+*/
+int HID_RQ_Put(HID_REPORT_QUEUE * pQueue, const void * pReport) {
+  unsigned Index;
+  int      r;
+
+  USB_OS_IncDI();
+  //
+  // The newest report can only be changed while it is not in flight.
+  //
+  if ((pQueue->pfCoalesce != NULL) && (pQueue->Depth > (unsigned)pQueue->IsBusy)) {
+    Index = (pQueue->WrIndex == 0u) ? pQueue->NumReports - 1u : pQueue->WrIndex - 1u;
+    if (pQueue->pfCoalesce(&pQueue->pBuffer[Index * pQueue->ReportSize], (const U8 *)pReport, pQueue->ReportSize) != 0) {
+      pQueue->Stats.NumCoalesced++;
+      USB_OS_DecRI();
+      return 1;
+    }
+  }
+  if (pQueue->Depth == pQueue->NumReports) {
+    pQueue->Stats.NumDropped++;
+    r = -1;
+  } else {
+    memcpy(&pQueue->pBuffer[pQueue->WrIndex * pQueue->ReportSize], pReport, pQueue->ReportSize);
+    pQueue->WrIndex++;
+    if (pQueue->WrIndex == pQueue->NumReports) {
+      pQueue->WrIndex = 0;
+    }
+    pQueue->Depth++;
+    pQueue->QueuedSeq++;
+    pQueue->Stats.NumQueued++;
+    if (pQueue->Depth > pQueue->Stats.MaxDepth) {
+      pQueue->Stats.MaxDepth = pQueue->Depth;
+    }
+    if (pQueue->IsBusy == 0u) {
+      _StartNext(pQueue);
+    }
+    r = 0;
+  }
+  USB_OS_DecRI();
+  return r;
+}
+
+/*********************************************************************
+*
+*       HID_RQ_GetDepth
+*
+*  Function description
+*    Returns the number of queued reports, including the one in flight.
+*/
+unsigned HID_RQ_GetDepth(const HID_REPORT_QUEUE * pQueue) {
+  return pQueue->Depth;
+}
+
+/*********************************************************************
+*
+*       HID_RQ_GetNumFree
+*
+*  Function description
+*    Returns the number of free report slots.
+*/
+unsigned HID_RQ_GetNumFree(const HID_REPORT_QUEUE * pQueue) {
+  return pQueue->NumReports - pQueue->Depth;
+}
+
+/*********************************************************************
+*
+*       HID_RQ_GetStats
+*
+*  Function description
+*    Returns a consistent copy of the queue counters.
+*/
+void HID_RQ_GetStats(const HID_REPORT_QUEUE * pQueue, HID_RQ_STATS * pStats) {
+  USB_OS_IncDI();
+  *pStats = pQueue->Stats;
+  USB_OS_DecRI();
+}
+
+/*********************************************************************
+*
+*       HID_RQ_GetQueuedSeq
+*
+*  Function description
+*    Returns the sequence number of the newest report put into a slot,
+*    0 if none has been queued yet.
+*/
+U32 HID_RQ_GetQueuedSeq(const HID_REPORT_QUEUE * pQueue) {
+  return pQueue->QueuedSeq;
+}
+
+/*********************************************************************
+*
+*       HID_RQ_GetSentSeq
+*
+*  Function description
+*    Returns the sequence number of the last report fetched by the host,
+*    0 if none has been sent yet. May be called from the "on sent" callback.
+*/
+U32 HID_RQ_GetSentSeq(const HID_REPORT_QUEUE * pQueue) {
+  return pQueue->SentSeq;
+}
+
+/*************************** End of file ****************************/
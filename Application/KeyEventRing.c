@@ -0,0 +1,115 @@
+/*********************************************************************
+-------------------------- END-OF-HEADER -----------------------------
+File    : KeyEventRing.c
+Purpose : Lock-free single-producer/single-consumer ring of key events.
+
+Additional information:
+  The producer is the key interrupt, the consumer the keyboard task.
+  Only indices are shared: the producer alone writes WrPos and the
+  consumer alone writes RdPos, so neither LDREX/STREX nor locking
+  the interrupt is needed. An event is written completely before
+  WrPos is published, and read completely before RdPos frees the
+  slot, each ordered by KEY_RING_BARRIER().
+
+  The module has no target dependencies and is built on the host
+  by the stress test in Host/.
+*/
+
+/*********************************************************************
+*
+*       #include section
+*
+**********************************************************************
+*/
+#include "KeyEventRing.h"
+
+/*********************************************************************
+*
+*       Public code
+*
+**********************************************************************
+*/
+
+/*********************************************************************
+*
+*       KEY_RING_Init
+*
+*  Function description
+*    Initializes an empty ring.
+*
+*  Parameters
+*    pRing     : Ring to initialize.
+*    paEvent   : Storage for NumEvents events.
+*    NumEvents : Number of events, must be a power of 2.
+*/
+void KEY_RING_Init(KEY_RING * pRing, KEY_EVENT * paEvent, unsigned NumEvents) {
+  pRing->paEvent    = paEvent;
+  pRing->NumEvents  = NumEvents;
+  pRing->WrPos      = 0;
+  pRing->RdPos      = 0;
+  pRing->NumDropped = 0;
+}
+
+/*********************************************************************
+*
+*       KEY_RING_Put
+*
+*  Function description
+*    Stores an event. Called by the producer only.
+*
+*  Return value
+*    ==  0: Event stored.
+*    == -1: Ring full, the event has been dropped and counted.
+*/
+int KEY_RING_Put(KEY_RING * pRing, const KEY_EVENT * pEvent) {
+  unsigned WrPos;
+
+  WrPos = pRing->WrPos;
+  if ((WrPos - pRing->RdPos) >= pRing->NumEvents) {
+    pRing->NumDropped++;
+    return -1;
+  }
+  KEY_RING_BARRIER();                // The consumer has read the slot before it moved RdPos.
+  pRing->paEvent[WrPos & (pRing->NumEvents - 1u)] = *pEvent;
+  KEY_RING_BARRIER();
+  pRing->WrPos = WrPos + 1u;
+  return 0;
+}
+
+/*********************************************************************
+*
+*       KEY_RING_Get
+*
+*  Function description
+*    Retrieves the oldest event. Called by the consumer only.
+*
+*  Return value
+*    == 0: No event available.
+*    == 1: Event copied to *pEvent.
+*/
+int KEY_RING_Get(KEY_RING * pRing, KEY_EVENT * pEvent) {
+  unsigned RdPos;
+
+  RdPos = pRing->RdPos;
+  if (RdPos == pRing->WrPos) {
+    return 0;
+  }
+  KEY_RING_BARRIER();
+  *pEvent = pRing->paEvent[RdPos & (pRing->NumEvents - 1u)];
+  KEY_RING_BARRIER();
+  pRing->RdPos = RdPos + 1u;
+  return 1;
+}
+
+/*********************************************************************
+*
+*       KEY_RING_GetNumDropped
+*
+*  Function description
+*    Returns the number of events lost because the ring was full.
+*/
+unsigned KEY_RING_GetNumDropped(const KEY_RING * pRing) {
+  return pRing->NumDropped;
+}
+
+/*************************** End of file ****************************/
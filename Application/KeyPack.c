@@ -0,0 +1,187 @@
+/*********************************************************************
+-------------------------- END-OF-HEADER -----------------------------
+File    : KeyPack.c
+Purpose : Turns text into boot keyboard reports.
+
+Additional information:
+  Every character is looked up with ASCII2USAGE_Get(). A key counts as
+  pressed by the host when it appears in a report and was not in the
+  previous one. A report implicitly releases all keys it does not
+  contain, so a release report is only inserted when a key has to be
+  pressed again (e.g. "ll" or "aA").
+
+  With KeysPerReport == 1, every report presses exactly one new key and
+  the host types the characters in report order.
+
+  With KeysPerReport > 1, consecutive characters are packed into the
+  key array of one report as long as
+    * they need the same modifiers,
+    * their usage ID is not already part of the report and
+    * less than KeysPerReport keys are in the report.
+  The host then sees several keys pressed at the same time. The HID
+  specification does not define in which order it types them. Array
+  order is assumed, which has not been verified with any host, so
+  "ab" may come out as "ba".
+
+  The module has no target dependencies and is built on the host by
+  Host/KeyPack_Test.c.
+*/
+
+/*********************************************************************
+*
+*       #include section
+*
+**********************************************************************
+*/
+#include <stddef.h>
+#include <string.h>
+#include "Ascii2Usage.h"
+#include "KeyPack.h"
+
+/*********************************************************************
+*
+*       Static code
+*
+**********************************************************************
+*/
+
+/*********************************************************************
+*
+*       _IsKeyInList
+*
+*  Function description
+*    Checks whether a usage ID is contained in a list of keys.
+*/
+static int _IsKeyInList(const unsigned char * pKeys, unsigned NumKeys, unsigned char Usage) {
+  while (NumKeys--) {
+    if (*pKeys++ == Usage) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/*********************************************************************
+*
+*       _Send
+*
+*  Function description
+*    Sends a report and remembers its keys.
+*/
+static void _Send(KEY_PACK * pPack, unsigned char Modifier, const unsigned char * pKeys, unsigned NumKeys) {
+  if (NumKeys != 0u) {
+    memcpy(pPack->abLastKeys, pKeys, NumKeys);
+  }
+  pPack->NumLastKeys = NumKeys;
+  pPack->pfSend(pPack->pContext, Modifier, pKeys, NumKeys);
+}
+
+/*********************************************************************
+*
+*       _SendKeys
+*
+*  Function description
+*    Sends a set of newly pressed keys sharing the same modifiers.
+*
+*  Additional information
+*    A key that is still contained in the previous report is not
+*    recognized as a new key press by the host. In this case
+*    all keys are released first.
+*/
+static void _SendKeys(KEY_PACK * pPack, unsigned char Modifier, const unsigned char * pKeys, unsigned NumKeys) {
+  unsigned i;
+
+  for (i = 0; i < NumKeys; i++) {
+    if (_IsKeyInList(pPack->abLastKeys, pPack->NumLastKeys, pKeys[i])) {
+      _Send(pPack, 0, NULL, 0);
+      break;
+    }
+  }
+  _Send(pPack, Modifier, pKeys, NumKeys);
+}
+
+/*********************************************************************
+*
+*       Public code
+*
+**********************************************************************
+*/
+
+/*********************************************************************
+*
+*       KEY_PACK_Init
+*
+*  Function description
+*    Initializes a packer.
+*
+*  Parameters
+*    pPack         : Packer to initialize.
+*    KeysPerReport : Max. new keys per report, 1..KEY_PACK_NUM_SLOTS.
+*                    Values above 1 rely on the host, see above.
+*    pfSend        : Called for every report.
+*    pContext      : Passed to pfSend.
+*/
+void KEY_PACK_Init(KEY_PACK * pPack, unsigned KeysPerReport, KEY_PACK_SEND_FUNC * pfSend, void * pContext) {
+  memset(pPack, 0, sizeof(*pPack));
+  if (KeysPerReport < 1u) {
+    KeysPerReport = 1u;
+  }
+  if (KeysPerReport > KEY_PACK_NUM_SLOTS) {
+    KeysPerReport = KEY_PACK_NUM_SLOTS;
+  }
+  pPack->KeysPerReport = KeysPerReport;
+  pPack->pfSend        = pfSend;
+  pPack->pContext      = pContext;
+}
+
+/*********************************************************************
+*
+*       KEY_PACK_Output
+*
+*  Function description
+*    Sends the reports which type a string and releases all keys.
+*
+*  Return value
+*    Number of characters typed. Characters without a key on a US
+*    keyboard are skipped.
+*/
+unsigned KEY_PACK_Output(KEY_PACK * pPack, const char * sString) {
+  const ASCII_TO_USAGE * pKey;
+  unsigned               NumChars;
+  unsigned               NumKeys;
+  unsigned char          abKeys[KEY_PACK_NUM_SLOTS];
+  unsigned char          Modifier;
+
+  NumChars = 0;
+  NumKeys  = 0;
+  Modifier = 0;
+  for (; *sString != 0; sString++) {
+    pKey = ASCII2USAGE_Get((unsigned char)*sString);
+    if ((pKey == NULL) || (pKey->Usage == 0u)) {
+      continue;
+    }
+    if (NumKeys != 0u) {
+      if ((NumKeys >= pPack->KeysPerReport) ||
+          (pKey->Modifier != Modifier) ||
+          _IsKeyInList(abKeys, NumKeys, pKey->Usage)) {
+        _SendKeys(pPack, Modifier, abKeys, NumKeys);
+        NumKeys = 0;
+      }
+    }
+    if (NumKeys == 0u) {
+      Modifier = pKey->Modifier;
+    }
+    abKeys[NumKeys++] = pKey->Usage;
+    NumChars++;
+  }
+  if (NumKeys != 0u) {
+    _SendKeys(pPack, Modifier, abKeys, NumKeys);
+  }
+  //
+  // An empty report tells the host that the last keys have been released.
+  //
+  _Send(pPack, 0, NULL, 0);
+  return NumChars;
+}
+
+/*************************** End of file ****************************/
@@ -0,0 +1,518 @@
+/*********************************************************************
+-------------------------- END-OF-HEADER -----------------------------
+File    : USB_Bulk_Benchmark.c
+Purpose : Vendor specific bulk interface with a throughput benchmark.
+
+Additional information:
+  Preparations:
+    Build the "Debug_Bulk" configuration. The device enumerates
+    with one interface of class 0xFF and a bulk IN and a bulk OUT
+    endpoint. On Linux it can be accessed with libusb, on Windows
+    a WinUSB or libusb driver has to be assigned.
+
+  Expected behavior:
+    The device sends data on the bulk IN endpoint as fast as the
+    host reads it and discards all data written to the bulk OUT
+    endpoint. Each IN transfer starts with a 32-bit little-endian
+    sequence number followed by an incrementing byte pattern, so
+    the host can check for lost or reordered transfers.
+
+  Sample output:
+    Once per second the throughput of both directions and a
+    histogram of the transfer times is printed via RTT, e.g.:
+      TX 1.081 MB/s (264 transfers, 0 errors), RX 0.000 MB/s (0 transfers, 0 errors)
+      TX us:   2048: 3   4096: 261
+
+  Each direction uses two buffers of BULK_TRANSFER_SIZE bytes.
+  While one buffer is transferred by the USB stack, the other one
+  is filled (IN) or consumed (OUT) by the task. The completion
+  callbacks run in the USB interrupt and start the transfer of the
+  other buffer right away, so the endpoint only stalls (NAKs) if
+  the task falls behind. The buffer handling is in BulkChannel.c,
+  which is tested on the host against a simulated endpoint
+  (Host/BulkChannel_Test.c). Host/bulk_bench.c is the matching
+  libusb host tool.
+
+  With BULK_USE_BLOCKING_IO set to 1 only the IN direction is served,
+  by the task calling USBD_Write() for one buffer at a time. Every
+  transfer then blocks the task in USB_OS_WaitTimed() until the USB
+  interrupt signals completion. Together with USB_OS_MEASURE_WAKE_LATENCY
+  (to be defined for the whole project) this measures the latency from
+  USB_OS_Signal() in the interrupt until the task runs again:
+      Wake us: last 4, max 11 (264 wakes)
+*/
+
+/*********************************************************************
+*
+*       #include section
+*
+**********************************************************************
+*/
+#include <string.h>
+#include "RTOS.h"
+#include "USB.h"
+#include "USB_Bulk.h"
+#include "BSP.h"
+#include "BSP_USB.h"
+#include "SEGGER_RTT.h"
+#include "BulkChannel.h"
+#include "stm32f4xx.h"
+
+/*********************************************************************
+*
+*       Defines, configurable
+*
+**********************************************************************
+*/
+//
+// Number of bytes per USBD_WriteAsync() / USBD_ReadAsync() call.
+// Must be a multiple of the max. packet size.
+//
+#ifndef BULK_TRANSFER_SIZE
+#define BULK_TRANSFER_SIZE       4096u
+#endif
+//
+// Interval of the throughput output [ms].
+//
+#ifndef SHOW_INTERVAL_MS
+#define SHOW_INTERVAL_MS         1000u
+#endif
+//
+// If set to 1, the task sends with blocking USBD_Write() calls
+// instead of the double buffered USBD_WriteAsync() transfers.
+//
+#ifndef BULK_USE_BLOCKING_IO
+#define BULK_USE_BLOCKING_IO     0
+#endif
+//
+// Must match the setting of the USB OS layer (USB_OS_embOSv5.c).
+//
+#ifndef USB_OS_MEASURE_WAKE_LATENCY
+#define USB_OS_MEASURE_WAKE_LATENCY  0
+#endif
+#ifndef USBD_SAMPLE_NO_MAINTASK
+#define USBD_SAMPLE_NO_MAINTASK  0
+#endif
+
+#if (BULK_TRANSFER_SIZE % USB_FS_BULK_MAX_PACKET_SIZE) != 0u
+  #error "BULK_TRANSFER_SIZE must be a multiple of the max. packet size"
+#endif
+
+/*********************************************************************
+*
+*       Defines, fixed
+*
+**********************************************************************
+*/
+//
+// Task events of the bulk task.
+//
+#define TASK_EVENT_TX_DONE       (1u << 0)   // An IN buffer became free.
+#define TASK_EVENT_RX_DONE       (1u << 1)   // An OUT buffer has been filled.
+#define TASK_EVENT_USB_STATE     (1u << 2)   // USB device state changed.
+
+/*********************************************************************
+*
+*       Forward declarations
+*
+**********************************************************************
+*/
+#ifdef __cplusplus
+extern "C" {     /* Make sure we have C-declarations in C++ programs */
+#endif
+  void MainTask(void);
+  void USBD_Bulk_Benchmark_Init(void);
+  void USBD_Bulk_Benchmark_RunTask(void *);
+#ifdef __cplusplus
+}
+#endif
+
+/*********************************************************************
+*
+*       Local data definitions
+*
+**********************************************************************
+*/
+typedef struct {
+  BULK_CHANNEL            Channel;
+  USB_ASYNC_IO_CONTEXT    AsyncContext;
+  unsigned                EPIndex;
+} BULK_EP;
+
+/*********************************************************************
+*
+*       Static const data
+*
+**********************************************************************
+*/
+#if USBD_SAMPLE_NO_MAINTASK == 0
+/*********************************************************************
+*
+*       Information that are used during enumeration
+*/
+static const USB_DEVICE_INFO _DeviceInfo = {
+  0x8765,         // VendorId
+  0x1240,         // ProductId
+  "Vendor",       // VendorName
+  "Bulk benchmark sample",  // ProductName
+  "12345678"      // SerialNumber
+};
+#endif
+
+/*********************************************************************
+*
+*       Static data
+*
+**********************************************************************
+*/
+static U8             _abTxBuffer[BULK_CHANNEL_NUM_BUFFERS][BULK_TRANSFER_SIZE];
+static U8             _abRxBuffer[BULK_CHANNEL_NUM_BUFFERS][BULK_TRANSFER_SIZE];
+static BULK_EP        _TxEP;
+static BULK_EP        _RxEP;
+static U32            _TxSequence;
+static OS_TASK *      _pBulkTask;        // Task woken by transfer and USB state events, NULL until the task runs.
+static USB_HOOK       _UsbStateHook;
+
+/*********************************************************************
+*
+*       Static code
+*
+**********************************************************************
+*/
+
+/*********************************************************************
+*
+*       _StartTransfer
+*
+*  Function description
+*    Starts a transfer for the bulk channel. Called by BulkChannel.c
+*    from the task with the USB interrupt locked out or from within
+*    the USB interrupt.
+*/
+static void _StartTransfer(BULK_CHANNEL * pChannel, U8 * pData, unsigned NumBytes) {
+  BULK_EP *              pEP;
+  USB_ASYNC_IO_CONTEXT * pContext;
+
+  pEP                          = (BULK_EP *)pChannel->pContext;
+  pContext                     = &pEP->AsyncContext;
+  pContext->pData              = pData;
+  pContext->NumBytesToTransfer = NumBytes;
+  if (pChannel->InDir) {
+    USBD_WriteAsync(pEP->EPIndex, pContext, 0);
+  } else {
+    USBD_ReadAsync(pEP->EPIndex, pContext, 1);
+  }
+}
+
+/*********************************************************************
+*
+*       _OnComplete
+*
+*  Function description
+*    Completion callback of USBD_WriteAsync() / USBD_ReadAsync().
+*    Runs in the USB interrupt.
+*/
+static void _OnComplete(USB_ASYNC_IO_CONTEXT_POI pContext) {
+  BULK_EP * pEP;
+
+  pEP = (BULK_EP *)pContext->pContext;
+  BULK_CHANNEL_OnComplete(&pEP->Channel, pContext->Status, pContext->NumBytesTransferred, DWT->CYCCNT);
+  if (_pBulkTask != NULL) {
+    OS_TASKEVENT_Set(_pBulkTask, pEP->Channel.InDir ? TASK_EVENT_TX_DONE : TASK_EVENT_RX_DONE);
+  }
+}
+
+/*********************************************************************
+*
+*       _InitEP
+*/
+static void _InitEP(BULK_EP * pEP, unsigned EPIndex, unsigned InDir, U8 (*paBuffer)[BULK_TRANSFER_SIZE]) {
+  memset(pEP, 0, sizeof(*pEP));
+  pEP->EPIndex                   = EPIndex;
+  pEP->AsyncContext.pfOnComplete = _OnComplete;
+  pEP->AsyncContext.pContext     = pEP;
+  BULK_CHANNEL_Init(&pEP->Channel, InDir, &paBuffer[0][0], BULK_TRANSFER_SIZE, SystemCoreClock / 1000000u, _StartTransfer, pEP);
+}
+
+/*********************************************************************
+*
+*       _FillTxBuffer
+*
+*  Function description
+*    Writes the sequence number and the test pattern into an IN buffer.
+*/
+static void _FillTxBuffer(U8 * pBuffer) {
+  unsigned i;
+
+  pBuffer[0] = (U8)(_TxSequence);
+  pBuffer[1] = (U8)(_TxSequence >> 8);
+  pBuffer[2] = (U8)(_TxSequence >> 16);
+  pBuffer[3] = (U8)(_TxSequence >> 24);
+  for (i = 4; i < BULK_TRANSFER_SIZE; i++) {
+    pBuffer[i] = (U8)i;
+  }
+  _TxSequence++;
+}
+
+/*********************************************************************
+*
+*       _ServeTx
+*
+*  Function description
+*    Fills all free IN buffers and hands them to the USB stack.
+*/
+static void _ServeTx(BULK_CHANNEL * pChannel) {
+  U8 * pBuffer;
+
+  while ((pBuffer = BULK_CHANNEL_GetTaskBuffer(pChannel, NULL)) != NULL) {
+    _FillTxBuffer(pBuffer);
+    USB_OS_IncDI();
+    BULK_CHANNEL_Submit(pChannel, DWT->CYCCNT);
+    USB_OS_DecRI();
+  }
+}
+
+#if BULK_USE_BLOCKING_IO
+/*********************************************************************
+*
+*       _WriteBlocking
+*
+*  Function description
+*    Sends one buffer with USBD_Write(), which returns once the
+*    transfer is complete or has failed.
+*/
+static void _WriteBlocking(BULK_EP * pEP) {
+  U32 StartCycles;
+  int r;
+
+  _FillTxBuffer(pEP->Channel.pBuffer);
+  StartCycles = DWT->CYCCNT;
+  r = USBD_Write(pEP->EPIndex, pEP->Channel.pBuffer, BULK_TRANSFER_SIZE, 0, (int)SHOW_INTERVAL_MS);
+  USB_OS_IncDI();
+  BULK_CHANNEL_CountTransfer(&pEP->Channel, r, DWT->CYCCNT - StartCycles);
+  USB_OS_DecRI();
+}
+#endif
+
+/*********************************************************************
+*
+*       _ServeRx
+*
+*  Function description
+*    Consumes all filled OUT buffers and re-arms the endpoint.
+*/
+static void _ServeRx(BULK_CHANNEL * pChannel) {
+  unsigned NumBytes;
+
+  while (BULK_CHANNEL_GetTaskBuffer(pChannel, &NumBytes) != NULL) {
+    //
+    // The data is discarded, a real application would process
+    // NumBytes bytes of the buffer here.
+    //
+    USB_OS_IncDI();
+    BULK_CHANNEL_Submit(pChannel, DWT->CYCCNT);
+    USB_OS_DecRI();
+  }
+}
+
+/*********************************************************************
+*
+*       _RestartChannel
+*
+*  Function description
+*    Returns all buffers to the task after a failed transfer.
+*    Called by the task when the device has been configured.
+*/
+static void _RestartChannel(BULK_CHANNEL * pChannel) {
+  USB_OS_IncDI();
+  BULK_CHANNEL_Restart(pChannel, DWT->CYCCNT);
+  USB_OS_DecRI();
+}
+
+/*********************************************************************
+*
+*       _ShowStats
+*
+*  Function description
+*    Prints throughput and transfer time histogram of one interval
+*    via RTT and resets the counters.
+*/
+static void _ShowStats(U32 IntervalMs) {
+  static const char * _asDir[2] = { "RX", "TX" };
+  BULK_CHANNEL * apChannel[2];
+  BULK_STATS     aStats[2];
+  U32            BytesPerMs;
+  unsigned       i;
+  unsigned       j;
+
+  apChannel[0] = &_RxEP.Channel;
+  apChannel[1] = &_TxEP.Channel;
+  USB_OS_IncDI();
+  for (i = 0; i < 2u; i++) {
+    BULK_CHANNEL_GetStats(apChannel[i], &aStats[i]);
+  }
+  USB_OS_DecRI();
+  for (i = 2; i-- > 0u; ) {
+    BytesPerMs = aStats[i].NumBytes / IntervalMs;     // kB/s, 1 kB = 1000 bytes
+    SEGGER_RTT_printf(0, "%s %u.%03u MB/s (%u transfers, %u errors)%s", _asDir[i],
+                      (unsigned)(BytesPerMs / 1000u), (unsigned)(BytesPerMs % 1000u),
+                      (unsigned)aStats[i].NumTransfers, (unsigned)aStats[i].NumErrors, (i != 0u) ? ", " : "\n");
+  }
+  for (i = 2; i-- > 0u; ) {
+    if (aStats[i].NumTransfers != 0u) {
+      SEGGER_RTT_printf(0, "%s us:", _asDir[i]);
+      for (j = 0; j < BULK_CHANNEL_NUM_BUCKETS; j++) {
+        if (aStats[i].aNumLatency[j] != 0u) {
+          SEGGER_RTT_printf(0, " %6u: %u", 1u << j, (unsigned)aStats[i].aNumLatency[j]);
+        }
+      }
+      SEGGER_RTT_printf(0, "\n");
+    }
+  }
+#if USB_OS_MEASURE_WAKE_LATENCY
+  {
+    U32 NumWakes;
+    U32 LastCycles;
+    U32 MaxCycles;
+
+    NumWakes = USB_OS_GetWakeLatency(&LastCycles, &MaxCycles);
+    SEGGER_RTT_printf(0, "Wake us: last %u, max %u (%u wakes)\n",
+                      (unsigned)(LastCycles / (SystemCoreClock / 1000000u)),
+                      (unsigned)(MaxCycles  / (SystemCoreClock / 1000000u)), (unsigned)NumWakes);
+  }
+#endif
+}
+
+/*********************************************************************
+*
+*       _OnStateChange
+*
+*  Function description
+*    Wakes the bulk task when the USB device state changes.
+*/
+static void _OnStateChange(void * pContext, U8 NewState) {
+  USB_USE_PARA(pContext);
+  USB_USE_PARA(NewState);
+  if (_pBulkTask != NULL) {
+    OS_TASKEVENT_Set(_pBulkTask, TASK_EVENT_USB_STATE);
+  }
+}
+
+/*********************************************************************
+*
+*       Public code
+*
+**********************************************************************
+*/
+/*********************************************************************
+*
+*       USBD_Bulk_Benchmark_Init
+*
+*  Function description
+*    Adds the vendor specific bulk interface to the USB stack.
+*/
+void USBD_Bulk_Benchmark_Init(void) {
+  static U8           _abOutBuffer[USB_FS_BULK_MAX_PACKET_SIZE];
+  USB_BULK_INIT_DATA  InitData;
+  USB_ADD_EP_INFO     EPBulkIn;
+  USB_ADD_EP_INFO     EPBulkOut;
+
+  EPBulkIn.Flags         = 0;                             // Flags not used.
+  EPBulkIn.InDir         = USB_DIR_IN;                    // IN direction (Device to Host)
+  EPBulkIn.Interval      = 0;                             // Interval not used for Bulk endpoints.
+  EPBulkIn.MaxPacketSize = USB_FS_BULK_MAX_PACKET_SIZE;   // Maximum packet size (64 for Bulk in full-speed).
+  EPBulkIn.TransferType  = USB_TRANSFER_TYPE_BULK;        // Endpoint type - Bulk.
+  InitData.EPIn  = (U8)USBD_AddEPEx(&EPBulkIn, NULL, 0);
+  BSP_USB_FIFO_AddEP(USB_DIR_IN, EPBulkIn.MaxPacketSize);
+
+  EPBulkOut.Flags         = 0;                            // Flags not used.
+  EPBulkOut.InDir         = USB_DIR_OUT;                  // OUT direction (Host to Device)
+  EPBulkOut.Interval      = 0;                            // Interval not used for Bulk endpoints.
+  EPBulkOut.MaxPacketSize = USB_FS_BULK_MAX_PACKET_SIZE;  // Maximum packet size (64 for Bulk in full-speed).
+  EPBulkOut.TransferType  = USB_TRANSFER_TYPE_BULK;       // Endpoint type - Bulk.
+  InitData.EPOut = (U8)USBD_AddEPEx(&EPBulkOut, _abOutBuffer, sizeof(_abOutBuffer));
+  BSP_USB_FIFO_AddEP(USB_DIR_OUT, EPBulkOut.MaxPacketSize);
+
+  USBD_BULK_Add(&InitData);
+  _InitEP(&_TxEP, InitData.EPIn,  1, _abTxBuffer);
+  _InitEP(&_RxEP, InitData.EPOut, 0, _abRxBuffer);
+  USBD_RegisterSCHook(&_UsbStateHook, _OnStateChange, NULL);
+}
+
+/*********************************************************************
+*
+*       USBD_Bulk_Benchmark_RunTask
+*
+*  Function description
+*    Keeps both bulk endpoints busy and prints the throughput.
+*/
+void USBD_Bulk_Benchmark_RunTask(void * pPara) {
+  OS_TIME      LastShow;
+  OS_TIME      Elapsed;
+#if BULK_USE_BLOCKING_IO == 0
+  OS_TASKEVENT Events;
+#endif
+
+  USB_USE_PARA(pPara);
+  _pBulkTask = OS_TASK_GetID();
+  while (1) {
+    //
+    // Wait for configuration
+    //
+    while ((USBD_GetState() & (USB_STAT_CONFIGURED | USB_STAT_SUSPENDED)) != USB_STAT_CONFIGURED) {
+      BSP_ToggleLED(0);
+      OS_TASKEVENT_GetTimed(TASK_EVENT_USB_STATE, 50);
+    }
+    BSP_SetLED(0);
+#if BULK_USE_BLOCKING_IO
+    LastShow = OS_TIME_GetTicks();
+    do {
+      _WriteBlocking(&_TxEP);
+      Elapsed = OS_TIME_GetTicks() - LastShow;
+      if (Elapsed >= (OS_TIME)SHOW_INTERVAL_MS) {
+        _ShowStats((U32)Elapsed);
+        LastShow += Elapsed;
+      }
+    } while ((USBD_GetState() & (USB_STAT_CONFIGURED | USB_STAT_SUSPENDED)) == USB_STAT_CONFIGURED);
+#else
+    _RestartChannel(&_TxEP.Channel);
+    _RestartChannel(&_RxEP.Channel);
+    LastShow = OS_TIME_GetTicks();
+    //
+    // A bus reset aborts the transfers in flight, so the channels are
+    // restarted after every state change.
+    //
+    do {
+      _ServeTx(&_TxEP.Channel);
+      _ServeRx(&_RxEP.Channel);
+      Elapsed = OS_TIME_GetTicks() - LastShow;
+      if (Elapsed >= (OS_TIME)SHOW_INTERVAL_MS) {
+        _ShowStats((U32)Elapsed);
+        LastShow += Elapsed;
+        Elapsed   = 0;
+      }
+      Events = OS_TASKEVENT_GetTimed(TASK_EVENT_TX_DONE | TASK_EVENT_RX_DONE | TASK_EVENT_USB_STATE, (OS_TIME)SHOW_INTERVAL_MS - Elapsed);
+    } while ((Events & TASK_EVENT_USB_STATE) == 0u);
+#endif
+  }
+}
+
+#if USBD_SAMPLE_NO_MAINTASK == 0
+/*********************************************************************
+*
+*       MainTask
+*
+* Function description
+*   USB handling task.
+*   Modify to implement the desired protocol
+*/
+void MainTask(void) {
+  USBD_Init();
+  USBD_SetDeviceInfo(&_DeviceInfo);
+  USBD_Bulk_Benchmark_Init();
+  USBD_Start();
+  USBD_Bulk_Benchmark_RunTask(NULL);
+}
+#endif
+
+/**************************** end of file ***************************/
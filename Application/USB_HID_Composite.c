@@ -0,0 +1,117 @@
+/*********************************************************************
+-------------------------- END-OF-HEADER -----------------------------
+File    : USB_HID_Composite.c
+Purpose : Demonstrates a composite device with an HID keyboard and
+          an HID mouse on one USB connection.
+
+Additional information:
+  Preparations:
+    Build the "Debug_Composite" configuration. It compiles
+    USB_HID_Keyboard.c and USB_HID_Mouse.c with
+    USBD_SAMPLE_NO_MAINTASK=1 and adds this file.
+
+  Expected behavior:
+    The device enumerates once with two HID interfaces. The keys
+    type text as in the keyboard sample while the mouse cursor
+    jumps from left to right and back as in the mouse sample.
+
+  Sample output:
+    The target side does not produce terminal output.
+
+  Each HID function consists of a single interface, so no interface
+  association descriptor (USBD_EnableIAD()) is needed. Each interface
+  has its own interrupt IN endpoint, TX FIFO and report queue, so the
+  host polls both independently and a busy keyboard endpoint never
+  delays a mouse report or vice versa. Both tasks run at the same
+  priority and are scheduled round-robin.
+*/
+
+/*********************************************************************
+*
+*       #include section
+*
+**********************************************************************
+*/
+#include "RTOS.h"
+#include "USB.h"
+
+/*********************************************************************
+*
+*       Defines, configurable
+*
+**********************************************************************
+*/
+#ifndef MOUSE_TASK_PRIO
+#define MOUSE_TASK_PRIO  100    // Same as MainTask, see main.c.
+#endif
+
+/*********************************************************************
+*
+*       Forward declarations
+*
+**********************************************************************
+*/
+#ifdef __cplusplus
+extern "C" {     /* Make sure we have C-declarations in C++ programs */
+#endif
+  void MainTask(void);
+  void USBD_HID_Keyboard_Init(void);
+  void USBD_HID_Keyboard_RunTask(void *);
+  void USBD_HID_Mouse_Init(void);
+  void USBD_HID_Mouse_RunTask(void *);
+#ifdef __cplusplus
+}
+#endif
+
+/*********************************************************************
+*
+*       Static const data
+*
+**********************************************************************
+*/
+/*********************************************************************
+*
+*       Information that are used during enumeration
+*/
+static const USB_DEVICE_INFO _DeviceInfo = {
+  0x8765,         // VendorId
+  0x1117,         // ProductId
+  "Vendor",       // VendorName
+  "HID keyboard and mouse sample",  // ProductName
+  "12345678"      // SerialNumber
+};
+
+/*********************************************************************
+*
+*       Static data
+*
+**********************************************************************
+*/
+static OS_STACKPTR int _aMouseStack[256];
+static OS_TASK         _MouseTask;
+
+/*********************************************************************
+*
+*       Public code
+*
+**********************************************************************
+*/
+/*********************************************************************
+*
+*       MainTask
+*
+* Function description
+*   USB handling task. Adds both HID interfaces before the stack is
+*   started, runs the mouse in its own task and the keyboard in this task.
+*/
+void MainTask(void) {
+  USBD_Init();
+  USBD_SetDeviceInfo(&_DeviceInfo);
+  USBD_HID_Keyboard_Init();
+  USBD_HID_Mouse_Init();
+  USBD_Start();
+  OS_TASK_CREATEEX(&_MouseTask, "Mouse", MOUSE_TASK_PRIO, USBD_HID_Mouse_RunTask, _aMouseStack, NULL);
+  USBD_HID_Keyboard_RunTask(NULL);
+}
+
+/**************************** end of file ***************************/
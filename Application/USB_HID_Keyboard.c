@@ -33,6 +33,9 @@ Additional information:
 
   Expected behavior:
     The sample types a predefined string like from a regular keyboard.
+    LED 1 follows the Caps Lock state of the host. Output reports
+    are handled in the USB interrupt, whether the host sends them on
+    the interrupt OUT endpoint or with SET_REPORT on the control endpoint.
 
   Sample output:
     The target side does not produce terminal output.
@@ -45,10 +48,20 @@ Additional information:
 **********************************************************************
 */
 #include <string.h>
-#include <ctype.h>
+#include "RTOS.h"
 #include "USB.h"
 #include "USB_HID.h"
 #include "BSP.h"
+#include "BSP_KEY.h"
+#include "HID_ReportQueue.h"
+#include "KeyEventRing.h"
+#include "KeyPack.h"
+#include "BSP_USB.h"
+#include "HID_ReportDesc.h"
+#include "CDC_Serial.h"
+#include "BSP_BOOT.h"
+#include "BSP_IRQ.h"
+#include "HID_FrameSched.h"
 #include "stm32f4xx.h"
 
 /*********************************************************************
@@ -61,10 +74,182 @@ Additional information:
 // Specifies whether the return key should be sent in this sample.
 //
 #define SEND_RETURN 0
+//
+// If set to 1, the S key types a long text and the resulting
+// typing rate in characters per second is printed via RTT.
+// The rate depends on the host and its poll interval, it is only
+// known once measured on the board with this option.
+//
+#ifndef SHOW_TYPING_RATE
+#define SHOW_TYPING_RATE  0
+#endif
+//
+// Maximum number of characters packed into one keyboard report (1..6).
+// 1 sends exactly one new key per report, which every host types in
+// order. Higher values rely on the host typing the new keys of one
+// report in array order, which the HID specification does not define
+// and which has not been verified with any host, see KeyPack.c.
+//
+#ifndef KEYS_PER_REPORT
+#define KEYS_PER_REPORT   1
+#endif
+//
+// Number of key events the ISR can queue for the task. Must be a power of 2.
+//
+#ifndef KEY_EVENT_BUFFER_SIZE
+#define KEY_EVENT_BUFFER_SIZE  16u
+#endif
+//
+// Number of keyboard reports which can be queued for the IN endpoint.
+//
+#ifndef NUM_QUEUED_REPORTS
+#define NUM_QUEUED_REPORTS     16u
+#endif
+//
+// Default poll interval of the interrupt endpoints [us].
+// Can be changed with USBD_HID_Keyboard_SetPollInterval() before USBD_HID_Keyboard_Init().
+//
+#ifndef POLL_INTERVAL_US
+#define POLL_INTERVAL_US       1000u
+#endif
+//
+// If set to 1, the latency from the first key edge until the host
+// has fetched the report with the key is printed via RTT.
+//
+#ifndef SHOW_LATENCY
+#define SHOW_LATENCY           0
+#endif
+//
+// If set to 1, the FIFO RAM required by the endpoints is printed via RTT.
+//
+#ifndef SHOW_FIFO_BUDGET
+#define SHOW_FIFO_BUDGET       0
+#endif
+//
+// If set to 1, the boot time line from reset until the device has
+// been configured by the host is printed via RTT once.
+//
+#ifndef SHOW_BOOT_TIME
+#define SHOW_BOOT_TIME         0
+#endif
+//
+// Board LED which shows the Caps Lock state of the host, -1 to ignore it.
+// LED 0 is used as USB state indicator by the task.
+//
+#ifndef LED_CAPS_LOCK
+#define LED_CAPS_LOCK          1
+#endif
+//
+// If set to 1, the latency from the reception of an output report
+// until the LED is updated is printed via RTT after each key press.
+//
+#ifndef SHOW_LED_LATENCY
+#define SHOW_LED_LATENCY       0
+#endif
+//
+// If set to 1 and BSP_KEY_MATRIX_ENABLE is set, the CPU time of one
+// complete key matrix scan (TIM7 interrupt, all rows) is printed via
+// RTT after each key press.
+//
+#ifndef SHOW_SCAN_CYCLES
+#define SHOW_SCAN_CYCLES       0
+#endif
+//
+// If set to 1, the max. SysTick entry latency and the longest critical
+// section of the USB stack are printed via RTT after each key press.
+// BSP_MEASURE_TICK_LATENCY and USB_OS_MEASURE_LOCK_TIME have to be set
+// for the whole project. With BSP_IRQ_MEASURE_LATENCY, the entry latency
+// of every interrupt is tested and printed as well, and the USART3
+// (embOSView) latency under load is probed every IRQ_PROBE_PERIOD_US on
+// average. Build once with USBD_OS_USE_USBD_X_INTERRUPT 0 and once with
+// 1 (USB_Conf.h, needs USBD_OS_STACK_ONLY_IN_USB_ISR) and compare the
+// "under load" lines while typing.
+//
+#ifndef SHOW_IRQ_LATENCY
+#define SHOW_IRQ_LATENCY       0
+#endif
+#ifndef IRQ_PROBE_PERIOD_US
+#define IRQ_PROBE_PERIOD_US    1000u
+#endif
+//
+// If set to 1, the time from a report being queued until the host
+// fetches it is collected in a histogram (HID_FrameSched.c) and sent
+// to SystemView after each key press.
+//
+#ifndef SHOW_READY_TO_IN
+#define SHOW_READY_TO_IN       0
+#endif
+//
+// If set to 1, a CDC-ACM virtual COM port is added to the device.
+// Enabled by default if embOSView communicates via the virtual COM port.
+//
+#ifndef USE_CDC_SERIAL
+  #if defined(OS_VIEW_IFSELECT) && (OS_VIEW_IFSELECT == OS_VIEW_IF_USB_CDC)
+    #define USE_CDC_SERIAL       1
+  #else
+    #define USE_CDC_SERIAL       0
+  #endif
+#endif
 #ifndef USBD_SAMPLE_NO_MAINTASK
 #define USBD_SAMPLE_NO_MAINTASK  0
 #endif
 
+#if SHOW_TYPING_RATE || SHOW_LATENCY || SHOW_FIFO_BUDGET || SHOW_LED_LATENCY || SHOW_BOOT_TIME || SHOW_IRQ_LATENCY || SHOW_SCAN_CYCLES
+#include "SEGGER_RTT.h"
+#endif
+
+#if (KEYS_PER_REPORT < 1) || (KEYS_PER_REPORT > 6)
+  #error "KEYS_PER_REPORT must be in the range 1..6"
+#endif
+#if (KEY_EVENT_BUFFER_SIZE & (KEY_EVENT_BUFFER_SIZE - 1u)) != 0u
+  #error "KEY_EVENT_BUFFER_SIZE must be a power of 2"
+#endif
+
+/*********************************************************************
+*
+*       Defines, fixed
+*
+**********************************************************************
+*/
+//
+// LED bits of the output report (LED usage 1..5).
+//
+#define KBD_LED_NUM_LOCK        (1u << 0)
+#define KBD_LED_CAPS_LOCK       (1u << 1)
+#define KBD_LED_SCROLL_LOCK     (1u << 2)
+//
+// Number of key array slots declared in _aHIDReport (boot keyboard: 6).
+//
+#define NUM_KEY_SLOTS           KEY_PACK_NUM_SLOTS
+//
+// Fields of the keyboard input and output reports, see HID_ReportDesc.h.
+// _aHIDReport, the report structures and their pack/unpack functions are
+// generated from these lists. The report sizes are used as max. packet
+// size of the interrupt endpoints, so each report is transferred in a
+// single packet without reserving unused FIFO RAM.
+//
+#define KBD_IN_FIELDS(BITS, BYTES, WORDS, PAD, Ctx)                                                                \
+  BITS (Ctx, Modifiers, USB_HID_USAGE_PAGE_KEYBOARD_KEYPAD, 224, 231, 0, 1,   1, 8, USB_HID_VARIABLE)       \
+  PAD  (Ctx, Reserved,  8)                                                                                  \
+  BYTES(Ctx, Keys,      USB_HID_USAGE_PAGE_KEYBOARD_KEYPAD, 0,   101, 0, 101,    NUM_KEY_SLOTS, USB_HID_ARRAY)
+#define KBD_OUT_FIELDS(BITS, BYTES, WORDS, PAD, Ctx)                                                               \
+  BITS (Ctx, Leds,      USB_HID_USAGE_PAGE_LEDS,            1,   5,   0, 1,   1, 5, USB_HID_VARIABLE)       \
+  PAD  (Ctx, Pad0,      3)
+//
+// Task events of the keyboard task.
+//
+#define TASK_EVENT_KEY          (1u << 0)   // Key event queued by _OnKey().
+#define TASK_EVENT_USB_STATE    (1u << 1)   // USB device state changed.
+#define TASK_EVENT_REPORT_SENT  (1u << 2)   // A report slot of _ReportQueue became free.
+//
+// USB_ADD_EP_INFO.Interval is given in 125 us units. The stack converts it
+// into frames (1 ms) for a full-speed device, which is the only speed
+// of the OTG_FS controller used here. One frame is therefore the minimum.
+//
+#define EP_INTERVAL_UNIT_US     125u
+#define EP_INTERVAL_MIN         (1000u / EP_INTERVAL_UNIT_US)
+#define EP_INTERVAL_MAX         (255u * EP_INTERVAL_MIN)     // bInterval of a full-speed interrupt endpoint is 1..255 ms.
+
 /*********************************************************************
 *
 *       Forward declarations
@@ -76,6 +261,7 @@ extern "C" {     /* Make sure we have C-declarations in C++ programs */
 #endif
   void MainTask(void);
   void USBD_HID_Keyboard_Init(void);
+  void USBD_HID_Keyboard_SetPollInterval(unsigned IntervalUs);
   void USBD_HID_Keyboard_RunTask(void *);
 #ifdef __cplusplus
 }
@@ -88,9 +274,17 @@ extern "C" {     /* Make sure we have C-declarations in C++ programs */
 **********************************************************************
 */
 typedef struct {
-  U16 KeyCode;
-  char cCharacter;
-} SCANCODE_TO_DESC;
+  HID_REPORT_STRUCT(KBD_IN_FIELDS)
+} KEYBOARD_REPORT;
+
+typedef struct {
+  HID_REPORT_STRUCT(KBD_OUT_FIELDS)
+} KEYBOARD_OUT_REPORT;
+
+HID_REPORT_LAYOUT(KBD_IN_FIELDS,  KBD_IN)
+HID_REPORT_LAYOUT(KBD_OUT_FIELDS, KBD_OUT)
+_Static_assert(KBD_IN_NUM_BYTES  <= USB_FS_INT_MAX_PACKET_SIZE, "Input report must fit into one full-speed interrupt packet");
+_Static_assert(KBD_OUT_NUM_BYTES <= USB_FS_INT_MAX_PACKET_SIZE, "Output report must fit into one full-speed interrupt packet");
 
 
 /*********************************************************************
@@ -124,76 +318,10 @@ static const U8 _aHIDReport[] = {
   USB_HID_GLOBAL_USAGE_PAGE + 1, USB_HID_USAGE_PAGE_GENERIC_DESKTOP,
   USB_HID_LOCAL_USAGE + 1, USB_HID_USAGE_KEYBOARD,
   USB_HID_MAIN_COLLECTION + 1, USB_HID_COLLECTION_APPLICATION,
-    USB_HID_GLOBAL_USAGE_PAGE + 1, 7,
-    USB_HID_LOCAL_USAGE_MINIMUM + 1, 224,
-    USB_HID_LOCAL_USAGE_MAXIMUM + 1, 231,
-    USB_HID_GLOBAL_LOGICAL_MINIMUM + 1, 0,
-    USB_HID_GLOBAL_LOGICAL_MAXIMUM + 1, 1,
-    USB_HID_GLOBAL_REPORT_SIZE + 1, 1,
-    USB_HID_GLOBAL_REPORT_COUNT + 1, 8,
-    USB_HID_MAIN_INPUT + 1, USB_HID_VARIABLE,
-    USB_HID_MAIN_INPUT + 1, 1,
-    USB_HID_LOCAL_USAGE_MINIMUM + 1, 0,
-    USB_HID_LOCAL_USAGE_MAXIMUM + 1, 101,
-    USB_HID_GLOBAL_LOGICAL_MINIMUM + 1, 0,
-    USB_HID_GLOBAL_LOGICAL_MAXIMUM + 1, 101,
-    USB_HID_GLOBAL_REPORT_SIZE + 1, 8,
-    USB_HID_GLOBAL_REPORT_COUNT + 1, 6,
-    USB_HID_MAIN_INPUT + 1, 0,
-    USB_HID_GLOBAL_USAGE_PAGE + 1, USB_HID_USAGE_PAGE_LEDS,
-    USB_HID_LOCAL_USAGE_MINIMUM + 1, 1,
-    USB_HID_LOCAL_USAGE_MAXIMUM + 1, 5,
-    USB_HID_GLOBAL_LOGICAL_MINIMUM + 1, 0,
-    USB_HID_GLOBAL_LOGICAL_MAXIMUM + 1, 1,
-    USB_HID_GLOBAL_REPORT_SIZE + 1, 1,
-    USB_HID_GLOBAL_REPORT_COUNT + 1, 5,
-    USB_HID_MAIN_OUTPUT + 1, 2,
-    USB_HID_GLOBAL_REPORT_COUNT + 1, 3,
-    USB_HID_MAIN_OUTPUT + 1, 1,
+    HID_REPORT_ITEMS(KBD_IN_FIELDS,  USB_HID_MAIN_INPUT)
+    HID_REPORT_ITEMS(KBD_OUT_FIELDS, USB_HID_MAIN_OUTPUT)
   USB_HID_MAIN_ENDCOLLECTION
 };
-volatile uint32_t user_flags = 0x00;
-static const  SCANCODE_TO_DESC _aScanCode2StringTable[] = {
-  { 0x04, 'a'},
-  { 0x05, 'b'},
-  { 0x06, 'c'},
-  { 0x07, 'd'},
-  { 0x08, 'e'},
-  { 0x09, 'f'},
-  { 0x0A, 'g'},
-  { 0x0B, 'h'},
-  { 0x0C, 'i'},
-  { 0x0D, 'j'},
-  { 0x0E, 'k'},
-  { 0x0F, 'l'},
-  { 0x10, 'm'},
-  { 0x11, 'n'},
-  { 0x12, 'o'},
-  { 0x13, 'p'},
-  { 0x14, 'q'},
-  { 0x15, 'r'},
-  { 0x16, 's'},
-  { 0x17, 't'},
-  { 0x18, 'u'},
-  { 0x19, 'v'},
-  { 0x1A, 'w'},
-  { 0x1B, 'x'},
-  { 0x1C, 'y'},
-  { 0x1D, 'z'},
-  { 0x1E, '1'},
-  { 0x1F, '2'},
-  { 0x20, '3'},
-  { 0x21, '4'},
-  { 0x22, '5'},
-  { 0x23, '6'},
-  { 0x24, '7'},
-  { 0x25, '8'},
-  { 0x26, '9'},
-  { 0x27, '0'},
-  { 0x2C, ' '},
-  { 0x37, '.'}
-};
-
 
 /*********************************************************************
 *
@@ -202,6 +330,44 @@ static const  SCANCODE_TO_DESC _aScanCode2StringTable[] = {
 **********************************************************************
 */
 static USB_HID_HANDLE _hInst;
+static KEY_PACK       _KeyPack;
+static U8             _abReportBuffer[NUM_QUEUED_REPORTS * KBD_IN_NUM_BYTES];
+static HID_REPORT_QUEUE _ReportQueue;
+static unsigned       _PollIntervalUs = POLL_INTERVAL_US;
+#if SHOW_READY_TO_IN
+static HID_SCHED      _Sched;
+#endif
+//
+// End-to-end latency of a key press, measured in DWT cycles from the
+// first key edge until the report with the key has been fetched.
+//
+static volatile U32   _LatencyStart;
+static volatile U32   _LatencyReportNo;    // Sequence number of the measured report in _ReportQueue, 0: No measurement pending.
+static volatile U32   _LatencyCycles;      // Result of the last measurement.
+static volatile U32   _LatencyCyclesMax;
+//
+// Key events from _OnKey() (producer) to the task (consumer).
+//
+static KEY_EVENT      _aKeyEvent[KEY_EVENT_BUFFER_SIZE];
+static KEY_RING       _KeyRing;
+static OS_TASK *      _pKeyTask;        // Task woken by key and USB state events, NULL until the task runs.
+static USB_HOOK       _UsbStateHook;
+//
+// Output reports on the interrupt OUT endpoint are read asynchronously
+// and handled in the completion callback, no task is involved.
+//
+static unsigned             _EPOut;
+static USB_ASYNC_IO_CONTEXT _LedReadContext;
+static U8                   _abLedReport[KBD_OUT_NUM_BYTES];
+static volatile U8          _LedReadActive;
+static volatile U8          _LedState;           // Last LED bits received from the host.
+//
+// Latency of the LED update in DWT cycles, measured from the entry of
+// the USB interrupt which delivered the output report.
+//
+static volatile U32   _LedLatencyCycles;
+static volatile U32   _LedLatencyCyclesMax;
+static volatile U32   _NumLedReports;
 /*********************************************************************
 *
 *       Static code
@@ -209,46 +375,435 @@ static USB_HID_HANDLE _hInst;
 **********************************************************************
 */
 
+/*********************************************************************
+*
+*       _PackReport
+*
+*  Function description
+*    Converts a KEYBOARD_REPORT into the input report sent on the endpoint.
+*/
+HID_REPORT_PACK(KBD_IN_FIELDS, KBD_IN, _PackReport, KEYBOARD_REPORT)
+
+/*********************************************************************
+*
+*       _UnpackOutReport
+*
+*  Function description
+*    Converts an output report received from the host into a KEYBOARD_OUT_REPORT.
+*/
+HID_REPORT_UNPACK(KBD_OUT_FIELDS, KBD_OUT, _UnpackOutReport, KEYBOARD_OUT_REPORT)
+
+/*********************************************************************
+*
+*       _SendReport
+*
+*  Function description
+*    Queues a keyboard report for the interrupt IN endpoint.
+*    Send function of _KeyPack.
+*
+*  Additional information
+*    The function returns as soon as the report is queued. It only
+*    blocks while all slots of the report queue are occupied, or
+*    returns without sending if the device is no longer configured.
+*    Key reports must not be dropped, otherwise the host would see
+*    a key held down.
+*/
+static void _SendReport(void * pContext, U8 Modifier, const U8 * pKeys, unsigned NumKeys) {
+  KEYBOARD_REPORT Report;
+  U8              acReport[KBD_IN_NUM_BYTES];
+
+  USB_USE_PARA(pContext);
+  memset(&Report, 0, sizeof(Report));
+  Report.Modifiers = Modifier;
+  if (NumKeys != 0u) {
+    memcpy(Report.Keys, pKeys, NumKeys);
+  }
+  _PackReport(acReport, &Report);
+  while (HID_RQ_GetNumFree(&_ReportQueue) == 0u) {
+    if ((USBD_GetState() & (USB_STAT_CONFIGURED | USB_STAT_SUSPENDED)) != USB_STAT_CONFIGURED) {
+      return;
+    }
+    OS_TASKEVENT_GetBlocked(TASK_EVENT_REPORT_SENT | TASK_EVENT_USB_STATE);
+  }
+#if SHOW_READY_TO_IN
+  HID_SCHED_Put(&_Sched, acReport);
+#else
+  HID_RQ_Put(&_ReportQueue, acReport);
+#endif
+}
+
+#if SHOW_TYPING_RATE || SHOW_LATENCY
+/*********************************************************************
+*
+*       _WaitReportsSent
+*
+*  Function description
+*    Waits until all queued reports have been fetched by the host.
+*/
+static void _WaitReportsSent(void) {
+  while (HID_RQ_GetDepth(&_ReportQueue) != 0u) {
+    OS_TASKEVENT_GetBlocked(TASK_EVENT_REPORT_SENT);
+  }
+}
+#endif
+
 /*********************************************************************
 *
 *       _Output
 *
 *  Function description
-*    Outputs a string
+*    Outputs a string, see KEY_PACK_Output().
+*
+*  Return value
+*    Number of characters typed.
 */
-static void _Output(const char *sString) {
-  U8   ac[8];
-  char cTemp;
-  unsigned int i;
-  unsigned int j;
+static unsigned _Output(const char *sString) {
+  return KEY_PACK_Output(&_KeyPack, sString);
+}
 
-  memset(ac, 0, sizeof(ac));
-  for (i = 0; sString[i] != 0; i++) {
-    //
-    // A character is uppercase if it's hex value is less than 0x61 ('a')
-    // and greater or equal to 0x41 ('A'), therefore we set the
-    // LeftShiftUp bit for those characters
-    //
-    if (sString[i] < 0x61 && sString[i] >= 0x41) {
-      ac[0] = (1 << 1);
-      cTemp = tolower((int)sString[i]);
-    } else {
-      cTemp = sString[i];
+#if SHOW_TYPING_RATE
+/*********************************************************************
+*
+*       _OutputTimed
+*
+*  Function description
+*    Outputs a string and prints the achieved typing rate via RTT.
+*/
+static void _OutputTimed(const char *sString) {
+  HID_RQ_STATS Stats;
+  U32          t;
+  unsigned     NumChars;
+
+  t        = USB_OS_GetTickCnt();
+  NumChars = _Output(sString);
+  _WaitReportsSent();
+  t        = USB_OS_GetTickCnt() - t;
+  if (t == 0) {
+    t = 1;
+  }
+  SEGGER_RTT_printf(0, "Typed %u chars in %u ms: %u chars/s\n", NumChars, (unsigned)t, (unsigned)((NumChars * 1000u) / t));
+  HID_RQ_GetStats(&_ReportQueue, &Stats);
+  SEGGER_RTT_printf(0, "Reports: %u sent, %u dropped, max. queue depth %u\n", (unsigned)Stats.NumSent, (unsigned)Stats.NumDropped, (unsigned)Stats.MaxDepth);
+}
+#endif
+
+/*********************************************************************
+*
+*       _OnKey
+*
+*  Function description
+*    Called by the BSP for every debounced key press and release.
+*    Queues the event and wakes the keyboard task.
+*/
+static void _OnKey(unsigned int KeyIndex, int IsPressed, unsigned long TimeStamp) {
+  KEY_EVENT Event;
+
+  Event.TimeStamp = TimeStamp;
+  Event.KeyIndex  = (unsigned char)KeyIndex;
+  Event.IsPressed = (unsigned char)IsPressed;
+  (void)KEY_RING_Put(&_KeyRing, &Event);
+  if (_pKeyTask != NULL) {
+    OS_TASKEVENT_Set(_pKeyTask, TASK_EVENT_KEY);
+  }
+}
+
+/*********************************************************************
+*
+*       _OnLedReport
+*
+*  Function description
+*    Applies an output report of the host to the board LEDs.
+*    Runs in the USB interrupt.
+*
+*  Parameters
+*    pData   : Output report.
+*    NumBytes: Number of bytes received.
+*/
+static void _OnLedReport(const U8 * pData, unsigned NumBytes) {
+  KEYBOARD_OUT_REPORT Report;
+  U32                 Cycles;
+
+  if (NumBytes < KBD_OUT_NUM_BYTES) {
+    return;
+  }
+  _UnpackOutReport(&Report, pData);
+  _LedState = Report.Leds;
+#if LED_CAPS_LOCK >= 0
+  if (Report.Leds & KBD_LED_CAPS_LOCK) {
+    BSP_SetLED(LED_CAPS_LOCK);
+  } else {
+    BSP_ClrLED(LED_CAPS_LOCK);
+  }
+#endif
+  Cycles            = DWT->CYCCNT - (U32)BSP_USB_GetISRTimeStamp();
+  _LedLatencyCycles = Cycles;
+  if (Cycles > _LedLatencyCyclesMax) {
+    _LedLatencyCyclesMax = Cycles;
+  }
+  _NumLedReports++;
+}
+
+/*********************************************************************
+*
+*       _OnLedRead
+*
+*  Function description
+*    Completion callback of USBD_ReadAsync() on the interrupt OUT
+*    endpoint. Runs in the USB interrupt.
+*
+*  Additional information
+*    The next read is started right away, so the endpoint is armed
+*    again before the host sends the next output report. A failed
+*    read (bus reset, disconnect) is not restarted here, it is
+*    restarted by _OnStateChange() when the device is configured.
+*/
+static void _OnLedRead(USB_ASYNC_IO_CONTEXT_POI pContext) {
+  if (pContext->Status != 0) {
+    _LedReadActive = 0;
+    return;
+  }
+  _OnLedReport((const U8 *)pContext->pData, pContext->NumBytesTransferred);
+  USBD_ReadAsync(_EPOut, pContext, 1);
+}
+
+/*********************************************************************
+*
+*       _StartLedRead
+*
+*  Function description
+*    Arms the interrupt OUT endpoint for the next output report.
+*    Called from the USB interrupt (state change callback).
+*/
+static void _StartLedRead(void) {
+  if (_LedReadActive == 0u) {
+    _LedReadActive                     = 1;
+    _LedReadContext.pData              = _abLedReport;
+    _LedReadContext.NumBytesToTransfer = sizeof(_abLedReport);
+    _LedReadContext.pfOnComplete       = _OnLedRead;
+    USBD_ReadAsync(_EPOut, &_LedReadContext, 1);
+  }
+}
+
+/*********************************************************************
+*
+*       _OnSetReport
+*
+*  Function description
+*    Called by the HID component when the host sends an output report
+*    with a SET_REPORT request on the control endpoint. Hosts use this
+*    path instead of the interrupt OUT endpoint e.g. in boot protocol.
+*/
+static void _OnSetReport(USB_HID_REPORT_TYPE ReportType, unsigned ReportId, U32 NumBytes) {
+  U8  abReport[KBD_OUT_NUM_BYTES];
+  int r;
+
+  USB_USE_PARA(ReportId);
+  USB_USE_PARA(NumBytes);
+  if (ReportType == USB_HID_REPORT_TYPE_OUTPUT) {
+    r = USBD_HID_ReadReport(_hInst, abReport, sizeof(abReport));
+    if (r > 0) {
+      _OnLedReport(abReport, (unsigned)r);
     }
-    for (j = 0; j < sizeof(_aScanCode2StringTable)/sizeof(_aScanCode2StringTable[0]); j++) {
-      if (_aScanCode2StringTable[j].cCharacter == cTemp) {
-        ac[2] = _aScanCode2StringTable[j].KeyCode;
+  }
+}
+
+/*********************************************************************
+*
+*       _OnStateChange
+*
+*  Function description
+*    Wakes the keyboard task when the USB device state changes
+*    (e.g. configured, suspended or detached).
+*/
+static void _OnStateChange(void * pContext, U8 NewState) {
+  USB_USE_PARA(pContext);
+  if ((NewState & (USB_STAT_CONFIGURED | USB_STAT_SUSPENDED)) == USB_STAT_CONFIGURED) {
+    _StartLedRead();
+  }
+  if (_pKeyTask != NULL) {
+    OS_TASKEVENT_Set(_pKeyTask, TASK_EVENT_USB_STATE);
+  }
+}
+
+/*********************************************************************
+*
+*       _OnReportSent
+*
+*  Function description
+*    Called by the report queue from the USB interrupt when a slot
+*    becomes free. Completes a pending latency measurement and wakes
+*    the keyboard task if it waits for a slot.
+*/
+static void _OnReportSent(void * pContext, int Status) {
+  U32 ReportNo;
+
+  USB_USE_PARA(pContext);
+  ReportNo = _LatencyReportNo;
+  if (ReportNo != 0u) {
+    if (Status != 0) {
+      _LatencyReportNo = 0;          // Queue flushed, report never reached the host.
+    } else if ((I32)(HID_RQ_GetSentSeq(&_ReportQueue) - ReportNo) >= 0) {
+      _LatencyCycles   = DWT->CYCCNT - _LatencyStart;
+      _LatencyReportNo = 0;
+      if (_LatencyCycles > _LatencyCyclesMax) {
+        _LatencyCyclesMax = _LatencyCycles;
       }
     }
-    USBD_HID_Write(_hInst, &ac[0], 8, 0);
-    memset(ac, 0, sizeof(ac));
-    //
-    // Send a 0 field packet to tell the host that the key has been released
-    //
-    USBD_HID_Write(_hInst, &ac[0], 8, 0);
-    USB_OS_Delay(50);
+  }
+  if (_pKeyTask != NULL) {
+    OS_TASKEVENT_Set(_pKeyTask, TASK_EVENT_REPORT_SENT);
+  }
+}
+
+/*********************************************************************
+*
+*       _StartLatency
+*
+*  Function description
+*    Starts the latency measurement for the next report queued.
+*
+*  Parameters
+*    TimeStamp: DWT cycle counter at the first edge of the key.
+*/
+static void _StartLatency(U32 TimeStamp) {
+  _LatencyReportNo = 0;
+  _LatencyCycles   = 0;
+  _LatencyStart    = TimeStamp;
+  _LatencyReportNo = HID_RQ_GetQueuedSeq(&_ReportQueue) + 1u;
+}
+
+#if SHOW_LATENCY
+/*********************************************************************
+*
+*       _ShowLatency
+*
+*  Function description
+*    Waits until the measured report has been fetched and prints
+*    the latency via RTT.
+*/
+static void _ShowLatency(void) {
+  U32 CyclesPerUs;
+
+  _WaitReportsSent();
+  if (_LatencyCycles != 0u) {
+    CyclesPerUs = SystemCoreClock / 1000000u;
+    SEGGER_RTT_printf(0, "Key to host: %u us (max. %u us), poll interval %u us\n",
+                      (unsigned)(_LatencyCycles / CyclesPerUs), (unsigned)(_LatencyCyclesMax / CyclesPerUs), _PollIntervalUs);
+  }
+}
+#endif
+
+#if SHOW_LED_LATENCY
+/*********************************************************************
+*
+*       _ShowLedLatency
+*
+*  Function description
+*    Prints the LED state and the latency of the last LED update via RTT.
+*/
+static void _ShowLedLatency(void) {
+  U32 CyclesPerUs;
+
+  if (_NumLedReports != 0u) {
+    CyclesPerUs = SystemCoreClock / 1000000u;
+    SEGGER_RTT_printf(0, "LED report #%u: 0x%02X, IRQ to GPIO: %u ns (max. %u ns)\n",
+                      (unsigned)_NumLedReports, (unsigned)_LedState,
+                      (unsigned)(_LedLatencyCycles * 1000u / CyclesPerUs), (unsigned)(_LedLatencyCyclesMax * 1000u / CyclesPerUs));
+  }
+}
+#endif
+
+#if SHOW_SCAN_CYCLES && BSP_KEY_MATRIX_ENABLE
+/*********************************************************************
+*
+*       _ShowScanCycles
+*
+*  Function description
+*    Prints the CPU time of the last and the longest key matrix scan via RTT.
+*/
+static void _ShowScanCycles(void) {
+  unsigned long Last;
+  unsigned long Max;
+  U32           CyclesPerUs;
+
+  BSP_KEY_GetScanCycles(&Last, &Max);
+  CyclesPerUs = SystemCoreClock / 1000000u;
+  SEGGER_RTT_printf(0, "Matrix scan (%u rows): %u cycles, %u ns (max. %u ns)\n",
+                    (unsigned)BSP_KEY_MATRIX_NUM_ROWS, (unsigned)Last,
+                    (unsigned)(Last * 1000u / CyclesPerUs), (unsigned)(Max * 1000u / CyclesPerUs));
+}
+#endif
+
+#if SHOW_IRQ_LATENCY
+/*********************************************************************
+*
+*       _ShowIrqLatency
+*
+*  Function description
+*    Prints the max. SysTick latency and the longest critical section
+*    of the USB stack via RTT.
+*/
+static void _ShowIrqLatency(void) {
+  U32 CyclesPerUs;
+
+  CyclesPerUs = SystemCoreClock / 1000000u;
+  SEGGER_RTT_printf(0, "SysTick latency: max. %u ns, USB critical section: max. %u us (%s masked)\n",
+                    (unsigned)(BSP_GetMaxTickLatency() * 1000u / CyclesPerUs), (unsigned)(USB_OS_GetMaxLockTime() / CyclesPerUs),
+                    (USBD_OS_USE_USBD_X_INTERRUPT > 0) ? "OTG_FS" : "all embOS interrupts");
+#if BSP_IRQ_MEASURE_LATENCY
+  {
+    unsigned long NumProbes;
+    unsigned long Cycles;
+
+    BSP_IRQ_PrintLatency();
+    Cycles = BSP_IRQ_GetProbeLatency(BSP_IRQ_ID_UART, &NumProbes);
+    SEGGER_RTT_printf(0, "USART3 latency under load: max. %u ns (%u probes, USBD_OS_USE_USBD_X_INTERRUPT = %u)\n",
+                      (unsigned)(Cycles * 1000u / CyclesPerUs), (unsigned)NumProbes, (unsigned)USBD_OS_USE_USBD_X_INTERRUPT);
+  }
+#endif
+#if BSP_USB_MEASURE_ISR_ENTRY
+  SEGGER_RTT_printf(0, "OTG_FS entry: %u cycles (%s)\n",
+                    (unsigned)BSP_USB_MeasureISREntry(), (BSP_USB_USE_RAM_VECTORS > 0) ? "RAM vector" : "OTG_FS_IRQHandler");
+#endif
+}
+#endif
+
+#if SHOW_FIFO_BUDGET
+/*********************************************************************
+*
+*       _ShowFifoBudget
+*
+*  Function description
+*    Prints the FIFO RAM required by the endpoints via RTT.
+*/
+static void _ShowFifoBudget(void) {
+  BSP_USB_FIFO_BUDGET Budget;
+  int                 r;
+
+  r = BSP_USB_FIFO_GetBudget(&Budget);
+  SEGGER_RTT_printf(0, "USB FIFO: %u IN EPs, %u OUT EPs, RX %u + TX %u of %u bytes, %u free%s\n",
+                    Budget.NumINEPs, Budget.NumOUTEPs, Budget.NumBytesRx, Budget.NumBytesTx,
+                    Budget.NumBytesTotal, Budget.NumBytesFree, (r < 0) ? " (exceeded!)" : "");
+}
+#endif
+
+#if SHOW_BOOT_TIME
+/*********************************************************************
+*
+*       _ShowBootTime
+*
+*  Function description
+*    Prints the boot time line via RTT once.
+*/
+static void _ShowBootTime(void) {
+  static int _IsShown;
+
+  if (_IsShown == 0) {
+    _IsShown = 1;
+    BSP_BOOT_Print();
   }
 }
+#endif
 
 #if (SEND_RETURN == 1)
 /*********************************************************************
@@ -259,17 +814,7 @@ static void _Output(const char *sString) {
 *    Outputs a return character
 */
 static void _SendReturnCharacter(void) {
-  U8 ac[8];
-
-  memset(ac, 0, sizeof(ac));
-  ac[2] = 0x28;
-  USBD_HID_Write(_hInst, &ac[0], 8, 0);
-  memset(ac, 0, sizeof(ac));
-  //
-  // Send a 0 field packet to tell the host that the key has been released
-  //
-  USBD_HID_Write(_hInst, &ac[0], 8, 0);
-  USB_OS_Delay(50);
+  _Output("\n");
 }
 #endif
 
@@ -279,6 +824,25 @@ static void _SendReturnCharacter(void) {
 *
 **********************************************************************
 */
+/*********************************************************************
+*
+*       USBD_HID_Keyboard_SetPollInterval
+*
+*  Function description
+*    Sets the poll interval of the keyboard endpoints.
+*
+*  Parameters
+*    IntervalUs: Poll interval in microseconds. Rounded down to whole
+*                frames and limited to 1..255 ms on a full-speed device.
+*
+*  Additional information
+*    The interval is part of the endpoint descriptor. The function
+*    must be called before USBD_HID_Keyboard_Init().
+*/
+void USBD_HID_Keyboard_SetPollInterval(unsigned IntervalUs) {
+  _PollIntervalUs = IntervalUs;
+}
+
 /*********************************************************************
 *
 *       USBD_HID_Keyboard_Init
@@ -287,29 +851,52 @@ static void _SendReturnCharacter(void) {
 *    Add HID keyboard to USB stack
 */
 void USBD_HID_Keyboard_Init(void) {
-  static U8           _abOutBuffer[USB_HS_INT_MAX_PACKET_SIZE];
+  static U8           _abOutBuffer[KBD_OUT_NUM_BYTES];
   USB_HID_INIT_DATA   InitData;
   USB_ADD_EP_INFO     EPIntIn;
   USB_ADD_EP_INFO     EPIntOut;
+  unsigned            Interval;
 
+  Interval = (_PollIntervalUs / (EP_INTERVAL_UNIT_US * EP_INTERVAL_MIN)) * EP_INTERVAL_MIN;
+  if (Interval < EP_INTERVAL_MIN) {
+    Interval = EP_INTERVAL_MIN;
+  } else if (Interval > EP_INTERVAL_MAX) {
+    Interval = EP_INTERVAL_MAX;
+  }
   memset(&InitData, 0, sizeof(InitData));
   EPIntIn.Flags = 0;                             // Flags not used.
   EPIntIn.InDir = USB_DIR_IN;                    // IN direction (Device to Host)
-  EPIntIn.Interval = 64;                            // Interval of 8 ms (125 us * 64)
-  EPIntIn.MaxPacketSize = USB_HS_INT_MAX_PACKET_SIZE;    // Maximum packet size (64 for Interrupt).
+  EPIntIn.Interval = (U16)Interval;               // In units of 125 us, converted to frames by the stack.
+  EPIntIn.MaxPacketSize = KBD_IN_NUM_BYTES;             // One input report per packet.
   EPIntIn.TransferType = USB_TRANSFER_TYPE_INT;         // Endpoint type - Interrupt.
   InitData.EPIn = USBD_AddEPEx(&EPIntIn, NULL, 0);
+  BSP_USB_FIFO_AddEP(USB_DIR_IN, EPIntIn.MaxPacketSize);
 
   EPIntOut.Flags = 0;                             // Flags not used.
   EPIntOut.InDir = USB_DIR_OUT;                   // OUT direction (Host to Device)
-  EPIntOut.Interval = 64;                            // Interval of 8 ms (125 us * 64)
-  EPIntOut.MaxPacketSize = USB_HS_INT_MAX_PACKET_SIZE;    // Maximum packet size (64 for Interrupt).
+  EPIntOut.Interval = (U16)Interval;               // In units of 125 us, converted to frames by the stack.
+  EPIntOut.MaxPacketSize = KBD_OUT_NUM_BYTES;           // One output report per packet.
   EPIntOut.TransferType = USB_TRANSFER_TYPE_INT;         // Endpoint type - Interrupt.
   InitData.EPOut = USBD_AddEPEx(&EPIntOut, _abOutBuffer, sizeof(_abOutBuffer));
+  BSP_USB_FIFO_AddEP(USB_DIR_OUT, EPIntOut.MaxPacketSize);
 
   InitData.pReport = _aHIDReport;
   InitData.NumBytesReport = sizeof(_aHIDReport);
   _hInst = USBD_HID_Add(&InitData);
+  _EPOut = InitData.EPOut;
+  USBD_HID_SetOnSetReportRequest(_hInst, _OnSetReport);
+  HID_RQ_Init(&_ReportQueue, InitData.EPIn, _abReportBuffer, KBD_IN_NUM_BYTES, NUM_QUEUED_REPORTS);
+  KEY_PACK_Init(&_KeyPack, KEYS_PER_REPORT, _SendReport, NULL);
+  HID_RQ_SetOnSent(&_ReportQueue, _OnReportSent, NULL);
+#if SHOW_READY_TO_IN
+  HID_SCHED_Init(&_Sched, &_ReportQueue, (Interval * EP_INTERVAL_UNIT_US), 0);
+#endif
+  USBD_RegisterSCHook(&_UsbStateHook, _OnStateChange, NULL);
+  KEY_RING_Init(&_KeyRing, _aKeyEvent, KEY_EVENT_BUFFER_SIZE);
+  BSP_KEY_SetCallback(_OnKey);
+#if SHOW_FIFO_BUDGET
+  _ShowFifoBudget();
+#endif
 }
 
 /*********************************************************************
@@ -320,52 +907,96 @@ void USBD_HID_Keyboard_Init(void) {
 *    Performs the HID echo1 operation
 */
 void USBD_HID_Keyboard_RunTask(void * pPara) {
+#if SHOW_TYPING_RATE
+  const char * sInfo0 = "This sample is based on the SEGGER emUSB-Device software with an HID component. ";
+  const char * sInfo1 = "For further information please visit: www.segger.com ";
+#else
   //const char * sInfo0 = "This sample is based on the SEGGER emUSB-Device software with an HID component. ";
   //const char * sInfo1 = "For further information please visit: www.segger.com ";
-  const char * char_s = "S";
-  const char * char_t = "T";
-  const char * char_m = "M";
+#endif
+  static const char * const _asKeyText[BSP_KEY_NUM_EXTI] = { "S", "T", "M" };
+#if BSP_KEY_MATRIX_ENABLE
+  static const char         _acMatrixKeyChar[] = "1234567890abcdefghijklmnopqrstuvwxyz";  // Typed by matrix key n (modulo length)
+  char                      acMatrixText[2];
+#endif
+  const char *              sText;
+  KEY_EVENT                 Event;
 
   USB_USE_PARA(pPara);
+  _pKeyTask = OS_TASK_GetID();
+#if SHOW_IRQ_LATENCY && BSP_IRQ_MEASURE_LATENCY
+  BSP_IRQ_StartProbe(BSP_IRQ_ID_UART, IRQ_PROBE_PERIOD_US);
+#endif
   while (1) {
 
     //
     // Wait for configuration
     //
-    while ((USBD_GetState() & (USB_STAT_CONFIGURED | USB_STAT_SUSPENDED)) != USB_STAT_CONFIGURED) {
-      BSP_ToggleLED(0);
-      USB_OS_Delay(50);
+    if ((USBD_GetState() & (USB_STAT_CONFIGURED | USB_STAT_SUSPENDED)) != USB_STAT_CONFIGURED) {
+      while ((USBD_GetState() & (USB_STAT_CONFIGURED | USB_STAT_SUSPENDED)) != USB_STAT_CONFIGURED) {
+        BSP_ToggleLED(0);
+        USB_OS_Delay(50);
+      }
+      USB_OS_Delay(100);
+      BSP_SetLED(0);
+#if SHOW_BOOT_TIME
+      _ShowBootTime();
+#endif
     }
-    USB_OS_Delay(100);
-    BSP_SetLED(0);
     //
     // The "_SendReturnCharacter()" line can be added if desired. Please set
     // the SEND_RETURN define to 1 in the "Defines, configurable" section of this file.
     // This function will send a Return/Enter key to the host.
     // In some cases this is not wanted as a return key may have undesired behavior.
     //
-    
-    if(user_flags & (1<<0)){
-      _Output(char_s);
-      #if (SEND_RETURN == 1)
-         _SendReturnCharacter();
-      #endif
-      user_flags &= ~(1<<0);
-    }
-    if(user_flags & (1<<1)){
-      _Output(char_t);
-      #if (SEND_RETURN == 1)
-         _SendReturnCharacter();
-      #endif
-      user_flags &= ~(1<<1);
-    }
-    if(user_flags & (1<<2)){
-      _Output(char_m);
-      #if (SEND_RETURN == 1)
-         _SendReturnCharacter();
-      #endif
-      user_flags &= ~(1<<2);
+    while (KEY_RING_Get(&_KeyRing, &Event)) {
+      if (Event.IsPressed == 0u) {
+        continue;
+      }
+      if (Event.KeyIndex < SEGGER_COUNTOF(_asKeyText)) {
+        sText = _asKeyText[Event.KeyIndex];
+#if BSP_KEY_MATRIX_ENABLE
+      } else if (Event.KeyIndex < BSP_KEY_NUM_KEYS) {
+        acMatrixText[0] = _acMatrixKeyChar[(Event.KeyIndex - BSP_KEY_MATRIX_FIRST) % (sizeof(_acMatrixKeyChar) - 1u)];
+        acMatrixText[1] = 0;
+        sText           = acMatrixText;
+#endif
+      } else {
+        continue;
+      }
+#if SHOW_TYPING_RATE
+      if (Event.KeyIndex == 0u) {
+        _OutputTimed(sInfo0);
+        _OutputTimed(sInfo1);
+        continue;
+      }
+#endif
+      _StartLatency(Event.TimeStamp);
+      _Output(sText);
+#if SHOW_LATENCY
+      _ShowLatency();
+#endif
+#if SHOW_LED_LATENCY
+      _ShowLedLatency();
+#endif
+#if SHOW_IRQ_LATENCY
+      _ShowIrqLatency();
+#endif
+#if SHOW_SCAN_CYCLES && BSP_KEY_MATRIX_ENABLE
+      _ShowScanCycles();
+#endif
+#if SHOW_READY_TO_IN
+      HID_SCHED_Export(&_Sched, "Keyboard");
+#endif
+#if (SEND_RETURN == 1)
+      _SendReturnCharacter();
+#endif
     }
+    //
+    // Sleep until a key is pressed or the USB state changes.
+    // Events arriving while typing are kept and end this wait immediately.
+    //
+    OS_TASKEVENT_GetBlocked(TASK_EVENT_KEY | TASK_EVENT_USB_STATE);
 /*
     _Output(sInfo0);
 #if (SEND_RETURN == 1)
@@ -392,22 +1023,12 @@ void MainTask(void) {
   USBD_Init();
   USBD_SetDeviceInfo(&_DeviceInfo);
   USBD_HID_Keyboard_Init();
+#if USE_CDC_SERIAL
+  CDC_SERIAL_Add();
+#endif
   USBD_Start();
   USBD_HID_Keyboard_RunTask(NULL);
 }
-void EXTI15_10_IRQHandler(void){
-  switch(EXTI->PR & (EXTI_PR_PR10|EXTI_PR_PR11|EXTI_PR_PR12)){
-      case EXTI_PR_PR10:
-        user_flags |= (1<<0);
-        break;
-      case EXTI_PR_PR11:
-        user_flags |= (1<<1);
-        break;
-      case EXTI_PR_PR12:
-        user_flags |= (1<<2);
-        break;
-  } 
-  EXTI->PR |= EXTI_PR_PR10|EXTI_PR_PR11|EXTI_PR_PR12;
-}
+
 #endif
 /**************************** end of file ***************************/
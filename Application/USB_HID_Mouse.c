@@ -30,6 +30,8 @@ Additional information:
 
   Expected behavior:
     The mouse cursor constantly jumps from left to right and back.
+    With MOUSE_ABSOLUTE set to 1, the cursor moves smoothly along
+    a rectangle in the middle of the screen instead.
 
   Sample output:
     The target side does not produce terminal output.
@@ -42,9 +44,14 @@ Additional information:
 **********************************************************************
 */
 #include <string.h>
+#include "RTOS.h"
 #include "USB.h"
 #include "USB_HID.h"
 #include "BSP.h"
+#include "HID_ReportQueue.h"
+#include "BSP_USB.h"
+#include "HID_ReportDesc.h"
+#include "HID_FrameSched.h"
 
 /*********************************************************************
 *
@@ -55,6 +62,82 @@ Additional information:
 #ifndef USBD_SAMPLE_NO_MAINTASK
 #define USBD_SAMPLE_NO_MAINTASK  0
 #endif
+//
+// Number of mouse reports which can be queued for the IN endpoint.
+//
+#ifndef NUM_QUEUED_REPORTS
+#define NUM_QUEUED_REPORTS       4u
+#endif
+//
+// Default poll interval of the interrupt IN endpoint [us].
+// Can be changed with USBD_HID_Mouse_SetPollInterval() before USBD_HID_Mouse_Init().
+//
+#ifndef POLL_INTERVAL_US
+#define POLL_INTERVAL_US         1000u
+#endif
+//
+// If set to 1, the mouse reports absolute 16-bit coordinates instead of
+// relative movements. The motion planner interpolates the path into
+// one report per poll interval.
+//
+#ifndef MOUSE_ABSOLUTE
+#define MOUSE_ABSOLUTE           0
+#endif
+//
+// Time for one segment of the path in absolute mode [ms].
+//
+#ifndef MOVE_DURATION_MS
+#define MOVE_DURATION_MS         500u
+#endif
+//
+// Absolute mode: Time before the start of the frame in which the host
+// polls the endpoint at which the next report is computed and queued [us],
+// see HID_FrameSched.c. With 0, it is queued as soon as the previous report
+// has been fetched. A small lead time lets the report carry the latest
+// position. Must be less than one frame (1000 us).
+//
+#ifndef REPORT_LEAD_US
+#define REPORT_LEAD_US           0u
+#endif
+
+/*********************************************************************
+*
+*       Defines, fixed
+*
+**********************************************************************
+*/
+//
+// Fields of the mouse input report, see HID_ReportDesc.h.
+// _aHIDReport, MOUSE_REPORT and _PackReport() / _UnpackReport() are generated from this list.
+// In absolute mode X and Y cover the whole screen with 0..MOUSE_ABS_MAX.
+//
+#define MOUSE_ABS_MAX            32767
+#if MOUSE_ABSOLUTE
+#define MOUSE_IN_FIELDS(BITS, BYTES, WORDS, PAD, Ctx)                                                                                          \
+  BITS (Ctx, Buttons, USB_HID_USAGE_PAGE_BUTTON,          1,               3,               0,    1,             1, 3, USB_HID_VARIABLE) \
+  PAD  (Ctx, Pad0,    5)                                                                                                              \
+  WORDS(Ctx, X,       USB_HID_USAGE_PAGE_GENERIC_DESKTOP, USB_HID_USAGE_X, USB_HID_USAGE_X, 0,    MOUSE_ABS_MAX,    1, USB_HID_VARIABLE | USB_HID_ABSOLUTE) \
+  WORDS(Ctx, Y,       USB_HID_USAGE_PAGE_GENERIC_DESKTOP, USB_HID_USAGE_Y, USB_HID_USAGE_Y, 0,    MOUSE_ABS_MAX,    1, USB_HID_VARIABLE | USB_HID_ABSOLUTE)
+#else
+#define MOUSE_IN_FIELDS(BITS, BYTES, WORDS, PAD, Ctx)                                                                                          \
+  BITS (Ctx, Buttons, USB_HID_USAGE_PAGE_BUTTON,          1,               3,               0,    1,   1, 3, USB_HID_VARIABLE)         \
+  PAD  (Ctx, Pad0,    5)                                                                                                              \
+  BYTES(Ctx, X,       USB_HID_USAGE_PAGE_GENERIC_DESKTOP, USB_HID_USAGE_X, USB_HID_USAGE_X, -127, 127,    1, USB_HID_VARIABLE | USB_HID_RELATIVE) \
+  BYTES(Ctx, Y,       USB_HID_USAGE_PAGE_GENERIC_DESKTOP, USB_HID_USAGE_Y, USB_HID_USAGE_Y, -127, 127,    1, USB_HID_VARIABLE | USB_HID_RELATIVE)
+#endif
+//
+// USB_ADD_EP_INFO.Interval is given in 125 us units. The stack converts it
+// into frames (1 ms) for a full-speed device, which is the only speed
+// of the OTG_FS controller used here. One frame is therefore the minimum.
+//
+#define EP_INTERVAL_UNIT_US      125u
+#define EP_INTERVAL_MIN          (1000u / EP_INTERVAL_UNIT_US)
+#define EP_INTERVAL_MAX          (255u * EP_INTERVAL_MIN)     // bInterval of a full-speed interrupt endpoint is 1..255 ms.
+//
+// Task events of the mouse task.
+//
+#define TASK_EVENT_REPORT_SENT   (1u << 0)   // A report slot of _ReportQueue became free.
+#define TASK_EVENT_SLOT          (1u << 1)   // Slot of _Sched reached, REPORT_LEAD_US before the next poll.
 
 /*********************************************************************
 *
@@ -67,11 +150,42 @@ extern "C" {     /* Make sure we have C-declarations in C++ programs */
 #endif
   void MainTask(void);
   void USBD_HID_Mouse_Init(void);
+  void USBD_HID_Mouse_SetPollInterval(unsigned IntervalUs);
   void USBD_HID_Mouse_RunTask(void *);
 #ifdef __cplusplus
 }
 #endif
 
+/*********************************************************************
+*
+*       Local data definitions
+*
+**********************************************************************
+*/
+typedef struct {
+  HID_REPORT_STRUCT(MOUSE_IN_FIELDS)
+} MOUSE_REPORT;
+
+HID_REPORT_LAYOUT(MOUSE_IN_FIELDS, MOUSE_IN)
+_Static_assert(MOUSE_IN_NUM_BYTES <= USB_FS_INT_MAX_PACKET_SIZE, "Mouse report must fit into one full-speed interrupt packet");
+
+#if MOUSE_ABSOLUTE
+//
+// Linear motion from the current position to a target. Positions are
+// kept in 16.16 fixed point, so the sub-unit remainder of each step is
+// carried over instead of being rounded away every frame.
+//
+typedef struct {
+  U32      x;                 // Current position, 16.16 fixed point.
+  U32      y;
+  I32      dx;                // Movement per frame, 16.16 fixed point.
+  I32      dy;
+  U16      TargetX;
+  U16      TargetY;
+  unsigned NumFrames;         // Frames left until the target is reached.
+} MOTION_PLANNER;
+#endif
+
 /*********************************************************************
 *
 *       Static const data
@@ -99,43 +213,298 @@ static const USB_DEVICE_INFO _DeviceInfo = {
 *  This report is generated according to HID spec and
 *  HID Usage Tables specifications.
 */
-const U8 _aHIDReport[] = {
+static const U8 _aHIDReport[] = {
   USB_HID_GLOBAL_USAGE_PAGE + 1, USB_HID_USAGE_PAGE_GENERIC_DESKTOP,
   USB_HID_LOCAL_USAGE + 1, USB_HID_USAGE_MOUSE,
   USB_HID_MAIN_COLLECTION + 1, USB_HID_COLLECTION_APPLICATION,
     USB_HID_LOCAL_USAGE + 1, USB_HID_USAGE_POINTER,
     USB_HID_MAIN_COLLECTION + 1, USB_HID_COLLECTION_PHYSICAL,
-      USB_HID_GLOBAL_USAGE_PAGE + 1, USB_HID_USAGE_PAGE_BUTTON,
-      USB_HID_LOCAL_USAGE_MINIMUM + 1, 1,
-      USB_HID_LOCAL_USAGE_MAXIMUM + 1, 3,
-      USB_HID_GLOBAL_LOGICAL_MINIMUM + 1, 0,
-      USB_HID_GLOBAL_LOGICAL_MAXIMUM + 1, 1,
-      USB_HID_GLOBAL_REPORT_COUNT + 1, 3,
-      USB_HID_GLOBAL_REPORT_SIZE + 1, 1,
-      USB_HID_MAIN_INPUT + 1, USB_HID_VARIABLE,  // 3 button bits
-      USB_HID_GLOBAL_REPORT_COUNT + 1, 1,
-      USB_HID_GLOBAL_REPORT_SIZE + 1, 5,
-      USB_HID_MAIN_INPUT + 1, USB_HID_CONSTANT,  // 5 bit padding
-      USB_HID_GLOBAL_USAGE_PAGE + 1, USB_HID_USAGE_PAGE_GENERIC_DESKTOP,
-      USB_HID_LOCAL_USAGE + 1, USB_HID_USAGE_X,
-      USB_HID_LOCAL_USAGE + 1, USB_HID_USAGE_Y,
-      USB_HID_GLOBAL_LOGICAL_MINIMUM + 1, (unsigned char) -127,
-      USB_HID_GLOBAL_LOGICAL_MAXIMUM + 1, 127,
-      USB_HID_GLOBAL_REPORT_SIZE + 1, 8,
-      USB_HID_GLOBAL_REPORT_COUNT + 1, 2,
-      USB_HID_MAIN_INPUT + 1, USB_HID_VARIABLE | USB_HID_RELATIVE,
+      HID_REPORT_ITEMS(MOUSE_IN_FIELDS, USB_HID_MAIN_INPUT)
     USB_HID_MAIN_ENDCOLLECTION,
   USB_HID_MAIN_ENDCOLLECTION
 };
 
 
+/*********************************************************************
+*
+*       Static data
+*
+**********************************************************************
+*/
+static USB_HID_HANDLE   _hInst;
+static U8               _abReportBuffer[NUM_QUEUED_REPORTS * MOUSE_IN_NUM_BYTES];
+static HID_REPORT_QUEUE _ReportQueue;
+static unsigned         _PollIntervalUs = POLL_INTERVAL_US;
+static unsigned         _FrameUs;         // Actual poll interval of the endpoint.
+#if MOUSE_ABSOLUTE
+static OS_TASK *        _pMouseTask;      // Woken by _OnReportSent(), NULL until the task runs.
+#if REPORT_LEAD_US
+static HID_SCHED        _Sched;
+#endif
+#endif
+
 /*********************************************************************
 *
 *       Static code
 *
 **********************************************************************
 */
-static USB_HID_HANDLE _hInst;
+
+/*********************************************************************
+*
+*       _PackReport / _UnpackReport
+*
+*  Function description
+*    Convert between MOUSE_REPORT and the report sent on the endpoint.
+*/
+HID_REPORT_PACK  (MOUSE_IN_FIELDS, MOUSE_IN, _PackReport,   MOUSE_REPORT)
+HID_REPORT_UNPACK(MOUSE_IN_FIELDS, MOUSE_IN, _UnpackReport, MOUSE_REPORT)
+
+#if MOUSE_ABSOLUTE
+/*********************************************************************
+*
+*       _CoalesceMouseReport
+*
+*  Function description
+*    Replaces the position of the last queued report while a transfer
+*    is in flight. Only reports with identical button states are
+*    merged, so no click is lost. The newest position wins.
+*/
+static int _CoalesceMouseReport(U8 * pQueued, const U8 * pNew, unsigned NumBytes) {
+  MOUSE_REPORT Queued;
+  MOUSE_REPORT New;
+
+  USB_USE_PARA(NumBytes);
+  _UnpackReport(&Queued, pQueued);
+  _UnpackReport(&New, pNew);
+  if (Queued.Buttons != New.Buttons) {
+    return 0;
+  }
+  _PackReport(pQueued, &New);
+  return 1;
+}
+
+/*********************************************************************
+*
+*       _MotionMoveTo
+*
+*  Function description
+*    Plans a linear movement from the current position to (x, y).
+*
+*  Parameters
+*    pPlanner   : Motion planner.
+*    x, y       : Target position, 0..MOUSE_ABS_MAX.
+*    DurationMs : Time for the movement. One report is sent per poll
+*                 interval, so this defines the number of frames.
+*/
+static void _MotionMoveTo(MOTION_PLANNER * pPlanner, U16 x, U16 y, unsigned DurationMs) {
+  unsigned NumFrames;
+
+  NumFrames = (DurationMs * 1000u) / _FrameUs;
+  if (NumFrames == 0u) {
+    NumFrames = 1;
+  }
+  pPlanner->TargetX   = x;
+  pPlanner->TargetY   = y;
+  pPlanner->dx        = ((I32)((U32)x << 16) - (I32)pPlanner->x) / (I32)NumFrames;
+  pPlanner->dy        = ((I32)((U32)y << 16) - (I32)pPlanner->y) / (I32)NumFrames;
+  pPlanner->NumFrames = NumFrames;
+}
+
+/*********************************************************************
+*
+*       _MotionNextFrame
+*
+*  Function description
+*    Advances the planned movement by one frame.
+*
+*  Return value
+*    == 0: Target already reached, pReport not changed.
+*    == 1: pReport contains the position for the next frame.
+*
+*  Additional information
+*    The last frame is set to the target exactly, so the rounding of
+*    the per-frame step never accumulates into a position error.
+*/
+static int _MotionNextFrame(MOTION_PLANNER * pPlanner, MOUSE_REPORT * pReport) {
+  if (pPlanner->NumFrames == 0u) {
+    return 0;
+  }
+  pPlanner->NumFrames--;
+  if (pPlanner->NumFrames == 0u) {
+    pPlanner->x = (U32)pPlanner->TargetX << 16;
+    pPlanner->y = (U32)pPlanner->TargetY << 16;
+  } else {
+    pPlanner->x += (U32)pPlanner->dx;
+    pPlanner->y += (U32)pPlanner->dy;
+  }
+  pReport->X[0] = (U16)((pPlanner->x + 0x8000u) >> 16);
+  pReport->Y[0] = (U16)((pPlanner->y + 0x8000u) >> 16);
+  return 1;
+}
+
+/*********************************************************************
+*
+*       _WaitFrame
+*
+*  Function description
+*    Waits until the host has fetched all queued reports, i.e. until
+*    the next poll of the endpoint can carry a new report.
+*/
+static void _WaitFrame(void) {
+  while (HID_RQ_GetDepth(&_ReportQueue) != 0u) {
+    OS_TASKEVENT_GetBlocked(TASK_EVENT_REPORT_SENT);
+  }
+}
+
+#if REPORT_LEAD_US
+/*********************************************************************
+*
+*       _WaitReportLead
+*
+*  Function description
+*    Waits until REPORT_LEAD_US before the next poll of the endpoint.
+*/
+static void _WaitReportLead(void) {
+  HID_SCHED_RequestSlot(&_Sched);
+  OS_TASKEVENT_GetBlocked(TASK_EVENT_SLOT);
+}
+#endif
+
+/*********************************************************************
+*
+*       _OnReportSent
+*
+*  Function description
+*    Called by the report queue from the USB interrupt when a slot
+*    becomes free. Wakes the mouse task.
+*/
+static void _OnReportSent(void * pContext, int Status) {
+  USB_USE_PARA(pContext);
+  USB_USE_PARA(Status);
+  if (_pMouseTask != NULL) {
+    OS_TASKEVENT_Set(_pMouseTask, TASK_EVENT_REPORT_SENT);
+  }
+}
+
+/*********************************************************************
+*
+*       _MoveCursor
+*
+*  Function description
+*    Moves the cursor once along a rectangle in the middle of the
+*    screen, sending one report per poll interval.
+*
+*  Additional information
+*    Each report is computed once the previous one has been fetched
+*    (and, with REPORT_LEAD_US, shortly before the next poll).
+*/
+static void _MoveCursor(MOTION_PLANNER * pPlanner) {
+  static const U16 _aPath[][2] = {
+    { MOUSE_ABS_MAX / 4,     MOUSE_ABS_MAX / 4     },
+    { MOUSE_ABS_MAX / 4 * 3, MOUSE_ABS_MAX / 4     },
+    { MOUSE_ABS_MAX / 4 * 3, MOUSE_ABS_MAX / 4 * 3 },
+    { MOUSE_ABS_MAX / 4,     MOUSE_ABS_MAX / 4 * 3 }
+  };
+  MOUSE_REPORT Report;
+  U8           ac[MOUSE_IN_NUM_BYTES];
+  unsigned     i;
+
+  memset(&Report, 0, sizeof(Report));
+  for (i = 0; i < SEGGER_COUNTOF(_aPath); i++) {
+    _MotionMoveTo(pPlanner, _aPath[i][0], _aPath[i][1], MOVE_DURATION_MS);
+    while (1) {
+      _WaitFrame();
+#if REPORT_LEAD_US
+      _WaitReportLead();
+#endif
+      if (_MotionNextFrame(pPlanner, &Report) == 0) {
+        break;
+      }
+      _PackReport(ac, &Report);
+      if ((USBD_GetState() & (USB_STAT_CONFIGURED | USB_STAT_SUSPENDED)) != USB_STAT_CONFIGURED) {
+        return;
+      }
+#if REPORT_LEAD_US
+      HID_SCHED_Put(&_Sched, &ac[0]);
+#else
+      HID_RQ_Put(&_ReportQueue, &ac[0]);
+#endif
+    }
+  }
+#if REPORT_LEAD_US
+  HID_SCHED_Export(&_Sched, "Mouse");
+#endif
+}
+
+#else
+/*********************************************************************
+*
+*       _AddDelta
+*
+*  Function description
+*    Adds two relative axis values. Returns 0 if the sum does not
+*    fit into the logical range -127..127 of the report.
+*/
+static int _AddDelta(U8 * pAxis, U8 Delta) {
+  int Sum;
+
+  Sum = (int)(signed char)*pAxis + (int)(signed char)Delta;
+  if ((Sum < -127) || (Sum > 127)) {
+    return 0;
+  }
+  *pAxis = (U8)Sum;
+  return 1;
+}
+
+/*********************************************************************
+*
+*       _CoalesceMouseReport
+*
+*  Function description
+*    Merges a mouse report into the last queued one while a transfer
+*    is in flight. Only reports with identical button states are
+*    merged, so no click is lost. The movements are added up.
+*/
+static int _CoalesceMouseReport(U8 * pQueued, const U8 * pNew, unsigned NumBytes) {
+  MOUSE_REPORT Queued;
+  MOUSE_REPORT New;
+
+  USB_USE_PARA(NumBytes);
+  _UnpackReport(&Queued, pQueued);
+  _UnpackReport(&New, pNew);
+  if (Queued.Buttons != New.Buttons) {
+    return 0;
+  }
+  if ((_AddDelta(&Queued.X[0], New.X[0]) == 0) || (_AddDelta(&Queued.Y[0], New.Y[0]) == 0)) {
+    return 0;
+  }
+  _PackReport(pQueued, &Queued);
+  return 1;
+}
+
+/*********************************************************************
+*
+*       _MoveCursor
+*
+*  Function description
+*    Lets the cursor jump to the left and back to the right.
+*/
+static void _MoveCursor(void) {
+  MOUSE_REPORT Report;
+  U8           ac[MOUSE_IN_NUM_BYTES];
+
+  memset(&Report, 0, sizeof(Report));
+  Report.X[0] = 20;   // To the left !
+  _PackReport(ac, &Report);
+  HID_RQ_Put(&_ReportQueue, &ac[0]);
+  USB_OS_Delay(500);
+  Report.X[0] = (U8)-20;  // To the right !
+  _PackReport(ac, &Report);
+  HID_RQ_Put(&_ReportQueue, &ac[0]);
+  USB_OS_Delay(100);
+}
+#endif
 
 /*********************************************************************
 *
@@ -143,6 +512,25 @@ static USB_HID_HANDLE _hInst;
 *
 **********************************************************************
 */
+/*********************************************************************
+*
+*       USBD_HID_Mouse_SetPollInterval
+*
+*  Function description
+*    Sets the poll interval of the mouse endpoint.
+*
+*  Parameters
+*    IntervalUs: Poll interval in microseconds. Rounded down to whole
+*                frames and limited to 1..255 ms on a full-speed device.
+*
+*  Additional information
+*    The interval is part of the endpoint descriptor. The function
+*    must be called before USBD_HID_Mouse_Init().
+*/
+void USBD_HID_Mouse_SetPollInterval(unsigned IntervalUs) {
+  _PollIntervalUs = IntervalUs;
+}
+
 /*********************************************************************
 *
 *       USBD_HID_Mouse_Init
@@ -153,18 +541,35 @@ static USB_HID_HANDLE _hInst;
 void USBD_HID_Mouse_Init(void) {
   USB_HID_INIT_DATA InitData;
   USB_ADD_EP_INFO   EPIntIn;
+  unsigned          Interval;
 
+  Interval = (_PollIntervalUs / (EP_INTERVAL_UNIT_US * EP_INTERVAL_MIN)) * EP_INTERVAL_MIN;
+  if (Interval < EP_INTERVAL_MIN) {
+    Interval = EP_INTERVAL_MIN;
+  } else if (Interval > EP_INTERVAL_MAX) {
+    Interval = EP_INTERVAL_MAX;
+  }
   memset(&InitData, 0, sizeof(InitData));
   EPIntIn.Flags           = 0;                             // Flags not used.
   EPIntIn.InDir           = USB_DIR_IN;                    // IN direction (Device to Host)
-  EPIntIn.Interval        = 64;                            // Interval of 8 ms (125 us * 64)
-  EPIntIn.MaxPacketSize   = USB_HS_INT_MAX_PACKET_SIZE;    // Maximum packet size (64 for Interrupt).
+  EPIntIn.Interval        = (U16)Interval;                 // In units of 125 us, converted to frames by the stack.
+  EPIntIn.MaxPacketSize   = MOUSE_IN_NUM_BYTES;            // One report per packet.
   EPIntIn.TransferType    = USB_TRANSFER_TYPE_INT;         // Endpoint type - Interrupt.
   InitData.EPIn = USBD_AddEPEx(&EPIntIn, NULL, 0);
+  BSP_USB_FIFO_AddEP(USB_DIR_IN, EPIntIn.MaxPacketSize);
 
   InitData.pReport = _aHIDReport;
   InitData.NumBytesReport = sizeof(_aHIDReport);
   _hInst = USBD_HID_Add(&InitData);
+  _FrameUs = Interval * EP_INTERVAL_UNIT_US;
+  HID_RQ_Init(&_ReportQueue, InitData.EPIn, _abReportBuffer, MOUSE_IN_NUM_BYTES, NUM_QUEUED_REPORTS);
+  HID_RQ_SetCoalesceFunc(&_ReportQueue, _CoalesceMouseReport);
+#if MOUSE_ABSOLUTE
+  HID_RQ_SetOnSent(&_ReportQueue, _OnReportSent, NULL);
+#if REPORT_LEAD_US
+  HID_SCHED_Init(&_Sched, &_ReportQueue, _FrameUs, REPORT_LEAD_US);
+#endif
+#endif
 }
 
 /*********************************************************************
@@ -173,10 +578,25 @@ void USBD_HID_Mouse_Init(void) {
 *
 *  Function description
 *    Performs the HID mouse operation
+*
+*  Additional information
+*    Reports are queued without waiting for the host. Movements
+*    queued while a report is in flight are merged, so the cursor
+*    position stays exact even if the task produces reports faster
+*    than the endpoint is polled.
 */
 void USBD_HID_Mouse_RunTask(void * pPara) {
-  U8 ac[3];
+#if MOUSE_ABSOLUTE
+  MOTION_PLANNER Planner;
 
+  memset(&Planner, 0, sizeof(Planner));
+  Planner.x = (U32)(MOUSE_ABS_MAX / 2) << 16;
+  Planner.y = (U32)(MOUSE_ABS_MAX / 2) << 16;
+  _pMouseTask = OS_TASK_GetID();
+#if REPORT_LEAD_US
+  HID_SCHED_SetSlotTask(&_Sched, _pMouseTask, TASK_EVENT_SLOT);
+#endif
+#endif
   USB_USE_PARA(pPara);
   while (1) {
 
@@ -188,14 +608,11 @@ void USBD_HID_Mouse_RunTask(void * pPara) {
       USB_OS_Delay(50);
     }
     BSP_SetLED(0);
-    memset(ac, 0, sizeof(ac));
-    ac[1] = 20;   // To the left !
-    USBD_HID_Write(_hInst, &ac[0], 3, 0);      // Make sure we send the number of bytes defined in REPORT
-    USB_OS_Delay(500);
-    ac[1] = (U8)-20;  // To the right !
-    USBD_HID_Write(_hInst, &ac[0], 3, 0);      // Make sure we send the number of bytes defined in REPORT
-    USB_OS_Delay(100);
-
+#if MOUSE_ABSOLUTE
+    _MoveCursor(&Planner);
+#else
+    _MoveCursor();
+#endif
   }
 }
 
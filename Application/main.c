@@ -33,6 +33,8 @@ Purpose : embOS sample program running two simple tasks, each toggling
 
 #include "RTOS.h"
 #include "BSP.h"
+#include "BSP_KEY.h"
+#include "BSP_BOOT.h"
 #include "USB.h"
 #include "USB_HID.h"
 #include "BSP_USB.h"
@@ -43,13 +45,29 @@ static OS_STACKPTR int Stack0[2048];  // Task stacks
 static OS_TASK         TCB0;          // Task control blocks
 
 
+/*********************************************************************
+*
+*       _MainTask()
+*
+*  Function description
+*    Records the start of the first task in the boot time line.
+*/
+static void _MainTask(void) {
+  BSP_BOOT_Mark(BSP_BOOT_MAIN_TASK);
+  MainTask();
+}
+
 /*****************************main()**********************************/
 
 int main(void) {
+  BSP_BOOT_Mark(BSP_BOOT_MAIN);
   OS_Init();    // Initialize embOS
   OS_InitHW();  // Initialize required hardware
+  BSP_BOOT_Mark(BSP_BOOT_OS_INIT_HW);
   BSP_Init();   // Initialize LED ports
-  OS_TASK_CREATE(&TCB0, "MainTask", 100, MainTask, Stack0);
+  BSP_KEY_Init();  // Initialize key interrupts and debouncing
+  BSP_BOOT_Mark(BSP_BOOT_BSP_INIT);
+  OS_TASK_CREATE(&TCB0, "MainTask", 100, _MainTask, Stack0);
   OS_Start();   // Start embOS
   return 0;
 }
@@ -115,6 +115,7 @@
   */
 
 #include "stm32f4xx.h"
+#include "BSP_BOOT.h"
 
 /**
   * @}
@@ -207,6 +208,9 @@ static void SetSysClock(void);
   */
 void SystemInit(void)
 {
+  /* Start the boot time line (DWT cycle counter) ----------------------------*/
+  BSP_BOOT_Start();
+
   /* FPU settings ------------------------------------------------------------*/
   #if (__FPU_PRESENT == 1) && (__FPU_USED == 1)
     SCB->CPACR |= ((3UL << 10*2)|(3UL << 11*2));  /* set CP10 and CP11 Full Access */
@@ -238,6 +242,7 @@ void SystemInit(void)
   /* Configure the System clock source, PLL Multiplier and Divider factors, 
      AHB/APBx prescalers and Flash settings ----------------------------------*/
   SetSysClock();
+  BSP_BOOT_Mark(BSP_BOOT_CLOCK_READY);
 
   /* Configure the Vector Table location add offset address ------------------*/
 #ifdef VECT_TAB_SRAM
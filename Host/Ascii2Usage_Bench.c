@@ -0,0 +1,273 @@
+/*********************************************************************
+-------------------------- END-OF-HEADER -----------------------------
+File    : Ascii2Usage_Bench.c
+Purpose : Host test and benchmark of the ASCII lookup (Ascii2Usage.c).
+
+Additional information:
+  _aScanCode2StringTable[] and _OldLookup() are the linear scan of the
+  original keyboard sample, copied unchanged, including its shift rule
+  for 0x41..0x60.
+
+  Checks for all 128 codes:
+    - Every character the old table could type maps to the same
+      modifier and usage ID.
+    - Every character with a key maps back to itself through the
+      inverse of the new table, only '\n' and '\r' share the Enter key.
+
+  Then both lookups are timed over all 128 codes, best of several
+  runs, and the time per character is printed.
+*/
+
+/*********************************************************************
+*
+*       #include section
+*
+**********************************************************************
+*/
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "Ascii2Usage.h"
+
+/*********************************************************************
+*
+*       Defines, configurable
+*
+**********************************************************************
+*/
+#define NUM_LOOPS           (20000u)     // Passes over all 128 codes per run.
+#define NUM_RUNS            (5u)
+
+/*********************************************************************
+*
+*       Types
+*
+**********************************************************************
+*/
+typedef struct {
+  unsigned short KeyCode;
+  char           cCharacter;
+} SCANCODE_TO_DESC;
+
+/*********************************************************************
+*
+*       Static const data
+*
+**********************************************************************
+*/
+static const SCANCODE_TO_DESC _aScanCode2StringTable[] = {
+  { 0x04, 'a'}, { 0x05, 'b'}, { 0x06, 'c'}, { 0x07, 'd'}, { 0x08, 'e'},
+  { 0x09, 'f'}, { 0x0A, 'g'}, { 0x0B, 'h'}, { 0x0C, 'i'}, { 0x0D, 'j'},
+  { 0x0E, 'k'}, { 0x0F, 'l'}, { 0x10, 'm'}, { 0x11, 'n'}, { 0x12, 'o'},
+  { 0x13, 'p'}, { 0x14, 'q'}, { 0x15, 'r'}, { 0x16, 's'}, { 0x17, 't'},
+  { 0x18, 'u'}, { 0x19, 'v'}, { 0x1A, 'w'}, { 0x1B, 'x'}, { 0x1C, 'y'},
+  { 0x1D, 'z'}, { 0x1E, '1'}, { 0x1F, '2'}, { 0x20, '3'}, { 0x21, '4'},
+  { 0x22, '5'}, { 0x23, '6'}, { 0x24, '7'}, { 0x25, '8'}, { 0x26, '9'},
+  { 0x27, '0'}, { 0x2C, ' '}, { 0x37, '.'}
+};
+
+/*********************************************************************
+*
+*       Static data
+*
+**********************************************************************
+*/
+static unsigned          _NumErrors;
+static volatile unsigned _Sink;           // Keeps the timed loops from being optimized away.
+
+/*********************************************************************
+*
+*       Static code
+*
+**********************************************************************
+*/
+
+/*********************************************************************
+*
+*       _Error
+*/
+static void _Error(const char * sText, unsigned v0, unsigned v1) {
+  if (_NumErrors < 20u) {
+    printf("  ");
+    printf(sText, v0, v1);
+    printf("\n");
+  }
+  _NumErrors++;
+}
+
+/*********************************************************************
+*
+*       _OldLookup
+*
+*  Function description
+*    Lookup of the original _Output(): shift for 0x41..0x60, then a
+*    linear scan of _aScanCode2StringTable[] for the lower case character.
+*/
+static void _OldLookup(char c, unsigned char * pModifier, unsigned char * pUsage) {
+  char     cTemp;
+  unsigned j;
+
+  *pModifier = 0;
+  *pUsage    = 0;
+  if (c < 0x61 && c >= 0x41) {
+    *pModifier = (1 << 1);
+    cTemp = tolower((int)c);
+  } else {
+    cTemp = c;
+  }
+  for (j = 0; j < sizeof(_aScanCode2StringTable)/sizeof(_aScanCode2StringTable[0]); j++) {
+    if (_aScanCode2StringTable[j].cCharacter == cTemp) {
+      *pUsage = (unsigned char)_aScanCode2StringTable[j].KeyCode;
+    }
+  }
+}
+
+/*********************************************************************
+*
+*       _Check
+*
+*  Function description
+*    Compares the new table with the old one and checks the round trip.
+*/
+static void _Check(void) {
+  const ASCII_TO_USAGE * pKey;
+  const ASCII_TO_USAGE * pOther;
+  unsigned char          Modifier;
+  unsigned char          Usage;
+  unsigned               c;
+  unsigned               d;
+  unsigned               NumOld;
+  unsigned               NumNew;
+
+  NumOld = 0;
+  NumNew = 0;
+  for (c = 0; c < 128u; c++) {
+    pKey = ASCII2USAGE_Get((unsigned char)c);
+    if (pKey == NULL) {
+      _Error("Code 0x%02X has no table entry", c, 0);
+      continue;
+    }
+    _OldLookup((char)c, &Modifier, &Usage);
+    if (Usage != 0u) {
+      NumOld++;
+      if ((pKey->Usage != Usage) || (pKey->Modifier != Modifier)) {
+        _Error("Code 0x%02X differs from the old table (usage 0x%02X)", c, pKey->Usage);
+      }
+    }
+    if (pKey->Usage == 0u) {
+      continue;
+    }
+    NumNew++;
+    if ((pKey->Modifier & (unsigned char)~ASCII2USAGE_MOD_LSHIFT) != 0u) {
+      _Error("Code 0x%02X uses modifier 0x%02X", c, pKey->Modifier);
+    }
+    //
+    // Inverse: No other character may be typed with the same key and modifier.
+    //
+    for (d = 0; d < 128u; d++) {
+      pOther = ASCII2USAGE_Get((unsigned char)d);
+      if ((d == c) || (pOther->Usage != pKey->Usage) || (pOther->Modifier != pKey->Modifier)) {
+        continue;
+      }
+      if (((c == '\n') && (d == '\r')) || ((c == '\r') && (d == '\n'))) {
+        continue;
+      }
+      _Error("Codes 0x%02X and 0x%02X are typed with the same key", c, d);
+    }
+  }
+  for (c = 128u; c < 256u; c++) {
+    if (ASCII2USAGE_Get((unsigned char)c) != NULL) {
+      _Error("Code 0x%02X is not 7-bit ASCII but has an entry", c, 0);
+    }
+  }
+  printf("Ascii2Usage: %u characters typed by the old table, %u by the new one\n", NumOld, NumNew);
+}
+
+/*********************************************************************
+*
+*       _GetNs
+*/
+static double _GetNs(void) {
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (double)t.tv_sec * 1e9 + (double)t.tv_nsec;
+}
+
+/*********************************************************************
+*
+*       _Bench
+*
+*  Function description
+*    Times both lookups, prints the best run in ns per character.
+*/
+static void _Bench(void) {
+  const ASCII_TO_USAGE * pKey;
+  unsigned char          Modifier;
+  unsigned char          Usage;
+  unsigned               Run;
+  unsigned               Loop;
+  unsigned               c;
+  unsigned               Sum;
+  double                 t;
+  double                 OldNs;
+  double                 NewNs;
+
+  OldNs = 1e30;
+  NewNs = 1e30;
+  for (Run = 0; Run < NUM_RUNS; Run++) {
+    Sum = 0;
+    t   = _GetNs();
+    for (Loop = 0; Loop < NUM_LOOPS; Loop++) {
+      for (c = 0; c < 128u; c++) {
+        _OldLookup((char)(c ^ Loop) & 0x7F, &Modifier, &Usage);
+        Sum += Modifier + Usage;
+      }
+    }
+    t = _GetNs() - t;
+    _Sink = Sum;
+    if (t < OldNs) {
+      OldNs = t;
+    }
+    Sum = 0;
+    t   = _GetNs();
+    for (Loop = 0; Loop < NUM_LOOPS; Loop++) {
+      for (c = 0; c < 128u; c++) {
+        pKey = ASCII2USAGE_Get((unsigned char)((c ^ Loop) & 0x7Fu));
+        Sum += pKey->Modifier + pKey->Usage;
+      }
+    }
+    t = _GetNs() - t;
+    _Sink = Sum;
+    if (t < NewNs) {
+      NewNs = t;
+    }
+  }
+  OldNs /= (double)NUM_LOOPS * 128.0;
+  NewNs /= (double)NUM_LOOPS * 128.0;
+  printf("Ascii2Usage: linear scan %.2f ns/char, table %.2f ns/char (host CPU, x%.1f)\n", OldNs, NewNs, OldNs / NewNs);
+}
+
+/*********************************************************************
+*
+*       Public code
+*
+**********************************************************************
+*/
+
+/*********************************************************************
+*
+*       main
+*/
+int main(int argc, char * argv[]) {
+  (void)argv;
+  _Check();
+  if (argc < 2) {                             // Any argument: Check only.
+    _Bench();
+  }
+  printf("Ascii2Usage: %u errors\n", _NumErrors);
+  return (_NumErrors == 0u) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*************************** End of file ****************************/
@@ -0,0 +1,493 @@
+/*********************************************************************
+-------------------------- END-OF-HEADER -----------------------------
+File    : BSP_DEBOUNCE_Test.c
+Purpose : Host model test of the key debouncer (BSP_DEBOUNCE.c).
+
+Additional information:
+  The test models BSP_KEY.c around the state machine: while a key is
+  idle, its EXTI line reports the first press edge at the exact time
+  of the edge. From then on, the pin is sampled at every system tick
+  until the key is stable released, edges in between are masked.
+
+  Waveforms are lists of level changes of one key in microseconds.
+  They come from
+    - built-in traces of typical contact bounce,
+    - random synthetic bounce trains with glitches,
+    - optionally, recorded captures given on the command line. A
+      capture is a text file with one "<time in s> <level>" pair per
+      line, as exported by logic analysers (',' is accepted as well).
+      The level is the pin level, 0: pressed (keys are active low).
+
+  The expected key actions are derived from the waveform: a level held
+  longer than the debounce time plus one sample is a stable state,
+  shorter pulses are bounces or glitches. For every key action the test
+  checks that exactly one press and one release is reported, that the
+  press carries the time of the first edge and the release a time
+  between its first edge and the end of its bounces.
+*/
+
+/*********************************************************************
+*
+*       #include section
+*
+**********************************************************************
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "BSP_DEBOUNCE.h"
+
+/*********************************************************************
+*
+*       Defines, configurable
+*
+**********************************************************************
+*/
+#define SAMPLE_PERIOD_US    (1000ul)    // One embOS tick.
+#define DEBOUNCE_CNT        (10u)       // BSP_KEY_DEBOUNCE_MS at 1 ms per tick.
+#define MAX_EDGES           (200000u)
+#define NUM_RANDOM_TRACES   (2000u)
+
+/*********************************************************************
+*
+*       Defines, fixed
+*
+**********************************************************************
+*/
+#define STABLE_US           ((DEBOUNCE_CNT + 2u) * SAMPLE_PERIOD_US)   // Longer: Always detected.
+#define BOUNCE_US           (DEBOUNCE_CNT * SAMPLE_PERIOD_US)          // Shorter: Never detected.
+#define MAX_REPORT_DELAY_US ((DEBOUNCE_CNT + 2u) * SAMPLE_PERIOD_US)
+
+/*********************************************************************
+*
+*       Types, local
+*
+**********************************************************************
+*/
+typedef struct {
+  unsigned long Time;         // [us]
+  unsigned int  Level;        // 1: pressed.
+} EDGE;
+
+typedef struct {
+  unsigned long Time;         // Time of the sample which reported the event.
+  unsigned long TimeStamp;    // Reported first-edge time.
+  unsigned int  IsPressed;
+} EVENT;
+
+typedef struct {
+  unsigned long FirstEdge;    // First edge leaving the previous stable state.
+  unsigned long Settled;      // Start of the new stable state, end of the bounces.
+  unsigned int  IsPressed;
+} ACTION;
+
+/*********************************************************************
+*
+*       Static data
+*
+**********************************************************************
+*/
+static EDGE     _aEdge[MAX_EDGES];
+static EVENT    _aEvent[MAX_EDGES];
+static ACTION   _aAction[MAX_EDGES];
+static unsigned _NumEdges;
+static unsigned _NumErrors;
+static unsigned _Seed = 0x2545F491u;
+
+/*********************************************************************
+*
+*       Static code
+*
+**********************************************************************
+*/
+
+/*********************************************************************
+*
+*       _Rand
+*
+*  Function description
+*    Returns a pseudo random number in the range Min..Max.
+*/
+static unsigned long _Rand(unsigned long Min, unsigned long Max) {
+  _Seed ^= _Seed << 13;
+  _Seed ^= _Seed >> 17;
+  _Seed ^= _Seed << 5;
+  return Min + _Seed % (Max - Min + 1u);
+}
+
+/*********************************************************************
+*
+*       _AddEdge
+*/
+static void _AddEdge(unsigned long Time, unsigned int Level) {
+  if (_NumEdges < MAX_EDGES) {
+    _aEdge[_NumEdges].Time  = Time;
+    _aEdge[_NumEdges].Level = Level;
+    _NumEdges++;
+  }
+}
+
+/*********************************************************************
+*
+*       _AddBounce
+*
+*  Function description
+*    Adds a transition to Level with NumBounces pulses of the previous
+*    level in front of it. Returns the time the transition settled.
+*/
+static unsigned long _AddBounce(unsigned long t, unsigned int Level, unsigned NumBounces, unsigned long MaxPulseUs) {
+  while (NumBounces-- != 0u) {
+    _AddEdge(t, Level);
+    t += _Rand(5u, MaxPulseUs);
+    _AddEdge(t, Level ^ 1u);
+    t += _Rand(5u, MaxPulseUs);
+  }
+  _AddEdge(t, Level);
+  return t;
+}
+
+/*********************************************************************
+*
+*       _GetLevel
+*
+*  Function description
+*    Returns the level at time t. *pIndex speeds up monotonic queries.
+*/
+static unsigned int _GetLevel(unsigned long t, unsigned * pIndex) {
+  while ((*pIndex < _NumEdges) && (_aEdge[*pIndex].Time <= t)) {
+    (*pIndex)++;
+  }
+  return (*pIndex == 0u) ? 0u : _aEdge[*pIndex - 1u].Level;
+}
+
+/*********************************************************************
+*
+*       _Simulate
+*
+*  Function description
+*    Runs the waveform through the EXTI / sample timer model.
+*
+*  Return value
+*    Number of events reported.
+*/
+static unsigned _Simulate(unsigned long EndTime) {
+  BSP_DEBOUNCE_STATE State;
+  unsigned           NumEvents;
+  unsigned           iEdge;
+  unsigned           iLevel;
+  unsigned long      t;
+  unsigned int       Result;
+
+  memset(&State, 0, sizeof(State));
+  NumEvents = 0;
+  iEdge     = 0;
+  iLevel    = 0;
+  t         = 0;
+  while (1) {
+    //
+    // Idle: the EXTI line catches the next press edge after t.
+    //
+    while ((iEdge < _NumEdges) && ((_aEdge[iEdge].Time <= t) || (_aEdge[iEdge].Level == 0u))) {
+      iEdge++;
+    }
+    if (iEdge == _NumEdges) {
+      return NumEvents;
+    }
+    BSP_DEBOUNCE_OnEdge(&State, _aEdge[iEdge].Time);
+    //
+    // Sampled from the tick following the edge until stable released.
+    //
+    t = (_aEdge[iEdge].Time / SAMPLE_PERIOD_US + 1u) * SAMPLE_PERIOD_US;
+    while (1) {
+      Result = BSP_DEBOUNCE_Step(&State, _GetLevel(t, &iLevel), t, DEBOUNCE_CNT);
+      if (Result & BSP_DEBOUNCE_CHANGED) {
+        _aEvent[NumEvents].Time      = t;
+        _aEvent[NumEvents].TimeStamp = State.TimeStamp;
+        _aEvent[NumEvents].IsPressed = State.IsPressed;
+        NumEvents++;
+      }
+      if (Result & BSP_DEBOUNCE_IDLE) {
+        break;
+      }
+      if (t > EndTime) {
+        printf("  Key still sampled at the end of the trace\n");
+        _NumErrors++;
+        return NumEvents;
+      }
+      t += SAMPLE_PERIOD_US;
+    }
+  }
+}
+
+/*********************************************************************
+*
+*       _GetActions
+*
+*  Function description
+*    Derives the key actions from the waveform.
+*
+*  Return value
+*    >= 0: Number of state changes (press or release).
+*    <  0: Trace contains a level held for an ambiguous time.
+*/
+static int _GetActions(unsigned long EndTime) {
+  unsigned      NumActions;
+  unsigned      i;
+  unsigned int  Stable;
+  unsigned long FirstEdge;
+  unsigned long Start;
+  unsigned long Duration;
+  int           IsLeaving;
+
+  NumActions = 0;
+  Stable     = 0;
+  IsLeaving  = 0;
+  FirstEdge  = 0;
+  for (i = 0; i < _NumEdges; i++) {
+    Start    = _aEdge[i].Time;
+    Duration = ((i + 1u < _NumEdges) ? _aEdge[i + 1u].Time : EndTime) - Start;
+    if ((Duration >= BOUNCE_US) && (Duration <= STABLE_US)) {
+      return -1;
+    }
+    if (_aEdge[i].Level != Stable) {
+      if (IsLeaving == 0) {
+        IsLeaving = 1;
+        FirstEdge = Start;
+      }
+      if (Duration > STABLE_US) {
+        _aAction[NumActions].FirstEdge = FirstEdge;
+        _aAction[NumActions].Settled   = Start;
+        _aAction[NumActions].IsPressed = _aEdge[i].Level;
+        NumActions++;
+        Stable    = _aEdge[i].Level;
+        IsLeaving = 0;
+      }
+    } else if (Duration > STABLE_US) {
+      IsLeaving = 0;                   // Glitch, back to the stable level.
+    }
+  }
+  return (int)NumActions;
+}
+
+/*********************************************************************
+*
+*       _CheckTrace
+*
+*  Function description
+*    Simulates the waveform in _aEdge[] and checks the reported events.
+*    Verbose == 0 prints failures only.
+*/
+static void _CheckTrace(const char * sName, int Verbose) {
+  unsigned long EndTime;
+  unsigned      NumEvents;
+  int           NumActions;
+  unsigned      i;
+  unsigned      NumErrors;
+  ACTION *      pAction;
+  EVENT *       pEvent;
+
+  NumErrors  = _NumErrors;
+  EndTime    = (_NumEdges ? _aEdge[_NumEdges - 1u].Time : 0u) + 4u * STABLE_US;
+  NumActions = _GetActions(EndTime);
+  if (NumActions < 0) {
+    printf("%s: Skipped, contains a level held close to the debounce time\n", sName);
+    return;
+  }
+  NumEvents = _Simulate(EndTime);
+  if (NumEvents != (unsigned)NumActions) {
+    printf("%s: %u events reported for %d key state changes\n", sName, NumEvents, NumActions);
+    _NumErrors++;
+  }
+  for (i = 0; (i < NumEvents) && (i < (unsigned)NumActions); i++) {
+    pAction = &_aAction[i];
+    pEvent  = &_aEvent[i];
+    if (pEvent->IsPressed != pAction->IsPressed) {
+      printf("%s: Event %u is a %s, expected a %s\n", sName, i, pEvent->IsPressed ? "press" : "release", pAction->IsPressed ? "press" : "release");
+      _NumErrors++;
+      break;
+    }
+    if (pAction->IsPressed) {
+      if (pEvent->TimeStamp != pAction->FirstEdge) {
+        printf("%s: Press %u time stamp %lu us, first edge at %lu us\n", sName, i, pEvent->TimeStamp, pAction->FirstEdge);
+        _NumErrors++;
+      }
+    } else if ((pEvent->TimeStamp < pAction->FirstEdge) || (pEvent->TimeStamp > pAction->Settled + SAMPLE_PERIOD_US)) {
+      printf("%s: Release %u time stamp %lu us, edges from %lu to %lu us\n", sName, i, pEvent->TimeStamp, pAction->FirstEdge, pAction->Settled);
+      _NumErrors++;
+    }
+    if (pEvent->Time > pAction->Settled + MAX_REPORT_DELAY_US) {
+      printf("%s: Event %u reported at %lu us, settled at %lu us\n", sName, i, pEvent->Time, pAction->Settled);
+      _NumErrors++;
+    }
+  }
+  if (Verbose || (NumErrors != _NumErrors)) {
+    printf("%s: %u edges, %d state changes, %s\n", sName, _NumEdges, NumActions, (NumErrors == _NumErrors) ? "OK" : "FAILED");
+  }
+}
+
+/*********************************************************************
+*
+*       _TestBuiltIn
+*
+*  Function description
+*    Traces of typical contact bounce: a clean press, a tact switch
+*    with a few ms of bounce on both edges, a worn switch with many
+*    short bounces and a release glitch, and noise while idle.
+*/
+static void _TestBuiltIn(void) {
+  static const EDGE _aClean[] = {
+    { 10000, 1 }, { 80000, 0 }
+  };
+  static const EDGE _aTact[] = {
+    { 10000, 1 }, { 10180, 0 }, { 10420, 1 }, { 10500, 0 }, { 11900, 1 },
+    { 95000, 0 }, { 95060, 1 }, { 95300, 0 }, { 96800, 1 }, { 96850, 0 }
+  };
+  static const EDGE _aWorn[] = {
+    { 5000,  1 }, { 5020,  0 }, { 5050,  1 }, { 5090,  0 }, { 5110,  1 }, { 5400,  0 }, { 5420,  1 },
+    { 6000,  0 }, { 6005,  1 }, { 9000,  0 }, { 9010,  1 },                              // Bounce after the first ms.
+    { 40000, 0 }, { 42000, 1 },                                                           // Glitch while held.
+    { 70000, 0 }, { 70100, 1 }, { 70200, 0 }, { 71500, 1 }, { 71600, 0 }, { 74000, 1 }, { 74020, 0 }
+  };
+  static const EDGE _aNoise[] = {
+    { 5000,  1 }, { 5002,  0 }, { 30000, 1 }, { 33000, 0 },                               // Idle glitches, no press.
+    { 60000, 1 }, { 60300, 0 }, { 60310, 1 }, { 110000, 0 }
+  };
+  static const struct {
+    const char * sName;
+    const EDGE * paEdge;
+    unsigned     NumEdges;
+  } _aTrace[] = {
+    { "Clean",      _aClean, sizeof(_aClean) / sizeof(_aClean[0]) },
+    { "Tact",       _aTact,  sizeof(_aTact)  / sizeof(_aTact[0])  },
+    { "Worn",       _aWorn,  sizeof(_aWorn)  / sizeof(_aWorn[0])  },
+    { "Idle noise", _aNoise, sizeof(_aNoise) / sizeof(_aNoise[0]) }
+  };
+  unsigned i;
+
+  for (i = 0; i < sizeof(_aTrace) / sizeof(_aTrace[0]); i++) {
+    memcpy(_aEdge, _aTrace[i].paEdge, _aTrace[i].NumEdges * sizeof(EDGE));
+    _NumEdges = _aTrace[i].NumEdges;
+    _CheckTrace(_aTrace[i].sName, 1);
+  }
+}
+
+/*********************************************************************
+*
+*       _TestRandom
+*
+*  Function description
+*    Random key actions with up to 10 bounce pulses per edge and
+*    glitches while idle and while held.
+*/
+static void _TestRandom(void) {
+  unsigned      n;
+  unsigned      i;
+  unsigned long t;
+  char          acName[32];
+
+  for (n = 0; n < NUM_RANDOM_TRACES; n++) {
+    _NumEdges = 0;
+    t         = _Rand(0u, 5000u);
+    for (i = _Rand(1u, 20u); i != 0u; i--) {
+      t += _Rand(STABLE_US + 1u, 100000u);
+      if (_Rand(0u, 3u) == 0u) {
+        _AddEdge(t, 1u);                                  // Glitch while idle.
+        t += _Rand(1u, BOUNCE_US - 1u);
+        _AddEdge(t, 0u);
+        t += _Rand(STABLE_US + 1u, 50000u);
+      }
+      t  = _AddBounce(t, 1u, (unsigned)_Rand(0u, 10u), 500u);
+      t += _Rand(STABLE_US + 1u, 300000u);
+      if (_Rand(0u, 3u) == 0u) {
+        _AddEdge(t, 0u);                                  // Glitch while held.
+        t += _Rand(1u, BOUNCE_US - 1u);
+        _AddEdge(t, 1u);
+        t += _Rand(STABLE_US + 1u, 50000u);
+      }
+      t  = _AddBounce(t, 0u, (unsigned)_Rand(0u, 10u), 500u);
+    }
+    snprintf(acName, sizeof(acName), "Random %u", n);
+    _CheckTrace(acName, 0);
+  }
+  printf("Random: %u traces checked\n", NUM_RANDOM_TRACES);
+}
+
+/*********************************************************************
+*
+*       _LoadCapture
+*
+*  Function description
+*    Reads a recorded capture into _aEdge[], see file header.
+*
+*  Return value
+*    == 0: O.K.
+*    != 0: File could not be read.
+*/
+static int _LoadCapture(const char * sFile) {
+  FILE *        pFile;
+  char          acLine[128];
+  char *        p;
+  double        Time;
+  double        Time0;
+  int           Level;
+  unsigned int  LastLevel;
+  unsigned long t;
+
+  pFile = fopen(sFile, "r");
+  if (pFile == NULL) {
+    return 1;
+  }
+  _NumEdges = 0;
+  LastLevel = 0;
+  Time0     = -1.0;
+  while (fgets(acLine, sizeof(acLine), pFile) != NULL) {
+    for (p = acLine; *p != '\0'; p++) {
+      if (*p == ',') {
+        *p = ' ';
+      }
+    }
+    if (sscanf(acLine, "%lf %d", &Time, &Level) != 2) {
+      continue;                                         // Header or comment.
+    }
+    if (Time0 < 0.0) {
+      Time0 = Time - 0.001;                             // First sample at 1 ms.
+    }
+    t = (unsigned long)((Time - Time0) * 1e6 + 0.5);
+    if ((unsigned int)(Level == 0) != LastLevel) {      // Active low.
+      LastLevel = (unsigned int)(Level == 0);
+      _AddEdge(t, LastLevel);
+    }
+  }
+  fclose(pFile);
+  return 0;
+}
+
+/*********************************************************************
+*
+*       Public code
+*
+**********************************************************************
+*/
+
+/*********************************************************************
+*
+*       main
+*/
+int main(int argc, char ** argv) {
+  int i;
+
+  _TestBuiltIn();
+  _TestRandom();
+  for (i = 1; i < argc; i++) {
+    if (_LoadCapture(argv[i]) != 0) {
+      printf("%s: Can not be read\n", argv[i]);
+      _NumErrors++;
+      continue;
+    }
+    _CheckTrace(argv[i], 1);
+  }
+  printf("BSP_DEBOUNCE: %u errors\n", _NumErrors);
+  return (_NumErrors == 0u) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*************************** End of file ****************************/
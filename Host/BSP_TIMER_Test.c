@@ -0,0 +1,323 @@
+/*********************************************************************
+-------------------------- END-OF-HEADER -----------------------------
+File    : BSP_TIMER_Test.c
+Purpose : Host test of the microsecond one-shot timers (BSP_TIMER.c).
+
+Additional information:
+  BSP_TIMER.c is built against Stub/stm32f4xx.h and Stub/RTOS.h. TIM2
+  is simulated: the counter only advances when the test lets time pass,
+  a compare channel raises its flag when the counter steps onto the
+  compare value, SR is rc_w0 and EGR raises flags by software. The
+  TIM2 "interrupt" runs whenever a flag and its enable bit are set and
+  embOS interrupts are not disabled.
+
+  A zero latency interrupt may stall BSP_TIMER_Start() at any point,
+  even with embOS interrupts disabled. The test therefore stalls it by
+  a given time before each of its TIM2 register accesses in turn, for
+  several timeouts and stall times and with the counter close to its
+  wrap-around.
+
+  Checks:
+    - The timer expires exactly once.
+    - Not before the requested time (at least TIMER_MIN_US) after the
+      call, and no later than the requested time plus the stall.
+    - The channel is free again after expiry.
+*/
+
+/*********************************************************************
+*
+*       #include section
+*
+**********************************************************************
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include "stm32f4xx.h"
+#include "RTOS.h"
+#include "BSP_TIMER.h"
+
+/*********************************************************************
+*
+*       Defines, fixed
+*
+**********************************************************************
+*/
+#define TIMER_MIN_US        (2u)          // See BSP_TIMER.c.
+#define MAX_ACCESSES        (64u)         // TIM2 accesses of one BSP_TIMER_Start() at most.
+#define CC_FLAGS            (0x1Eu)       // CC1IF .. CC4IF.
+
+/*********************************************************************
+*
+*       Prototypes
+*
+**********************************************************************
+*/
+void TIM2_IRQHandler(void);              // Defined in BSP_TIMER.c.
+
+/*********************************************************************
+*
+*       Static data
+*
+**********************************************************************
+*/
+static TIM_TypeDef   _Regs;              // As seen by the driver.
+static uint32_t      _HwSR;              // Flags as set by the simulated hardware.
+static uint32_t      _ExposedSR;         // _Regs.SR as last set by the simulation.
+static unsigned      _DICnt;
+static int           _InISR;
+static unsigned      _NumAccesses;
+static unsigned      _StallAt;           // Access of BSP_TIMER_Start() which is stalled.
+static uint32_t      _StallUs;
+static int           _IsStallArmed;
+static unsigned      _NumExpired;
+static uint32_t      _ExpiredAt;
+static unsigned      _NumErrors;
+
+uint32_t             SystemCoreClock = 168000000u;
+RCC_TypeDef          SIM_RCC;
+
+/*********************************************************************
+*
+*       Static code
+*
+**********************************************************************
+*/
+
+/*********************************************************************
+*
+*       _Error
+*/
+static void _Error(const char * sText, unsigned long v0, unsigned long v1) {
+  if (_NumErrors < 20u) {
+    printf("  At counter 0x%08lX: ", (unsigned long)_Regs.CNT);
+    printf(sText, v0, v1);
+    printf("\n");
+  }
+  _NumErrors++;
+}
+
+/*********************************************************************
+*
+*       _Sync
+*
+*  Function description
+*    Applies the writes of the driver since the last access to SR and
+*    EGR and exposes the current hardware flags.
+*/
+static void _Sync(void) {
+  if (_Regs.SR != _ExposedSR) {
+    _HwSR &= _Regs.SR;                   // rc_w0: Writing 0 clears, 1 keeps.
+  }
+  if (_Regs.EGR != 0u) {
+    _HwSR    |= _Regs.EGR & CC_FLAGS;    // CCxG sets CCxIF.
+    _Regs.EGR = 0;
+  }
+  _Regs.SR   = _HwSR;
+  _ExposedSR = _HwSR;
+}
+
+/*********************************************************************
+*
+*       _Advance
+*
+*  Function description
+*    Lets the counter run for a number of microseconds.
+*/
+static void _Advance(uint32_t Us) {
+  volatile uint32_t * pCCR;
+  unsigned            Channel;
+
+  _Sync();
+  while (Us-- != 0u) {
+    _Regs.CNT++;
+    pCCR = &_Regs.CCR1;
+    for (Channel = 0; Channel < BSP_TIMER_NUM_CHANNELS; Channel++) {
+      if (pCCR[Channel] == _Regs.CNT) {
+        _HwSR |= TIM_SR_CC1IF << Channel;
+      }
+    }
+  }
+  _Regs.SR   = _HwSR;
+  _ExposedSR = _HwSR;
+}
+
+/*********************************************************************
+*
+*       _Dispatch
+*
+*  Function description
+*    Runs the TIM2 interrupt if it is pending and not masked.
+*/
+static void _Dispatch(void) {
+  _Sync();
+  if ((_DICnt == 0u) && (_InISR == 0) && ((_HwSR & _Regs.DIER & CC_FLAGS) != 0u)) {
+    _InISR = 1;
+    TIM2_IRQHandler();
+    _InISR = 0;
+  }
+}
+
+/*********************************************************************
+*
+*       _OnExpire
+*/
+static void _OnExpire(void * pContext) {
+  (void)pContext;
+  _NumExpired++;
+  _ExpiredAt = _Regs.CNT;
+}
+
+/*********************************************************************
+*
+*       _RunOne
+*
+*  Function description
+*    Starts one timer with a stall before the given TIM2 access and
+*    checks its expiry.
+*
+*  Return value
+*    Number of TIM2 accesses of BSP_TIMER_Start().
+*/
+static unsigned _RunOne(uint32_t StartCnt, unsigned long Us, unsigned StallAt, uint32_t StallUs) {
+  uint32_t StartedAt;
+  uint32_t MinUs;
+  uint32_t MaxUs;
+  uint32_t Elapsed;
+  unsigned NumAccesses;
+  int      Handle;
+
+  _Regs.CNT    = StartCnt;
+  _NumExpired  = 0;
+  _NumAccesses = 0;
+  _StallAt     = StallAt;
+  _StallUs     = StallUs;
+  _IsStallArmed = 1;
+  StartedAt    = StartCnt;
+  Handle       = BSP_TIMER_Start(Us, _OnExpire, NULL);
+  _IsStallArmed = 0;
+  NumAccesses  = _NumAccesses;
+  if (Handle < 0) {
+    _Error("No channel free for %lu us (stall %lu us)", Us, StallUs);
+    return NumAccesses;
+  }
+  _Dispatch();
+  MinUs = (Us < TIMER_MIN_US) ? TIMER_MIN_US : (uint32_t)Us;
+  MaxUs = MinUs + StallUs;
+  while ((_NumExpired == 0u) && ((uint32_t)(_Regs.CNT - StartedAt) <= MaxUs + 1000u)) {
+    _Advance(1);
+    _Dispatch();
+  }
+  if (_NumExpired == 0u) {
+    _Error("Timer of %lu us did not expire (stall %lu us)", Us, StallUs);
+    BSP_TIMER_Stop(Handle);
+    return NumAccesses;
+  }
+  Elapsed = _ExpiredAt - StartedAt;
+  if (Elapsed < MinUs) {
+    _Error("Timer of %lu us expired after %lu us", Us, Elapsed);
+  }
+  if (Elapsed > MaxUs) {
+    _Error("Timer of %lu us expired after %lu us", Us, Elapsed);
+  }
+  _Advance(MaxUs + 10u);
+  _Dispatch();
+  if (_NumExpired != 1u) {
+    _Error("Timer of %lu us expired %lu times", Us, _NumExpired);
+  }
+  if ((_Regs.DIER & CC_FLAGS) != 0u) {
+    _Error("Channel interrupt still enabled after expiry (DIER 0x%lX)", _Regs.DIER, 0);
+  }
+  return NumAccesses;
+}
+
+/*********************************************************************
+*
+*       Public code
+*
+**********************************************************************
+*/
+
+/*********************************************************************
+*
+*       SIM_TIM2_Access
+*
+*  Function description
+*    Called before every access of the driver to a TIM2 register.
+*/
+TIM_TypeDef * SIM_TIM2_Access(void) {
+  _Sync();
+  if (_IsStallArmed != 0) {
+    if (_NumAccesses == _StallAt) {
+      _Advance(_StallUs);               // A zero latency interrupt runs meanwhile.
+    }
+    _NumAccesses++;
+  }
+  return &_Regs;
+}
+
+/*********************************************************************
+*
+*       NVIC_SetPriority, NVIC_EnableIRQ
+*/
+void NVIC_SetPriority(IRQn_Type IRQn, uint32_t Priority) {
+  (void)IRQn;
+  (void)Priority;
+}
+
+void NVIC_EnableIRQ(IRQn_Type IRQn) {
+  (void)IRQn;
+}
+
+/*********************************************************************
+*
+*       embOS interrupt API
+*/
+void OS_INT_IncDI(void) {
+  _DICnt++;
+}
+
+void OS_INT_DecRI(void) {
+  if (--_DICnt == 0u) {
+    _Dispatch();
+  }
+}
+
+void OS_EnterNestableInterrupt(void) {
+}
+
+void OS_LeaveNestableInterrupt(void) {
+}
+
+/*********************************************************************
+*
+*       main
+*/
+int main(void) {
+  static const unsigned long _aUs[]      = { 0, 1, 2, 3, 5, 50, 1000 };
+  static const uint32_t      _aStallUs[] = { 0, 1, 2, 3, 10, 200 };
+  static const uint32_t      _aStart[]   = { 0x00001000u, 0xFFFFFFF0u, 0xFFFFFFFEu };
+  unsigned                   iUs;
+  unsigned                   iStall;
+  unsigned                   iStart;
+  unsigned                   StallAt;
+  unsigned                   NumAccesses;
+  unsigned long              NumRuns;
+
+  BSP_TIMER_Init();
+  NumRuns = 0;
+  for (iStart = 0; iStart < sizeof(_aStart) / sizeof(_aStart[0]); iStart++) {
+    for (iUs = 0; iUs < sizeof(_aUs) / sizeof(_aUs[0]); iUs++) {
+      for (iStall = 0; iStall < sizeof(_aStallUs) / sizeof(_aStallUs[0]); iStall++) {
+        NumAccesses = MAX_ACCESSES;
+        for (StallAt = 0; StallAt < NumAccesses; StallAt++) {
+          NumAccesses = _RunOne(_aStart[iStart], _aUs[iUs], StallAt, _aStallUs[iStall]);
+          NumRuns++;
+        }
+      }
+    }
+  }
+  printf("BSP_TIMER: %lu starts, stalled before each TIM2 access, %u errors\n", NumRuns, _NumErrors);
+  return (_NumErrors == 0u) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*************************** End of file ****************************/
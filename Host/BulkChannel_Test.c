@@ -0,0 +1,409 @@
+/*********************************************************************
+-------------------------- END-OF-HEADER -----------------------------
+File    : BulkChannel_Test.c
+Purpose : Host test of the bulk benchmark buffer handling (BulkChannel.c).
+
+Additional information:
+  Stands in for the USB stack and the bulk task of USB_Bulk_Benchmark.c
+  without hardware. A simulated endpoint completes one transfer at a
+  time after a random transfer time, and the task fills (IN) or checks
+  (OUT) buffers in several steps, so the "interrupt" hits the task at
+  every point between BULK_CHANNEL_GetTaskBuffer() and
+  BULK_CHANNEL_Submit(). Optionally, transfers fail at random as on a
+  bus reset. The task keeps serving buffers for a while and restarts
+  the channel when it sees the state change.
+
+  Checks:
+    - A transfer is only started from the "interrupt" or with the
+      interrupt locked out, never while one is in flight and never on
+      the buffer the task is working on.
+    - IN buffers are not modified while in flight, the host receives
+      the sequence numbers in order, without gaps unless a transfer failed.
+    - OUT buffers reach the task in order and unmodified.
+    - The endpoint is never idle while the channel has a buffer for it.
+    - The statistics match the transfers seen by the endpoint.
+*/
+
+/*********************************************************************
+*
+*       #include section
+*
+**********************************************************************
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "BulkChannel.h"
+
+/*********************************************************************
+*
+*       Defines, configurable
+*
+**********************************************************************
+*/
+#define TRANSFER_SIZE       4096u
+#define NUM_STEPS           2000000u
+#define NUM_FILL_CHUNKS     4u                 // Interrupt opportunities while the task works on a buffer.
+
+/*********************************************************************
+*
+*       Types, local
+*
+**********************************************************************
+*/
+typedef struct {
+  //
+  // Simulated endpoint.
+  //
+  unsigned char * pData;
+  unsigned        NumBytes;
+  int             InFlight;
+  unsigned long   CompleteAt;
+  unsigned char   abSnapshot[TRANSFER_SIZE];   // IN: Buffer contents at the start of the transfer.
+  unsigned long   HostSeq;                     // IN: Next sequence number expected, OUT: next one sent.
+  unsigned long   NumBytesOnBus;
+  unsigned long   NumTransfersOnBus;
+  unsigned long   NumFailed;
+  unsigned long   BusyTime;
+  //
+  // Simulated task.
+  //
+  unsigned char * pTaskBuffer;
+  unsigned        TaskNumBytes;
+  unsigned        TaskChunk;
+  unsigned long   TaskSeq;                     // IN: Next sequence number to send, OUT: next one expected.
+  int             NeedsRestart;
+  unsigned long   RestartAt;                   // The task sees the USB state change some time after the failure.
+} SIM;
+
+/*********************************************************************
+*
+*       Static data
+*
+**********************************************************************
+*/
+static unsigned char _abBuffer[BULK_CHANNEL_NUM_BUFFERS * TRANSFER_SIZE];
+static BULK_CHANNEL  _Channel;
+static SIM           _Sim;
+static unsigned long _Now;
+static int           _IsLocked;
+static int           _InISR;
+static unsigned      _NumErrors;
+static unsigned      _Seed = 0x9E3779B9u;
+
+/*********************************************************************
+*
+*       Static code
+*
+**********************************************************************
+*/
+
+/*********************************************************************
+*
+*       _Rand
+*
+*  Function description
+*    Returns a pseudo random number in the range Min..Max.
+*/
+static unsigned long _Rand(unsigned long Min, unsigned long Max) {
+  _Seed ^= _Seed << 13;
+  _Seed ^= _Seed >> 17;
+  _Seed ^= _Seed << 5;
+  return Min + _Seed % (Max - Min + 1u);
+}
+
+/*********************************************************************
+*
+*       _Error
+*/
+static void _Error(const char * sText, unsigned long v0, unsigned long v1) {
+  if (_NumErrors < 20u) {
+    printf("  Step at %lu us: ", _Now);
+    printf(sText, v0, v1);
+    printf("\n");
+  }
+  _NumErrors++;
+}
+
+/*********************************************************************
+*
+*       _PutSeq / _GetSeq
+*/
+static void _PutSeq(unsigned char * p, unsigned long Seq) {
+  p[0] = (unsigned char)(Seq);
+  p[1] = (unsigned char)(Seq >> 8);
+  p[2] = (unsigned char)(Seq >> 16);
+  p[3] = (unsigned char)(Seq >> 24);
+}
+
+static unsigned long _GetSeq(const unsigned char * p) {
+  return (unsigned long)p[0] | ((unsigned long)p[1] << 8) | ((unsigned long)p[2] << 16) | ((unsigned long)p[3] << 24);
+}
+
+/*********************************************************************
+*
+*       _Pattern
+*
+*  Function description
+*    Contents of byte i of the buffer with sequence number Seq.
+*/
+static unsigned char _Pattern(unsigned long Seq, unsigned i) {
+  return (unsigned char)(i + Seq * 7u);
+}
+
+/*********************************************************************
+*
+*       _OnStart
+*
+*  Function description
+*    Stands in for USBD_WriteAsync() / USBD_ReadAsync().
+*/
+static void _OnStart(BULK_CHANNEL * pChannel, unsigned char * pData, unsigned NumBytes) {
+  (void)pChannel;
+  if ((_InISR == 0) && (_IsLocked == 0)) {
+    _Error("Transfer started with the interrupt enabled", 0, 0);
+  }
+  if (_Sim.InFlight) {
+    _Error("Transfer started while one is in flight", 0, 0);
+  }
+  if (pData == _Sim.pTaskBuffer) {
+    _Error("Transfer started on the buffer of the task", 0, 0);
+  }
+  _Sim.pData      = pData;
+  _Sim.NumBytes   = NumBytes;
+  _Sim.InFlight   = 1;
+  _Sim.CompleteAt = _Now + _Rand(500u, 5000u);
+  if (_Channel.InDir) {
+    memcpy(_Sim.abSnapshot, pData, NumBytes);
+  }
+}
+
+/*********************************************************************
+*
+*       _ISR
+*
+*  Function description
+*    Completes the transfer in flight, as the USB interrupt would.
+*/
+static void _ISR(int ErrorRate) {
+  unsigned      NumBytes;
+  unsigned long Seq;
+  unsigned      i;
+  int           Status;
+
+  _InISR       = 1;
+  _Sim.InFlight = 0;
+  Status       = ((ErrorRate != 0) && (_Rand(0u, (unsigned long)ErrorRate) == 0u)) ? -1 : 0;
+  NumBytes     = 0;
+  if (Status != 0) {
+    _Sim.NumFailed++;
+    if (_Sim.NeedsRestart == 0) {
+      _Sim.NeedsRestart = 1;
+      _Sim.RestartAt    = _Now + _Rand(0u, 20000u);
+    }
+  } else if (_Channel.InDir) {
+    NumBytes = _Sim.NumBytes;
+    if (memcmp(_Sim.abSnapshot, _Sim.pData, NumBytes) != 0) {
+      _Error("IN buffer modified while in flight", 0, 0);
+    }
+    Seq = _GetSeq(_Sim.pData);
+    if ((Seq < _Sim.HostSeq) || ((Seq != _Sim.HostSeq) && (_Sim.NumFailed == 0u))) {
+      _Error("Host received sequence %lu, expected %lu", Seq, _Sim.HostSeq);
+    }
+    _Sim.HostSeq = Seq + 1u;
+  } else {
+    NumBytes = (unsigned)_Rand(4u, _Sim.NumBytes);          // Short packet ends the transfer early.
+    _PutSeq(_Sim.pData, _Sim.HostSeq);
+    for (i = 4; i < NumBytes; i++) {
+      _Sim.pData[i] = _Pattern(_Sim.HostSeq, i);
+    }
+    _Sim.HostSeq++;
+  }
+  if (Status == 0) {
+    _Sim.NumBytesOnBus += NumBytes;
+    _Sim.NumTransfersOnBus++;
+  }
+  BULK_CHANNEL_OnComplete(&_Channel, Status, NumBytes, _Now);
+  _InISR = 0;
+}
+
+/*********************************************************************
+*
+*       _TaskStep
+*
+*  Function description
+*    One step of the bulk task: get a buffer, fill or check one chunk
+*    of it, or hand it back.
+*/
+static void _TaskStep(void) {
+  unsigned      i;
+  unsigned      First;
+  unsigned      Last;
+  unsigned long Seq;
+
+  if (_Sim.pTaskBuffer == NULL) {
+    if (_Sim.NeedsRestart && ((long)(_Now - _Sim.RestartAt) >= 0)) {
+      _IsLocked = 1;
+      BULK_CHANNEL_Restart(&_Channel, _Now);
+      _IsLocked = 0;
+      _Sim.NeedsRestart = 0;
+      if (_Channel.InDir == 0u) {
+        _Sim.TaskSeq = _Sim.HostSeq;           // Data in dropped OUT buffers is lost.
+      }
+      return;
+    }
+    _Sim.pTaskBuffer = BULK_CHANNEL_GetTaskBuffer(&_Channel, &_Sim.TaskNumBytes);
+    _Sim.TaskChunk   = 0;
+    if ((_Sim.pTaskBuffer != NULL) && (_Channel.InDir == 0u)) {
+      Seq = _GetSeq(_Sim.pTaskBuffer);
+      if (Seq != _Sim.TaskSeq) {
+        _Error("Task received OUT sequence %lu, expected %lu", Seq, _Sim.TaskSeq);
+      }
+      _Sim.TaskSeq = Seq;
+    }
+    return;
+  }
+  if (_Sim.TaskChunk < NUM_FILL_CHUNKS) {
+    First = _Sim.TaskChunk * (_Sim.TaskNumBytes / NUM_FILL_CHUNKS);
+    Last  = (_Sim.TaskChunk == NUM_FILL_CHUNKS - 1u) ? _Sim.TaskNumBytes : First + _Sim.TaskNumBytes / NUM_FILL_CHUNKS;
+    if (First < 4u) {
+      First = 4u;
+      if (_Channel.InDir) {
+        _PutSeq(_Sim.pTaskBuffer, _Sim.TaskSeq);
+      }
+    }
+    for (i = First; i < Last; i++) {
+      if (_Channel.InDir) {
+        _Sim.pTaskBuffer[i] = _Pattern(_Sim.TaskSeq, i);
+      } else if (_Sim.pTaskBuffer[i] != _Pattern(_Sim.TaskSeq, i)) {
+        _Error("OUT data of sequence %lu modified at offset %lu", _Sim.TaskSeq, i);
+        break;
+      }
+    }
+    _Sim.TaskChunk++;
+    return;
+  }
+  _Sim.pTaskBuffer = NULL;                     // Handed back.
+  _Sim.TaskSeq++;
+  _IsLocked = 1;
+  BULK_CHANNEL_Submit(&_Channel, _Now);
+  _IsLocked = 0;
+}
+
+/*********************************************************************
+*
+*       _CheckIdle
+*
+*  Function description
+*    The endpoint must not idle while the channel has a buffer for it.
+*/
+static void _CheckIdle(void) {
+  unsigned i;
+
+  if ((unsigned)_Sim.InFlight != _Channel.IsBusy) {
+    _Error("Channel busy %lu, endpoint busy %lu", _Channel.IsBusy, (unsigned long)_Sim.InFlight);
+  }
+  if (_Sim.InFlight || _Channel.IsStopped) {
+    return;
+  }
+  for (i = 0; i < BULK_CHANNEL_NUM_BUFFERS; i++) {
+    if (_Channel.aState[i] == (_Channel.InDir ? BULK_BUFFER_READY : BULK_BUFFER_FREE)) {
+      if ((_Channel.InDir != 0u) || (_Channel.pBuffer + i * TRANSFER_SIZE != _Sim.pTaskBuffer)) {
+        _Error("Endpoint idle, buffer %lu waiting", i, 0);
+      }
+    }
+  }
+}
+
+/*********************************************************************
+*
+*       _Run
+*
+*  Function description
+*    Runs one direction. ErrorRate != 0 fails one of ErrorRate + 1
+*    transfers on average.
+*/
+static void _Run(unsigned InDir, int ErrorRate) {
+  BULK_STATS    Stats;
+  unsigned long NumBytes;
+  unsigned long NumTransfers;
+  unsigned long NumFailed;
+  unsigned long NumInBuckets;
+  unsigned long Start;
+  unsigned      NumErrors;
+  unsigned      Step;
+  unsigned      i;
+
+  NumErrors = _NumErrors;
+  memset(&_Sim, 0, sizeof(_Sim));
+  memset(_abBuffer, 0, sizeof(_abBuffer));
+  BULK_CHANNEL_Init(&_Channel, InDir, _abBuffer, TRANSFER_SIZE, 1u, _OnStart, NULL);
+  _Now         = 0;
+  NumBytes     = 0;
+  NumTransfers = 0;
+  NumFailed    = 0;
+  NumInBuckets = 0;
+  _IsLocked    = 1;
+  BULK_CHANNEL_Restart(&_Channel, _Now);
+  _IsLocked    = 0;
+  for (Step = 0; Step < NUM_STEPS; Step++) {
+    Start = _Now;
+    _Now += _Rand(1u, 300u);
+    if (_Sim.InFlight) {
+      _Sim.BusyTime += _Now - Start;
+    }
+    if (_Sim.InFlight && ((long)(_Now - _Sim.CompleteAt) >= 0)) {
+      _ISR(ErrorRate);
+    }
+    _TaskStep();
+    _CheckIdle();
+    if ((Step % 10000u) == 0u) {
+      BULK_CHANNEL_GetStats(&_Channel, &Stats);
+      NumBytes     += Stats.NumBytes;
+      NumTransfers += Stats.NumTransfers;
+      NumFailed    += Stats.NumErrors;
+      for (i = 0; i < BULK_CHANNEL_NUM_BUCKETS; i++) {
+        NumInBuckets += Stats.aNumLatency[i];
+      }
+    }
+  }
+  BULK_CHANNEL_GetStats(&_Channel, &Stats);
+  NumBytes     += Stats.NumBytes;
+  NumTransfers += Stats.NumTransfers;
+  NumFailed    += Stats.NumErrors;
+  for (i = 0; i < BULK_CHANNEL_NUM_BUCKETS; i++) {
+    NumInBuckets += Stats.aNumLatency[i];
+  }
+  if ((NumBytes != _Sim.NumBytesOnBus) || (NumTransfers != _Sim.NumTransfersOnBus) || (NumInBuckets != NumTransfers)) {
+    _Error("Statistics count %lu transfers, the endpoint saw %lu", NumTransfers, _Sim.NumTransfersOnBus);
+  }
+  if (NumFailed != _Sim.NumFailed) {
+    _Error("Statistics count %lu failed transfers, the endpoint saw %lu", NumFailed, _Sim.NumFailed);
+  }
+  printf("%s, %s: %lu transfers, %lu failed, endpoint busy %lu%%, %s\n",
+         InDir ? "IN " : "OUT", ErrorRate ? "with errors" : "no errors  ",
+         _Sim.NumTransfersOnBus, _Sim.NumFailed, (_Sim.BusyTime * 100u) / _Now,
+         (NumErrors == _NumErrors) ? "OK" : "FAILED");
+}
+
+/*********************************************************************
+*
+*       Public code
+*
+**********************************************************************
+*/
+
+/*********************************************************************
+*
+*       main
+*/
+int main(void) {
+  _Run(1, 0);
+  _Run(0, 0);
+  _Run(1, 200);
+  _Run(0, 200);
+  printf("BulkChannel: %u errors\n", _NumErrors);
+  return (_NumErrors == 0u) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*************************** End of file ****************************/
@@ -0,0 +1,233 @@
+/*********************************************************************
+-------------------------- END-OF-HEADER -----------------------------
+File    : KeyEventRing_Test.c
+Purpose : Host stress test of the key event ring (KeyEventRing.c).
+
+Additional information:
+  One thread plays the key interrupt and puts a numbered sequence of
+  events, the other plays the keyboard task and gets them. Both run
+  in bursts of random length, so the ring runs empty and full many
+  times. The consumer checks that
+    - the events arrive in the order they were put,
+    - no event is lost or duplicated, except those reported as
+      dropped by KEY_RING_Put(),
+    - no event is torn, i.e. all fields belong to the same event.
+  At the end, events put + dropped must equal the events generated.
+*/
+
+/*********************************************************************
+*
+*       #include section
+*
+**********************************************************************
+*/
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "KeyEventRing.h"
+
+/*********************************************************************
+*
+*       Defines, configurable
+*
+**********************************************************************
+*/
+#define NUM_EVENTS      (4000000u)
+#define RING_SIZE       (16u)
+#define MAX_PUT_BURST   (2u * RING_SIZE)   // Some bursts overflow the ring.
+#define MAX_GET_BURST   (4u * RING_SIZE)
+#define MAX_PUT_SPIN    (2000u)
+#define MAX_GET_SPIN    (200u)
+
+/*********************************************************************
+*
+*       Static data
+*
+**********************************************************************
+*/
+static KEY_EVENT              _aEvent[RING_SIZE];
+static KEY_RING               _Ring;
+static volatile unsigned char _aIsDropped[NUM_EVENTS];   // Written by the producer before it puts a later event.
+static unsigned               _NumErrors;
+static volatile int           _IsConsumerRunning;
+
+/*********************************************************************
+*
+*       Static code
+*
+**********************************************************************
+*/
+
+/*********************************************************************
+*
+*       _Rand
+*
+*  Function description
+*    Small xorshift generator, one state per thread.
+*/
+static unsigned _Rand(unsigned * pState) {
+  unsigned x;
+
+  x = *pState;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *pState = x;
+  return x;
+}
+
+/*********************************************************************
+*
+*       _Spin
+*/
+static void _Spin(unsigned * pState, unsigned MaxSpin) {
+  volatile unsigned i;
+
+  for (i = _Rand(pState) % MaxSpin; i != 0u; i--) {
+  }
+  if ((_Rand(pState) & 3u) == 0u) {
+    sched_yield();                     // Lets the other thread run on a single CPU.
+  }
+}
+
+/*********************************************************************
+*
+*       _Producer
+*
+*  Function description
+*    Simulated key interrupt. Event n carries n in TimeStamp and
+*    fields derived from n in KeyIndex and IsPressed.
+*/
+static void * _Producer(void * p) {
+  KEY_EVENT Event;
+  unsigned  State;
+  unsigned  n;
+  unsigned  Burst;
+
+  (void)p;
+  State = 0x12345678u;
+  n     = 0;
+  while (_IsConsumerRunning == 0) {
+  }
+  while (n < NUM_EVENTS) {
+    for (Burst = _Rand(&State) % MAX_PUT_BURST; (Burst != 0u) && (n < NUM_EVENTS); Burst--) {
+      Event.TimeStamp = n;
+      Event.KeyIndex  = (unsigned char)(n * 7u);
+      Event.IsPressed = (unsigned char)(n & 1u);
+      if (KEY_RING_Put(&_Ring, &Event) != 0) {
+        _aIsDropped[n] = 1;
+      }
+      n++;
+    }
+    _Spin(&State, MAX_PUT_SPIN);
+  }
+  return NULL;
+}
+
+/*********************************************************************
+*
+*       _Consume
+*
+*  Function description
+*    Checks one event against the expected sequence number.
+*
+*  Return value
+*    Next expected sequence number.
+*/
+static unsigned _Consume(const KEY_EVENT * pEvent, unsigned Expected) {
+  unsigned n;
+
+  n = (unsigned)pEvent->TimeStamp;
+  if ((pEvent->KeyIndex != (unsigned char)(n * 7u)) || (pEvent->IsPressed != (unsigned char)(n & 1u))) {
+    printf("Event %u torn\n", n);
+    _NumErrors++;
+  }
+  if ((n < Expected) || (n >= NUM_EVENTS)) {
+    printf("Event %u out of order, expected %u\n", n, Expected);
+    _NumErrors++;
+    return Expected;
+  }
+  while (Expected < n) {
+    if (_aIsDropped[Expected] == 0u) {
+      printf("Event %u lost\n", Expected);
+      _NumErrors++;
+    }
+    Expected++;
+  }
+  if (_aIsDropped[n] != 0u) {
+    printf("Event %u reported as dropped but received\n", n);
+    _NumErrors++;
+  }
+  return n + 1u;
+}
+
+/*********************************************************************
+*
+*       _Consumer
+*
+*  Function description
+*    Simulated keyboard task.
+*/
+static void * _Consumer(void * p) {
+  KEY_EVENT Event;
+  unsigned  State;
+  unsigned  Expected;
+  unsigned  NumReceived;
+  unsigned  Burst;
+
+  State       = 0x9E3779B9u;
+  Expected    = 0;
+  NumReceived = 0;
+  _IsConsumerRunning = 1;
+  while (NumReceived + KEY_RING_GetNumDropped(&_Ring) < NUM_EVENTS) {
+    for (Burst = _Rand(&State) % MAX_GET_BURST; Burst != 0u; Burst--) {
+      if (KEY_RING_Get(&_Ring, &Event) == 0) {
+        break;
+      }
+      Expected = _Consume(&Event, Expected);
+      NumReceived++;
+    }
+    _Spin(&State, MAX_GET_SPIN);
+  }
+  *(unsigned *)p = NumReceived;
+  return NULL;
+}
+
+/*********************************************************************
+*
+*       Public code
+*
+**********************************************************************
+*/
+
+/*********************************************************************
+*
+*       main
+*/
+int main(void) {
+  pthread_t hProducer;
+  pthread_t hConsumer;
+  unsigned  NumReceived;
+  unsigned  NumDropped;
+  KEY_EVENT Event;
+
+  KEY_RING_Init(&_Ring, _aEvent, RING_SIZE);
+  pthread_create(&hConsumer, NULL, _Consumer, &NumReceived);
+  pthread_create(&hProducer, NULL, _Producer, NULL);
+  pthread_join(hProducer, NULL);
+  pthread_join(hConsumer, NULL);
+  NumDropped = KEY_RING_GetNumDropped(&_Ring);
+  if (KEY_RING_Get(&_Ring, &Event) != 0) {
+    printf("Ring not empty at the end\n");
+    _NumErrors++;
+  }
+  if (NumReceived + NumDropped != NUM_EVENTS) {
+    printf("%u received + %u dropped != %u put\n", NumReceived, NumDropped, NUM_EVENTS);
+    _NumErrors++;
+  }
+  printf("KeyEventRing: %u events, %u received, %u dropped, %u errors\n", NUM_EVENTS, NumReceived, NumDropped, _NumErrors);
+  return (_NumErrors == 0u) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*************************** End of file ****************************/
@@ -0,0 +1,300 @@
+/*********************************************************************
+-------------------------- END-OF-HEADER -----------------------------
+File    : KeyPack_Test.c
+Purpose : Host test of the text to keyboard report packing (KeyPack.c).
+
+Additional information:
+  A simulated host receives the reports. Keys of a report which were
+  not in the previous report are new key presses and are typed with
+  the modifier of the report. Two hosts are simulated, one types the
+  new keys of a report in array order, the other in reverse order.
+  The HID specification allows both.
+
+  Texts with repeated characters ("ll", "aaa"), case changes ("aA"),
+  all typeable characters and random strings are sent with 1..6 keys
+  per report.
+
+  Checks:
+    - No report has more than KeysPerReport keys or a key twice.
+    - The last report releases all keys.
+    - With one key per report (the default of the keyboard sample),
+      both hosts type the exact text.
+    - With more keys per report, the array order host types the exact
+      text, while the reverse order host turns "ab" into "ba". This is
+      why the sample does not pack keys by default.
+*/
+
+/*********************************************************************
+*
+*       #include section
+*
+**********************************************************************
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Ascii2Usage.h"
+#include "KeyPack.h"
+
+/*********************************************************************
+*
+*       Defines, configurable
+*
+**********************************************************************
+*/
+#define MAX_TEXT            (512u)
+#define NUM_RANDOM_TEXTS    (2000u)
+
+/*********************************************************************
+*
+*       Types
+*
+**********************************************************************
+*/
+typedef struct {
+  const char *  sText;                              // Text being typed, for error messages.
+  int           IsReverse;                          // Types the new keys of a report in reverse array order.
+  unsigned      KeysPerReport;
+  unsigned      NumLastKeys;
+  unsigned char abLastKeys[KEY_PACK_NUM_SLOTS];
+  unsigned      NumReports;
+  unsigned      NumTyped;
+  char          acTyped[MAX_TEXT * 2u];
+} SIM_HOST;
+
+/*********************************************************************
+*
+*       Static data
+*
+**********************************************************************
+*/
+static char     _acUsage2Ascii[2][256];                 // [IsShift][Usage], inverse of the Ascii2Usage table.
+static unsigned _NumErrors;
+static unsigned _Seed = 0x9E3779B9u;
+
+/*********************************************************************
+*
+*       Static code
+*
+**********************************************************************
+*/
+
+/*********************************************************************
+*
+*       _Rand
+*/
+static unsigned _Rand(unsigned Max) {
+  _Seed = _Seed * 1103515245u + 12345u;
+  return (_Seed >> 8) % Max;
+}
+
+/*********************************************************************
+*
+*       _Error
+*/
+static void _Error(const char * sText, const char * s, unsigned v) {
+  if (_NumErrors < 20u) {
+    printf("  ");
+    printf(sText, s, v);
+    printf("\n");
+  }
+  _NumErrors++;
+}
+
+/*********************************************************************
+*
+*       _InitInverse
+*
+*  Function description
+*    Builds the character typed by the host for each modifier and key.
+*/
+static void _InitInverse(void) {
+  const ASCII_TO_USAGE * pKey;
+  unsigned               c;
+
+  for (c = 1; c < 128u; c++) {
+    pKey = ASCII2USAGE_Get((unsigned char)c);
+    if ((pKey->Usage != 0u) && (c != '\r')) {         // '\r' and '\n' share Enter, the host types '\n'.
+      _acUsage2Ascii[pKey->Modifier != 0u][pKey->Usage] = (char)c;
+    }
+  }
+}
+
+/*********************************************************************
+*
+*       _IsKeyInList
+*/
+static int _IsKeyInList(const unsigned char * pKeys, unsigned NumKeys, unsigned char Usage) {
+  while (NumKeys--) {
+    if (*pKeys++ == Usage) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/*********************************************************************
+*
+*       _OnReport
+*
+*  Function description
+*    Report send function, processes the report like a host.
+*/
+static void _OnReport(void * pContext, unsigned char Modifier, const unsigned char * pKeys, unsigned NumKeys) {
+  SIM_HOST * pHost;
+  unsigned   i;
+  unsigned   k;
+  char       c;
+
+  pHost = (SIM_HOST *)pContext;
+  pHost->NumReports++;
+  if (NumKeys > pHost->KeysPerReport) {
+    _Error("\"%s\": Report with %u keys", pHost->sText, NumKeys);
+  }
+  for (i = 0; i < NumKeys; i++) {
+    if (_IsKeyInList(pKeys, i, pKeys[i])) {
+      _Error("\"%s\": Report with key 0x%02X twice", pHost->sText, pKeys[i]);
+    }
+  }
+  for (i = 0; i < NumKeys; i++) {
+    k = pHost->IsReverse ? NumKeys - 1u - i : i;
+    if (_IsKeyInList(pHost->abLastKeys, pHost->NumLastKeys, pKeys[k])) {
+      continue;                                       // Still held, not typed again.
+    }
+    c = _acUsage2Ascii[Modifier != 0u][pKeys[k]];
+    if (c == 0) {
+      _Error("\"%s\": Report with unknown key 0x%02X", pHost->sText, pKeys[k]);
+      continue;
+    }
+    if (pHost->NumTyped < sizeof(pHost->acTyped) - 1u) {
+      pHost->acTyped[pHost->NumTyped++] = c;
+    }
+  }
+  memcpy(pHost->abLastKeys, pKeys, NumKeys);
+  pHost->NumLastKeys = NumKeys;
+}
+
+/*********************************************************************
+*
+*       _Type
+*
+*  Function description
+*    Types a text on a simulated host.
+*
+*  Return value
+*    1: The host typed the text exactly, 0: It did not.
+*/
+static int _Type(const char * sText, unsigned KeysPerReport, int IsReverse, unsigned * pNumReports) {
+  SIM_HOST Host;
+  KEY_PACK Pack;
+  unsigned NumChars;
+
+  memset(&Host, 0, sizeof(Host));
+  Host.sText         = sText;
+  Host.IsReverse     = IsReverse;
+  Host.KeysPerReport = KeysPerReport;
+  KEY_PACK_Init(&Pack, KeysPerReport, _OnReport, &Host);
+  NumChars = KEY_PACK_Output(&Pack, sText);
+  if (NumChars != strlen(sText)) {
+    _Error("\"%s\": %u characters typed", sText, NumChars);
+  }
+  if (Host.NumLastKeys != 0u) {
+    _Error("\"%s\": %u keys held after the text", sText, Host.NumLastKeys);
+  }
+  if (pNumReports != NULL) {
+    *pNumReports = Host.NumReports;
+  }
+  Host.acTyped[Host.NumTyped] = 0;
+  return strcmp(Host.acTyped, sText) == 0;
+}
+
+/*********************************************************************
+*
+*       _Check
+*
+*  Function description
+*    Checks one text with all report sizes on both hosts.
+*/
+static void _Check(const char * sText) {
+  unsigned KeysPerReport;
+
+  for (KeysPerReport = 1; KeysPerReport <= KEY_PACK_NUM_SLOTS; KeysPerReport++) {
+    if (_Type(sText, KeysPerReport, 0, NULL) == 0) {
+      _Error("\"%s\" not typed in order with %u keys per report", sText, KeysPerReport);
+    }
+  }
+  if (_Type(sText, 1, 1, NULL) == 0) {
+    _Error("\"%s\" reordered by the host with %u key per report", sText, 1);
+  }
+}
+
+/*********************************************************************
+*
+*       Public code
+*
+**********************************************************************
+*/
+
+/*********************************************************************
+*
+*       main
+*/
+int main(void) {
+  static const char * _asText[] = {
+    "a", "ab", "ba", "ll", "aaa", "aA", "Aa", "AAb", "hello", "Mississippi", "abba",
+    "Hello World! 1234567890", "a\nb\tc", "!!@@##", "aabbccdd", "The quick brown fox jumps over the lazy dog."
+  };
+  char     acText[MAX_TEXT];
+  char     acAll[128];
+  unsigned NumAll;
+  unsigned NumReports1;
+  unsigned NumReports6;
+  unsigned i;
+  unsigned n;
+  unsigned c;
+
+  _InitInverse();
+  for (i = 0; i < sizeof(_asText) / sizeof(_asText[0]); i++) {
+    _Check(_asText[i]);
+  }
+  //
+  // Every typeable character, in order and backwards.
+  //
+  NumAll = 0;
+  for (c = 1; c < 128u; c++) {
+    if ((ASCII2USAGE_Get((unsigned char)c)->Usage != 0u) && (c != '\r')) {
+      acAll[NumAll++] = (char)c;
+    }
+  }
+  acAll[NumAll] = 0;
+  _Check(acAll);
+  for (i = 0; i < NumAll; i++) {
+    acText[i] = acAll[NumAll - 1u - i];
+  }
+  acText[NumAll] = 0;
+  _Check(acText);
+  //
+  // Random texts, with many repeated characters.
+  //
+  for (i = 0; i < NUM_RANDOM_TEXTS; i++) {
+    n = 1u + _Rand(MAX_TEXT - 1u);
+    for (c = 0; c < n; c++) {
+      acText[c] = (_Rand(4) == 0) ? "aAbB"[_Rand(4)] : acAll[_Rand(NumAll)];
+    }
+    acText[n] = 0;
+    _Check(acText);
+  }
+  //
+  // A host which does not use array order reorders packed keys.
+  //
+  if (_Type("ab", 2, 1, NULL) != 0) {
+    _Error("\"%s\" typed in order with %u keys per report by the reverse host", "ab", 2);
+  }
+  (void)_Type(acAll, 1, 0, &NumReports1);
+  (void)_Type(acAll, KEY_PACK_NUM_SLOTS, 0, &NumReports6);
+  printf("KeyPack: %u characters, %u reports with 1 key per report, %u with %u\n", NumAll, NumReports1, NumReports6, KEY_PACK_NUM_SLOTS);
+  printf("KeyPack: %u errors\n", _NumErrors);
+  return (_NumErrors == 0u) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*************************** End of file ****************************/
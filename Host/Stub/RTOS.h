@@ -0,0 +1,20 @@
+/*********************************************************************
+-------------------------- END-OF-HEADER -----------------------------
+File    : RTOS.h
+Purpose : Host stand-in for the embOS interrupt API used by the BSP
+          drivers under test. Implemented by the test.
+*/
+
+#ifndef RTOS_H
+#define RTOS_H
+
+#include <string.h>   // As the real RTOS.h, provides NULL.
+
+void OS_INT_IncDI               (void);
+void OS_INT_DecRI               (void);
+void OS_EnterNestableInterrupt  (void);
+void OS_LeaveNestableInterrupt  (void);
+
+#endif  // RTOS_H
+
+/*************************** End of file ****************************/
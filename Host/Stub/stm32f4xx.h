@@ -0,0 +1,76 @@
+/*********************************************************************
+-------------------------- END-OF-HEADER -----------------------------
+File    : stm32f4xx.h
+Purpose : Host stand-in for the device header. Provides the TIM2 and
+          RCC registers used by BSP_TIMER.c. Every access to TIM2 goes
+          through SIM_TIM2_Access(), so a test can let simulated time
+          pass between two register accesses.
+*/
+
+#ifndef STM32F4XX_H
+#define STM32F4XX_H
+
+#include <stdint.h>
+
+/*********************************************************************
+*
+*       Types
+*
+**********************************************************************
+*/
+typedef enum {
+  TIM2_IRQn = 28
+} IRQn_Type;
+
+typedef struct {
+  volatile uint32_t CR1;
+  volatile uint32_t DIER;
+  volatile uint32_t SR;
+  volatile uint32_t EGR;
+  volatile uint32_t CNT;
+  volatile uint32_t PSC;
+  volatile uint32_t ARR;
+  volatile uint32_t CCR1;
+  volatile uint32_t CCR2;
+  volatile uint32_t CCR3;
+  volatile uint32_t CCR4;
+} TIM_TypeDef;
+
+typedef struct {
+  volatile uint32_t CFGR;
+  volatile uint32_t APB1ENR;
+} RCC_TypeDef;
+
+/*********************************************************************
+*
+*       Defines
+*
+**********************************************************************
+*/
+#define TIM2                  (SIM_TIM2_Access())
+#define RCC                   (&SIM_RCC)
+
+#define TIM_CR1_CEN           (0x0001u)
+#define TIM_DIER_CC1IE        (0x0002u)
+#define TIM_SR_CC1IF          (0x0002u)
+#define TIM_EGR_UG            (0x0001u)
+#define TIM_EGR_CC1G          (0x0002u)
+#define RCC_CFGR_PPRE1        (0x1C00u)
+#define RCC_APB1ENR_TIM2EN    (0x0001u)
+
+/*********************************************************************
+*
+*       Simulation, implemented by the test
+*
+**********************************************************************
+*/
+extern uint32_t      SystemCoreClock;
+extern RCC_TypeDef   SIM_RCC;
+
+TIM_TypeDef * SIM_TIM2_Access (void);
+void          NVIC_SetPriority(IRQn_Type IRQn, uint32_t Priority);
+void          NVIC_EnableIRQ  (IRQn_Type IRQn);
+
+#endif  // STM32F4XX_H
+
+/*************************** End of file ****************************/
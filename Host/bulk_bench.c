@@ -0,0 +1,399 @@
+/*********************************************************************
+-------------------------- END-OF-HEADER -----------------------------
+File    : bulk_bench.c
+Purpose : Linux host side of the bulk benchmark (USB_Bulk_Benchmark.c).
+
+Additional information:
+  Build with "make bulk_bench" in Host/, needs libusb-1.0 (on Debian
+  and Ubuntu: libusb-1.0-0-dev). The device needs to be accessible for
+  the user, e.g. via a udev rule for VID 0x8765, PID 0x1240.
+
+  Usage: bulk_bench [-d in|out|both] [-t <s>] [-s <bytes>] [-q <depth>]
+    -d  Direction(s) to run, default: in.
+    -t  Test duration in seconds, default: 10.
+    -s  Bytes per transfer, default: 4096 (BULK_TRANSFER_SIZE of the device).
+    -q  Number of transfers queued per direction, default: 4.
+
+  Once per second the throughput of each direction is printed. At the
+  end the sustained throughput over the whole run and a histogram of
+  the per-transfer latency follow, from submitting a transfer until
+  its completion. With a queue depth above 1 this includes the time a
+  transfer waits behind the ones queued ahead of it; "-q 1" measures
+  the latency of a single transfer, including the device turnaround.
+  Bucket n counts transfers of 2^n .. 2^(n+1)-1 us, as on the device.
+  IN data is checked for the sequence numbers the device sends.
+
+  Sample output:
+    IN  1.081 MB/s
+    ...
+    IN  sustained 1.079 MB/s, 10.003 s, 2635 transfers, 0 errors, 0 sequence gaps
+    IN  us:   2048: 3   4096: 2498   8192: 134
+*/
+
+/*********************************************************************
+*
+*       #include section
+*
+**********************************************************************
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <libusb.h>
+
+/*********************************************************************
+*
+*       Defines, configurable
+*
+**********************************************************************
+*/
+#define VENDOR_ID           0x8765
+#define PRODUCT_ID          0x1240
+#define INTERFACE_NO        0
+#define TRANSFER_TIMEOUT_MS 1000u
+#define MAX_QUEUE_DEPTH     64u
+
+/*********************************************************************
+*
+*       Defines, fixed
+*
+**********************************************************************
+*/
+#define NUM_LATENCY_BUCKETS 24u
+
+/*********************************************************************
+*
+*       Types, local
+*
+**********************************************************************
+*/
+typedef struct {
+  const char *             sName;
+  unsigned char            EPAddr;
+  int                      IsActive;
+  struct libusb_transfer * apTransfer[MAX_QUEUE_DEPTH];
+  double                   aSubmitTime[MAX_QUEUE_DEPTH];
+  unsigned                 NumInFlight;
+  unsigned long long       NumBytes;
+  unsigned long long       NumBytesInterval;
+  unsigned long            NumTransfers;
+  unsigned long            NumErrors;
+  unsigned long            NumSeqGaps;
+  unsigned long            NextSeq;
+  int                      HasSeq;
+  unsigned long            aNumLatency[NUM_LATENCY_BUCKETS];
+} DIRECTION;
+
+/*********************************************************************
+*
+*       Static data
+*
+**********************************************************************
+*/
+static DIRECTION _In  = { .sName = "IN " };
+static DIRECTION _Out = { .sName = "OUT" };
+static int       _IsStopping;
+static unsigned  _TransferSize = 4096u;
+
+/*********************************************************************
+*
+*       Static code
+*
+**********************************************************************
+*/
+
+/*********************************************************************
+*
+*       _GetTime
+*
+*  Function description
+*    Returns a monotonic time in seconds.
+*/
+static double _GetTime(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+/*********************************************************************
+*
+*       _CountLatency
+*/
+static void _CountLatency(DIRECTION * pDir, double Seconds) {
+  unsigned long Us;
+  unsigned      Bucket;
+
+  Us     = (unsigned long)(Seconds * 1e6);
+  Bucket = 0;
+  while ((Us > 1u) && (Bucket < NUM_LATENCY_BUCKETS - 1u)) {
+    Us >>= 1;
+    Bucket++;
+  }
+  pDir->aNumLatency[Bucket]++;
+}
+
+/*********************************************************************
+*
+*       _CheckSequence
+*
+*  Function description
+*    Checks the sequence number at the start of an IN transfer.
+*/
+static void _CheckSequence(DIRECTION * pDir, const unsigned char * pData, int NumBytes) {
+  unsigned long Seq;
+
+  if (NumBytes < 4) {
+    pDir->NumSeqGaps++;
+    return;
+  }
+  Seq = (unsigned long)pData[0] | ((unsigned long)pData[1] << 8) | ((unsigned long)pData[2] << 16) | ((unsigned long)pData[3] << 24);
+  if (pDir->HasSeq && (Seq != pDir->NextSeq)) {
+    pDir->NumSeqGaps++;
+  }
+  pDir->HasSeq  = 1;
+  pDir->NextSeq = Seq + 1u;
+}
+
+/*********************************************************************
+*
+*       _OnTransfer
+*
+*  Function description
+*    Completion callback, runs in libusb_handle_events*().
+*/
+static void LIBUSB_CALL _OnTransfer(struct libusb_transfer * pTransfer) {
+  DIRECTION * pDir;
+  unsigned    Slot;
+  double      Now;
+
+  Now  = _GetTime();
+  pDir = (DIRECTION *)pTransfer->user_data;
+  for (Slot = 0; pDir->apTransfer[Slot] != pTransfer; Slot++) {
+  }
+  pDir->NumInFlight--;
+  if (pTransfer->status == LIBUSB_TRANSFER_COMPLETED) {
+    _CountLatency(pDir, Now - pDir->aSubmitTime[Slot]);
+    pDir->NumBytes         += (unsigned)pTransfer->actual_length;
+    pDir->NumBytesInterval += (unsigned)pTransfer->actual_length;
+    pDir->NumTransfers++;
+    if (pDir == &_In) {
+      _CheckSequence(pDir, pTransfer->buffer, pTransfer->actual_length);
+    }
+  } else if (pTransfer->status != LIBUSB_TRANSFER_CANCELLED) {
+    pDir->NumErrors++;
+    pDir->HasSeq = 0;
+  }
+  if (_IsStopping == 0) {
+    pDir->aSubmitTime[Slot] = _GetTime();
+    if (libusb_submit_transfer(pTransfer) == 0) {
+      pDir->NumInFlight++;
+    } else {
+      pDir->NumErrors++;
+    }
+  }
+}
+
+/*********************************************************************
+*
+*       _Start
+*
+*  Function description
+*    Allocates and submits QueueDepth transfers for one direction.
+*/
+static int _Start(libusb_device_handle * pHandle, DIRECTION * pDir, unsigned QueueDepth) {
+  struct libusb_transfer * pTransfer;
+  unsigned char *          pBuffer;
+  unsigned                 i;
+
+  for (i = 0; i < QueueDepth; i++) {
+    pTransfer = libusb_alloc_transfer(0);
+    pBuffer   = (unsigned char *)calloc(1, _TransferSize);
+    if ((pTransfer == NULL) || (pBuffer == NULL)) {
+      fprintf(stderr, "Out of memory\n");
+      return -1;
+    }
+    libusb_fill_bulk_transfer(pTransfer, pHandle, pDir->EPAddr, pBuffer, (int)_TransferSize, _OnTransfer, pDir, TRANSFER_TIMEOUT_MS);
+    pDir->apTransfer[i]  = pTransfer;
+    pDir->aSubmitTime[i] = _GetTime();
+    if (libusb_submit_transfer(pTransfer) != 0) {
+      fprintf(stderr, "Can not submit %s transfer\n", pDir->sName);
+      return -1;
+    }
+    pDir->NumInFlight++;
+  }
+  pDir->IsActive = 1;
+  return 0;
+}
+
+/*********************************************************************
+*
+*       _FindEndpoints
+*
+*  Function description
+*    Looks up the bulk endpoints of the vendor interface.
+*/
+static int _FindEndpoints(libusb_device_handle * pHandle) {
+  struct libusb_config_descriptor *         pConfig;
+  const struct libusb_interface_descriptor * pIf;
+  const struct libusb_endpoint_descriptor *  pEP;
+  int                                        i;
+
+  if (libusb_get_active_config_descriptor(libusb_get_device(pHandle), &pConfig) != 0) {
+    return -1;
+  }
+  pIf = &pConfig->interface[INTERFACE_NO].altsetting[0];
+  for (i = 0; i < pIf->bNumEndpoints; i++) {
+    pEP = &pIf->endpoint[i];
+    if ((pEP->bmAttributes & 3u) != LIBUSB_TRANSFER_TYPE_BULK) {
+      continue;
+    }
+    if (pEP->bEndpointAddress & LIBUSB_ENDPOINT_IN) {
+      _In.EPAddr = pEP->bEndpointAddress;
+    } else {
+      _Out.EPAddr = pEP->bEndpointAddress;
+    }
+  }
+  libusb_free_config_descriptor(pConfig);
+  return ((_In.EPAddr != 0u) && (_Out.EPAddr != 0u)) ? 0 : -1;
+}
+
+/*********************************************************************
+*
+*       _ShowResult
+*/
+static void _ShowResult(const DIRECTION * pDir, double Duration) {
+  unsigned i;
+
+  if (pDir->IsActive == 0) {
+    return;
+  }
+  printf("%s sustained %.3f MB/s, %.3f s, %lu transfers, %lu errors, %lu sequence gaps\n", pDir->sName,
+         (double)pDir->NumBytes / Duration / 1e6, Duration, pDir->NumTransfers, pDir->NumErrors, pDir->NumSeqGaps);
+  printf("%s us:", pDir->sName);
+  for (i = 0; i < NUM_LATENCY_BUCKETS; i++) {
+    if (pDir->aNumLatency[i] != 0u) {
+      printf(" %6lu: %lu", 1ul << i, pDir->aNumLatency[i]);
+    }
+  }
+  printf("\n");
+}
+
+/*********************************************************************
+*
+*       Public code
+*
+**********************************************************************
+*/
+
+/*********************************************************************
+*
+*       main
+*/
+int main(int argc, char ** argv) {
+  libusb_context *       pContext;
+  libusb_device_handle * pHandle;
+  struct timeval         tv;
+  const char *           sDir;
+  unsigned               Seconds;
+  unsigned               QueueDepth;
+  double                 Start;
+  double                 LastShow;
+  double                 Now;
+  int                    Opt;
+  int                    r;
+
+  sDir       = "in";
+  Seconds    = 10;
+  QueueDepth = 4;
+  while ((Opt = getopt(argc, argv, "d:t:s:q:")) != -1) {
+    switch (Opt) {
+    case 'd': sDir          = optarg;                                  break;
+    case 't': Seconds       = (unsigned)strtoul(optarg, NULL, 0);      break;
+    case 's': _TransferSize = (unsigned)strtoul(optarg, NULL, 0);      break;
+    case 'q': QueueDepth    = (unsigned)strtoul(optarg, NULL, 0);      break;
+    default:
+      fprintf(stderr, "Usage: %s [-d in|out|both] [-t <s>] [-s <bytes>] [-q <depth>]\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+  if ((QueueDepth == 0u) || (QueueDepth > MAX_QUEUE_DEPTH) || (_TransferSize == 0u)) {
+    fprintf(stderr, "Queue depth must be 1..%u, transfer size > 0\n", MAX_QUEUE_DEPTH);
+    return EXIT_FAILURE;
+  }
+  if (libusb_init(&pContext) != 0) {
+    fprintf(stderr, "libusb_init() failed\n");
+    return EXIT_FAILURE;
+  }
+  pHandle = libusb_open_device_with_vid_pid(pContext, VENDOR_ID, PRODUCT_ID);
+  if (pHandle == NULL) {
+    fprintf(stderr, "Device %04X:%04X not found or no access\n", VENDOR_ID, PRODUCT_ID);
+    libusb_exit(pContext);
+    return EXIT_FAILURE;
+  }
+  libusb_set_auto_detach_kernel_driver(pHandle, 1);
+  r = libusb_claim_interface(pHandle, INTERFACE_NO);
+  if ((r != 0) || (_FindEndpoints(pHandle) != 0)) {
+    fprintf(stderr, "Can not claim the bulk interface\n");
+    libusb_close(pHandle);
+    libusb_exit(pContext);
+    return EXIT_FAILURE;
+  }
+  r = 0;
+  if ((strcmp(sDir, "in") == 0) || (strcmp(sDir, "both") == 0)) {
+    r |= _Start(pHandle, &_In, QueueDepth);
+  }
+  if ((strcmp(sDir, "out") == 0) || (strcmp(sDir, "both") == 0)) {
+    r |= _Start(pHandle, &_Out, QueueDepth);
+  }
+  if ((r != 0) || ((_In.IsActive | _Out.IsActive) == 0)) {
+    fprintf(stderr, "No transfers running, check -d\n");
+    _IsStopping = 1;
+  }
+  Start    = _GetTime();
+  LastShow = Start;
+  while (_IsStopping == 0) {
+    tv.tv_sec  = 0;
+    tv.tv_usec = 100000;
+    libusb_handle_events_timeout_completed(pContext, &tv, NULL);
+    Now = _GetTime();
+    if (Now - LastShow >= 1.0) {
+      if (_In.IsActive) {
+        printf("IN  %.3f MB/s%s", (double)_In.NumBytesInterval / (Now - LastShow) / 1e6, _Out.IsActive ? ", " : "\n");
+      }
+      if (_Out.IsActive) {
+        printf("OUT %.3f MB/s\n", (double)_Out.NumBytesInterval / (Now - LastShow) / 1e6);
+      }
+      fflush(stdout);
+      _In.NumBytesInterval  = 0;
+      _Out.NumBytesInterval = 0;
+      LastShow              = Now;
+    }
+    if (Now - Start >= (double)Seconds) {
+      _IsStopping = 1;
+    }
+  }
+  Now = _GetTime();
+  //
+  // Let the transfers in flight finish, they are not resubmitted.
+  //
+  while ((_In.NumInFlight + _Out.NumInFlight) != 0u) {
+    tv.tv_sec  = 0;
+    tv.tv_usec = 100000;
+    libusb_handle_events_timeout_completed(pContext, &tv, NULL);
+    if (_GetTime() - Now > 2.0 * TRANSFER_TIMEOUT_MS / 1000.0) {
+      break;
+    }
+  }
+  Now = _GetTime();                       // The drained transfers count as well.
+  _ShowResult(&_In,  Now - Start);
+  _ShowResult(&_Out, Now - Start);
+  libusb_release_interface(pHandle, INTERFACE_NO);
+  libusb_close(pHandle);
+  libusb_exit(pContext);
+  return ((_In.NumErrors + _Out.NumErrors + _In.NumSeqGaps) == 0u) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*************************** End of file ****************************/
@@ -0,0 +1,52 @@
+/*********************************************************************
+-------------------------- END-OF-HEADER -----------------------------
+File    : Ascii2Usage.h
+Purpose : ASCII to keyboard usage ID lookup (US layout).
+*/
+
+#ifndef ASCII2USAGE_H
+#define ASCII2USAGE_H
+
+/*********************************************************************
+*
+*       Defines, fixed
+*
+**********************************************************************
+*/
+
+//
+// Modifier bit of the boot keyboard report used by the table.
+//
+#define ASCII2USAGE_MOD_LSHIFT   (1u << 1)
+
+/*********************************************************************
+*
+*       Types, global
+*
+**********************************************************************
+*/
+
+typedef struct {
+  unsigned char Modifier;       // Modifier byte of the report (0 or ASCII2USAGE_MOD_LSHIFT).
+  unsigned char Usage;          // Usage ID of the keyboard page, 0 if the character can not be typed.
+} ASCII_TO_USAGE;
+
+/*********************************************************************
+*
+*       API functions / Function prototypes
+*
+**********************************************************************
+*/
+#if defined(__cplusplus)
+  extern "C" {
+#endif
+
+const ASCII_TO_USAGE * ASCII2USAGE_Get(unsigned char c);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif  // ASCII2USAGE_H
+
+/*************************** End of file ****************************/
@@ -47,6 +47,14 @@ Purpose : BSP (Board support package)
   #define BSP_USE_PARA(para)  (void) (para)
 #endif
 
+//
+// If set to 1, the SysTick handler measures its own entry latency,
+// see BSP_GetMaxTickLatency(). For the other interrupts, see BSP_IRQ.h.
+//
+#ifndef BSP_MEASURE_TICK_LATENCY
+  #define BSP_MEASURE_TICK_LATENCY  (0)
+#endif
+
 #if   (defined(__ICCARM__) && (__CPU_MODE__ == 1))  // If IAR and THUMB mode
   #define INTERWORK  __interwork
 #elif (defined(__ICC430__))
@@ -72,6 +80,7 @@ void          BSP_ClrLED      (int Index);
 void          BSP_ToggleLED   (int Index);
 int           BSP_GetLEDState (int Index);
 int           BSP_FPGA_Init   (void);
+unsigned long BSP_GetMaxTickLatency(void);
 
 void          MemoryInit      (void);
 INTERWORK int __low_level_init(void);
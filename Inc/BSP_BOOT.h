@@ -0,0 +1,61 @@
+/*********************************************************************
+-------------------------- END-OF-HEADER -----------------------------
+File    : BSP_BOOT.h
+Purpose : Header file for the boot time line.
+*/
+
+#ifndef BSP_BOOT_H
+#define BSP_BOOT_H
+
+/*********************************************************************
+*
+*       Defines
+*
+**********************************************************************
+*/
+
+//
+// If set to 1, BSP_BOOT_Print() also sends the time line to SystemView.
+//
+#ifndef BSP_BOOT_USE_SYSVIEW
+  #define BSP_BOOT_USE_SYSVIEW  (0)
+#endif
+
+//
+// Boot milestones in the order they are reached.
+//
+#define BSP_BOOT_SYSTEM_INIT      (0u)  // Entry of SystemInit(), time base of the time line.
+#define BSP_BOOT_CLOCK_READY      (1u)  // PLL running, SetSysClock() done.
+#define BSP_BOOT_MAIN             (2u)  // Entry of main(), C runtime initialized.
+#define BSP_BOOT_OS_INIT_HW       (3u)  // OS_Init() and OS_InitHW() done.
+#define BSP_BOOT_BSP_INIT         (4u)  // BSP_Init() and BSP_KEY_Init() done.
+#define BSP_BOOT_MAIN_TASK        (5u)  // OS started, entry of MainTask().
+#define BSP_BOOT_USBD_CONFIG      (6u)  // Entry of USBD_X_Config(), called by USBD_Init().
+#define BSP_BOOT_USBD_CONFIG_END  (7u)  // Exit of USBD_X_Config().
+#define BSP_BOOT_USBD_START       (8u)  // USB interrupt enabled by USBD_Start().
+#define BSP_BOOT_USB_ADDRESSED    (9u)  // Address assigned by the host.
+#define BSP_BOOT_USB_CONFIGURED   (10u) // Configuration selected by the host.
+#define BSP_BOOT_NUM_MILESTONES   (11u)
+
+/*********************************************************************
+*
+*       API functions / Function prototypes
+*
+**********************************************************************
+*/
+#if defined(__cplusplus)
+  extern "C" {
+#endif
+
+void          BSP_BOOT_Start     (void);
+void          BSP_BOOT_Mark      (unsigned int Milestone);
+unsigned long BSP_BOOT_GetTimeUs (unsigned int Milestone);
+void          BSP_BOOT_Print     (void);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif  // BSP_BOOT_H
+
+/*************************** End of file ****************************/
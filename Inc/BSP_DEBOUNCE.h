@@ -0,0 +1,56 @@
+/*********************************************************************
+-------------------------- END-OF-HEADER -----------------------------
+File    : BSP_DEBOUNCE.h
+Purpose : Debounce state machine of a single key.
+*/
+
+#ifndef BSP_DEBOUNCE_H
+#define BSP_DEBOUNCE_H
+
+/*********************************************************************
+*
+*       Defines
+*
+**********************************************************************
+*/
+
+//
+// Result bits of BSP_DEBOUNCE_Step().
+//
+#define BSP_DEBOUNCE_CHANGED  (1u << 0)  // IsPressed changed, report it with TimeStamp.
+#define BSP_DEBOUNCE_IDLE     (1u << 1)  // Stable released, sampling can stop until the next edge.
+
+/*********************************************************************
+*
+*       Types, global
+*
+**********************************************************************
+*/
+
+typedef struct {
+  unsigned long TimeStamp;    // Time when the level left the stable state.
+  unsigned int  StableCnt;    // Number of consecutive samples with the same level.
+  unsigned char LastLevel;    // Level of the previous sample, 1: pressed.
+  unsigned char IsPressed;    // Debounced state.
+} BSP_DEBOUNCE_STATE;
+
+/*********************************************************************
+*
+*       API functions / Function prototypes
+*
+**********************************************************************
+*/
+#if defined(__cplusplus)
+  extern "C" {
+#endif
+
+void         BSP_DEBOUNCE_OnEdge (BSP_DEBOUNCE_STATE* pState, unsigned long Time);
+unsigned int BSP_DEBOUNCE_Step   (BSP_DEBOUNCE_STATE* pState, unsigned int Level, unsigned long Time, unsigned int DebounceCnt);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif  // BSP_DEBOUNCE_H
+
+/*************************** End of file ****************************/
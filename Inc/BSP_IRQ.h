@@ -0,0 +1,130 @@
+/*********************************************************************
+-------------------------- END-OF-HEADER -----------------------------
+File    : BSP_IRQ.h
+Purpose : Interrupt priorities of the project and IRQ latency test.
+*/
+
+#ifndef BSP_IRQ_H
+#define BSP_IRQ_H
+
+/*********************************************************************
+*
+*       Defines
+*
+**********************************************************************
+*/
+
+//
+// If set to 1, the handlers record their entry time and
+// BSP_IRQ_TestLatency() / BSP_IRQ_PrintLatency() are available.
+//
+#ifndef BSP_IRQ_MEASURE_LATENCY
+  #define BSP_IRQ_MEASURE_LATENCY  (0)
+#endif
+
+//
+// Preemption priorities as NVIC levels, 0 is the highest.
+// Only the upper BSP_IRQ_PRIO_BITS of the 8-bit priority are implemented.
+//
+// Levels below BSP_IRQ_PRIO_EMBOS_MIN are zero latency interrupts, which
+// are never masked by embOS and must not call embOS functions. All
+// handlers of this project call embOS, so they use the levels from
+// BSP_IRQ_PRIO_EMBOS_MIN to BSP_IRQ_PRIO_PENDSV - 1.
+//
+#define BSP_IRQ_PRIO_BITS          (4u)
+#define BSP_IRQ_PRIO_EMBOS_MIN     (8u)    // OS_IPL_THRESHOLD (128) >> (8 - BSP_IRQ_PRIO_BITS).
+#define BSP_IRQ_PRIO_PENDSV        (15u)   // Lowest level, set by embOS for the task switch.
+//
+// Short handlers with the tightest deadline preempt the longer ones:
+//   TIM2    : One-shot microsecond timers (BSP_TIMER.c). A late handler
+//             directly adds to the timeout.
+//   USART3  : embOSView. One received byte must be read before the next
+//             one is complete, which is 260 us at 38400 baud (OS_BAUDRATE
+//             in RTOSInit_STM32F4xx.c).
+//   OTG_FS  : USB device. Copies whole packets between FIFO and memory,
+//             its handler is the longest one.
+//   SysTick : embOS tick and software timers.
+// The key EXTI and matrix handlers share data with the key software timer
+// without a lock, see BSP_KEY_CB. They must stay at the SysTick level.
+//
+#define BSP_IRQ_PRIO_TIMER         (10u)
+#define BSP_IRQ_PRIO_UART          (11u)
+#define BSP_IRQ_PRIO_USB           (12u)
+#define BSP_IRQ_PRIO_SYSTICK       (14u)
+#define BSP_IRQ_PRIO_KEY_EXTI      (BSP_IRQ_PRIO_SYSTICK)
+#define BSP_IRQ_PRIO_KEY_MATRIX    (BSP_IRQ_PRIO_SYSTICK)
+//
+// Zero latency level of the load probe (TIM6, see BSP_IRQ_StartProbe()).
+// It has to preempt embOS and USB critical sections and does not call embOS.
+//
+#define BSP_IRQ_PRIO_PROBE         (2u)
+
+//
+// Converts an NVIC level into the 8-bit priority expected by
+// BSP_USB_InstallISR_Ex().
+//
+#define BSP_IRQ_PRIO_8BIT(Level)   ((Level) << (8u - BSP_IRQ_PRIO_BITS))
+
+//
+// IRQs of the project, index into the latency table.
+//
+#define BSP_IRQ_ID_SYSTICK         (0u)
+#define BSP_IRQ_ID_KEY_EXTI        (1u)
+#define BSP_IRQ_ID_KEY_MATRIX      (2u)
+#define BSP_IRQ_ID_TIMER           (3u)
+#define BSP_IRQ_ID_UART            (4u)
+#define BSP_IRQ_ID_USB             (5u)
+#define BSP_IRQ_NUM_IDS            (6u)
+
+//
+// Called first in each handler.
+//
+#if BSP_IRQ_MEASURE_LATENCY
+  #define BSP_IRQ_ENTER(Id)        BSP_IRQ_OnEnter(Id)
+#else
+  #define BSP_IRQ_ENTER(Id)
+#endif
+
+/*********************************************************************
+*
+*       Compile time checks
+*
+**********************************************************************
+*/
+
+#if (BSP_IRQ_PRIO_TIMER   < BSP_IRQ_PRIO_EMBOS_MIN) || (BSP_IRQ_PRIO_TIMER   >= BSP_IRQ_PRIO_PENDSV) \
+ || (BSP_IRQ_PRIO_UART    < BSP_IRQ_PRIO_EMBOS_MIN) || (BSP_IRQ_PRIO_UART    >= BSP_IRQ_PRIO_PENDSV) \
+ || (BSP_IRQ_PRIO_USB     < BSP_IRQ_PRIO_EMBOS_MIN) || (BSP_IRQ_PRIO_USB     >= BSP_IRQ_PRIO_PENDSV) \
+ || (BSP_IRQ_PRIO_SYSTICK < BSP_IRQ_PRIO_EMBOS_MIN) || (BSP_IRQ_PRIO_SYSTICK >= BSP_IRQ_PRIO_PENDSV)
+  #error "Interrupt priorities must be embOS managed and above PendSV"
+#endif
+#if (BSP_IRQ_PRIO_PROBE >= BSP_IRQ_PRIO_EMBOS_MIN)
+  #error "The load probe must be a zero latency interrupt"
+#endif
+#if (BSP_IRQ_PRIO_KEY_EXTI != BSP_IRQ_PRIO_SYSTICK) || (BSP_IRQ_PRIO_KEY_MATRIX != BSP_IRQ_PRIO_SYSTICK)
+  #error "Key interrupts must have the SysTick priority, see BSP_KEY_CB"
+#endif
+
+/*********************************************************************
+*
+*       API functions / Function prototypes
+*
+**********************************************************************
+*/
+#if defined(__cplusplus)
+  extern "C" {
+#endif
+
+void          BSP_IRQ_OnEnter      (unsigned int Id);
+unsigned long BSP_IRQ_TestLatency  (unsigned int Id);
+void          BSP_IRQ_PrintLatency (void);
+void          BSP_IRQ_StartProbe   (unsigned int Id, unsigned int PeriodUs);
+unsigned long BSP_IRQ_GetProbeLatency(unsigned int Id, unsigned long * pNumSamples);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif  // BSP_IRQ_H
+
+/*************************** End of file ****************************/
@@ -0,0 +1,110 @@
+/*********************************************************************
+-------------------------- END-OF-HEADER -----------------------------
+File    : BSP_KEY.h
+Purpose : Header file for debounced key input BSP functions.
+*/
+
+#ifndef BSP_KEY_H
+#define BSP_KEY_H
+
+/*********************************************************************
+*
+*       Defines
+*
+**********************************************************************
+*/
+
+//
+// In order to avoid warnings for unused parameters.
+//
+#ifndef BSP_KEY_USE_PARA
+  #define BSP_KEY_USE_PARA(para)  (void) (para)
+#endif
+
+//
+// Default debounce time [ms]. A key must show the same level
+// for this time before a press or release is reported.
+//
+#ifndef BSP_KEY_DEBOUNCE_MS
+  #define BSP_KEY_DEBOUNCE_MS  (10u)
+#endif
+
+//
+// Scanned key matrix. Rows are driven on PD0..PD(NUM_ROWS - 1),
+// columns are read on PD8..PD(8 + NUM_COLS - 1).
+//
+#ifndef BSP_KEY_MATRIX_ENABLE
+  #define BSP_KEY_MATRIX_ENABLE         (0)
+#endif
+#ifndef BSP_KEY_MATRIX_NUM_ROWS
+  #define BSP_KEY_MATRIX_NUM_ROWS       (4u)    // 1..8
+#endif
+#ifndef BSP_KEY_MATRIX_NUM_COLS
+  #define BSP_KEY_MATRIX_NUM_COLS       (8u)    // 1..8
+#endif
+#ifndef BSP_KEY_MATRIX_ROW_PERIOD_US
+  #define BSP_KEY_MATRIX_ROW_PERIOD_US  (250u)  // Time per row, a full scan takes NUM_ROWS times this.
+#endif
+#ifndef BSP_KEY_MATRIX_DEBOUNCE_SCANS
+  #define BSP_KEY_MATRIX_DEBOUNCE_SCANS (5u)    // Number of identical scans before a change is reported.
+#endif
+
+//
+// Keys connected to EXTI lines.
+//
+#define BSP_KEY_S         (0u)  // PE10
+#define BSP_KEY_T         (1u)  // PE11
+#define BSP_KEY_M         (2u)  // PE12
+#define BSP_KEY_NUM_EXTI  (3u)
+
+//
+// Matrix keys follow the EXTI keys: Index = BSP_KEY_MATRIX_FIRST + Row * NUM_COLS + Col.
+//
+#define BSP_KEY_MATRIX_FIRST  BSP_KEY_NUM_EXTI
+#if BSP_KEY_MATRIX_ENABLE
+  #define BSP_KEY_NUM_KEYS    (BSP_KEY_NUM_EXTI + BSP_KEY_MATRIX_NUM_ROWS * BSP_KEY_MATRIX_NUM_COLS)
+#else
+  #define BSP_KEY_NUM_KEYS    BSP_KEY_NUM_EXTI
+#endif
+
+/*********************************************************************
+*
+*       Types, global
+*
+**********************************************************************
+*/
+
+//
+// Called for every debounced state change of a key.
+// Runs in interrupt context (embOS software timer or matrix scan timer).
+// Both contexts run at the same preemption priority, so calls never nest.
+// TimeStamp is the DWT cycle counter at the time the level of the
+// key first left its previous stable state.
+//
+typedef void BSP_KEY_CB(unsigned int KeyIndex, int IsPressed, unsigned long TimeStamp);
+
+/*********************************************************************
+*
+*       API functions / Function prototypes
+*
+**********************************************************************
+*/
+#if defined(__cplusplus)
+  extern "C" {
+#endif
+
+void BSP_KEY_Init            (void);
+void BSP_KEY_SetCallback     (BSP_KEY_CB* pf);
+void BSP_KEY_SetDebounceTime (unsigned int ms);
+int  BSP_KEY_IsPressed       (unsigned int KeyIndex);
+#if BSP_KEY_MATRIX_ENABLE
+void BSP_KEY_GetScanCycles   (unsigned long* pLast, unsigned long* pMax);
+#endif
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif  // BSP_KEY_H
+
+/*************************** End of file ****************************/
@@ -0,0 +1,31 @@
+/*********************************************************************
+-------------------------- END-OF-HEADER -----------------------------
+File    : BSP_TIME.h
+Purpose : Header file for the 64-bit time base.
+*/
+
+#ifndef BSP_TIME_H
+#define BSP_TIME_H
+
+/*********************************************************************
+*
+*       API functions / Function prototypes
+*
+**********************************************************************
+*/
+#if defined(__cplusplus)
+  extern "C" {
+#endif
+
+void               BSP_TIME_Init     (void);
+void               BSP_TIME_OnTick   (void);
+unsigned long long BSP_TIME_Get_us64 (void);
+unsigned long long BSP_TIME_Get_ms64 (void);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif  // BSP_TIME_H
+
+/*************************** End of file ****************************/
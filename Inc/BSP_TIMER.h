@@ -0,0 +1,55 @@
+/*********************************************************************
+-------------------------- END-OF-HEADER -----------------------------
+File    : BSP_TIMER.h
+Purpose : Header file for the microsecond one-shot timer.
+*/
+
+#ifndef BSP_TIMER_H
+#define BSP_TIMER_H
+
+/*********************************************************************
+*
+*       Defines
+*
+**********************************************************************
+*/
+
+//
+// Number of one-shot timers which may run at the same time
+// (compare channels of TIM2).
+//
+#define BSP_TIMER_NUM_CHANNELS  (4u)
+
+/*********************************************************************
+*
+*       Types, global
+*
+**********************************************************************
+*/
+
+//
+// Called from the TIM2 interrupt when a one-shot timer expires.
+//
+typedef void BSP_TIMER_CB(void * pContext);
+
+/*********************************************************************
+*
+*       API functions / Function prototypes
+*
+**********************************************************************
+*/
+#if defined(__cplusplus)
+  extern "C" {
+#endif
+
+void BSP_TIMER_Init  (void);
+int  BSP_TIMER_Start (unsigned long Us, BSP_TIMER_CB * pfOnExpire, void * pContext);
+void BSP_TIMER_Stop  (int Handle);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif  // BSP_TIMER_H
+
+/*************************** End of file ****************************/
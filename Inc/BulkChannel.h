@@ -0,0 +1,91 @@
+/*********************************************************************
+-------------------------- END-OF-HEADER -----------------------------
+File    : BulkChannel.h
+Purpose : Double buffered bulk transfer state machine of the bulk benchmark.
+*/
+
+#ifndef BULKCHANNEL_H
+#define BULKCHANNEL_H
+
+/*********************************************************************
+*
+*       Defines, fixed
+*
+**********************************************************************
+*/
+#define BULK_CHANNEL_NUM_BUFFERS   2u
+//
+// Transfer time histogram: Bucket n counts transfers of 2^n .. 2^(n+1)-1 us.
+//
+#define BULK_CHANNEL_NUM_BUCKETS   16u
+
+/*********************************************************************
+*
+*       Types, global
+*
+**********************************************************************
+*/
+
+typedef enum {
+  BULK_BUFFER_FREE,              // Owned by the task.
+  BULK_BUFFER_READY,             // IN: Filled by the task, waiting for the endpoint. OUT: Filled by the host, waiting for the task.
+  BULK_BUFFER_BUSY               // Owned by the USB stack.
+} BULK_BUFFER_STATE;
+
+typedef struct {
+  unsigned long NumBytes;
+  unsigned long NumTransfers;
+  unsigned long NumErrors;
+  unsigned long aNumLatency[BULK_CHANNEL_NUM_BUCKETS];
+} BULK_STATS;
+
+typedef struct BULK_CHANNEL BULK_CHANNEL;
+
+//
+// Starts the transfer of NumBytes at pData on the endpoint of the channel.
+// The stack reports the end of the transfer with BULK_CHANNEL_OnComplete().
+//
+typedef void BULK_START_FUNC(BULK_CHANNEL * pChannel, unsigned char * pData, unsigned NumBytes);
+
+struct BULK_CHANNEL {
+  unsigned char *            pBuffer;                                    // BULK_CHANNEL_NUM_BUFFERS * NumBytesPerBuffer bytes.
+  unsigned                   NumBytesPerBuffer;
+  unsigned                   InDir;
+  unsigned long              TicksPerUs;                                 // Unit of the time stamps passed in.
+  BULK_START_FUNC *          pfStart;
+  void *                     pContext;                                   // User context, not used by the channel.
+  volatile BULK_BUFFER_STATE aState[BULK_CHANNEL_NUM_BUFFERS];
+  volatile unsigned          aNumBytes[BULK_CHANNEL_NUM_BUFFERS];        // OUT: Number of bytes received into the buffer.
+  unsigned                   TaskIndex;                                  // Next buffer to fill (IN) or to consume (OUT).
+  unsigned                   USBIndex;                                   // Buffer in flight or next to transfer.
+  volatile unsigned char     IsBusy;
+  volatile unsigned char     IsStopped;                                  // A transfer failed, wait for BULK_CHANNEL_Restart().
+  unsigned long              StartTime;                                  // Start of the transfer in flight.
+  BULK_STATS                 Stats;
+};
+
+/*********************************************************************
+*
+*       API functions / Function prototypes
+*
+**********************************************************************
+*/
+#if defined(__cplusplus)
+  extern "C" {
+#endif
+
+void            BULK_CHANNEL_Init          (BULK_CHANNEL * pChannel, unsigned InDir, unsigned char * pBuffer, unsigned NumBytesPerBuffer, unsigned long TicksPerUs, BULK_START_FUNC * pfStart, void * pContext);
+void            BULK_CHANNEL_OnComplete    (BULK_CHANNEL * pChannel, int Status, unsigned NumBytes, unsigned long Now);
+unsigned char * BULK_CHANNEL_GetTaskBuffer (const BULK_CHANNEL * pChannel, unsigned * pNumBytes);
+void            BULK_CHANNEL_Submit        (BULK_CHANNEL * pChannel, unsigned long Now);
+void            BULK_CHANNEL_Restart       (BULK_CHANNEL * pChannel, unsigned long Now);
+void            BULK_CHANNEL_CountTransfer (BULK_CHANNEL * pChannel, int NumBytes, unsigned long Ticks);
+void            BULK_CHANNEL_GetStats      (BULK_CHANNEL * pChannel, BULK_STATS * pStats);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif  // BULKCHANNEL_H
+
+/*************************** End of file ****************************/
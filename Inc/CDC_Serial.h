@@ -0,0 +1,66 @@
+/*********************************************************************
+-------------------------- END-OF-HEADER -----------------------------
+File    : CDC_Serial.h
+Purpose : CDC-ACM virtual COM port with a zero-copy transmit ring.
+*/
+
+#ifndef CDC_SERIAL_H
+#define CDC_SERIAL_H
+
+#include "USB.h"
+
+/*********************************************************************
+*
+*       Defines
+*
+**********************************************************************
+*/
+//
+// embOSView interface selection (OS_VIEW_IFSELECT) for the virtual COM port.
+// Extends the OS_VIEW_IF_* values of RTOS.h.
+//
+#define OS_VIEW_IF_USB_CDC  (4u)
+
+/*********************************************************************
+*
+*       Types, global
+*
+**********************************************************************
+*/
+//
+// Called from the USB interrupt for each byte received from the host.
+//
+typedef void CDC_SERIAL_RX_CB(unsigned char Data);
+//
+// Called whenever the transmit ring can take another byte.
+// Returns 0 if a byte has been written with CDC_SERIAL_Write1(),
+// != 0 if there is nothing more to send (same as BSP_UART_TX_CB).
+//
+typedef int  CDC_SERIAL_TX_CB(void);
+
+/*********************************************************************
+*
+*       API functions / Function prototypes
+*
+**********************************************************************
+*/
+#if defined(__cplusplus)
+  extern "C" {
+#endif
+
+void     CDC_SERIAL_Add              (void);
+unsigned CDC_SERIAL_Reserve          (U8 ** ppData, unsigned NumBytes);
+void     CDC_SERIAL_Commit           (unsigned NumBytes);
+unsigned CDC_SERIAL_Write            (const void * pData, unsigned NumBytes);
+void     CDC_SERIAL_Write1           (unsigned char Data);
+void     CDC_SERIAL_SetReadCallback  (CDC_SERIAL_RX_CB * pf);
+void     CDC_SERIAL_SetWriteCallback (CDC_SERIAL_TX_CB * pf);
+U32      CDC_SERIAL_GetNumBytesDropped(void);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif  // CDC_SERIAL_H
+
+/*************************** End of file ****************************/
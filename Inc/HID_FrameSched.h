@@ -0,0 +1,85 @@
+/*********************************************************************
+-------------------------- END-OF-HEADER -----------------------------
+File    : HID_FrameSched.h
+Purpose : Schedules HID input reports relative to the host's polls
+          of an interrupt IN endpoint.
+*/
+
+#ifndef HID_FRAMESCHED_H
+#define HID_FRAMESCHED_H
+
+#include "RTOS.h"
+#include "USB.h"
+#include "HID_ReportQueue.h"
+
+/*********************************************************************
+*
+*       Defines
+*
+**********************************************************************
+*/
+
+//
+// Number of buckets of the report-ready to IN-token histogram.
+// Bucket n counts reports fetched 2^n .. 2^(n+1)-1 us after HID_SCHED_Put().
+//
+#define HID_SCHED_NUM_BUCKETS  (16u)
+
+//
+// If set to 1, every measured report is shown as a marker
+// (HID_SCHED_MARKER_ID + instance) in SystemView.
+//
+#ifndef HID_SCHED_USE_SYSVIEW
+  #define HID_SCHED_USE_SYSVIEW  (1)
+#endif
+#ifndef HID_SCHED_MARKER_ID
+  #define HID_SCHED_MARKER_ID    (0x48u)
+#endif
+
+/*********************************************************************
+*
+*       Types, global
+*
+**********************************************************************
+*/
+
+typedef struct {
+  HID_REPORT_QUEUE       * pQueue;
+  USB_SOF_CALLBACK_HOOK    SofHook;
+  unsigned                 IntervalFrames;  // Poll interval of the endpoint in frames.
+  unsigned                 LeadUs;          // Slot time before the start of the poll frame.
+  unsigned                 MarkerId;
+  volatile unsigned        Phase;           // Frames since the last poll, 0: Poll expected in the current frame.
+  volatile U8              IsSlotRequested;
+  volatile U8              IsMeasuring;     // A report is ready and waits for the host.
+  U32                      ReadyCycles;     // DWT cycle counter at HID_SCHED_Put().
+  OS_TASK                * pSlotTask;       // Task signaled at the slot, see HID_SCHED_SetSlotTask().
+  OS_TASKEVENT             SlotEvent;
+  HID_RQ_ON_SENT_FUNC    * pfOnSent;        // Callback of the queue, called after the scheduler's own.
+  void                   * pOnSentContext;
+  U32                      aNumReady2In[HID_SCHED_NUM_BUCKETS];
+} HID_SCHED;
+
+/*********************************************************************
+*
+*       API functions / Function prototypes
+*
+**********************************************************************
+*/
+#if defined(__cplusplus)
+  extern "C" {
+#endif
+
+void HID_SCHED_Init        (HID_SCHED * pSched, HID_REPORT_QUEUE * pQueue, unsigned IntervalUs, unsigned LeadUs);
+void HID_SCHED_SetSlotTask (HID_SCHED * pSched, OS_TASK * pTask, OS_TASKEVENT Event);
+void HID_SCHED_RequestSlot (HID_SCHED * pSched);
+int  HID_SCHED_Put         (HID_SCHED * pSched, const void * pReport);
+void HID_SCHED_Export      (HID_SCHED * pSched, const char * sName);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif  // HID_FRAMESCHED_H
+
+/*************************** End of file ****************************/
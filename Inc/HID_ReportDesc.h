@@ -0,0 +1,173 @@
+/*********************************************************************
+-------------------------- END-OF-HEADER -----------------------------
+File    : HID_ReportDesc.h
+Purpose : Builds HID report descriptor items, a report structure and
+          pack/unpack functions from a single field list.
+
+Additional information:
+  A report is described by a field list macro taking five parameters.
+  Every field is one of
+    BITS (Ctx, Name, Page, UsageMin, UsageMax, LogMin, LogMax, Size, Count, Flags)
+      Count values of Size bits, stored together in one U8 member.
+      Must not cross a byte boundary.
+    BYTES(Ctx, Name, Page, UsageMin, UsageMax, LogMin, LogMax, Count, Flags)
+      Count values of 8 bits, stored in a U8 array member.
+      Must start on a byte boundary.
+    WORDS(Ctx, Name, Page, UsageMin, UsageMax, LogMin, LogMax, Count, Flags)
+      Count values of 16 bits (little endian), stored in a U16 array member.
+      Must start on a byte boundary. The logical range uses 2-byte items.
+    PAD  (Ctx, Name, NumBits)
+      Constant padding, not part of the structure.
+  Example:
+    #define MOUSE_IN_FIELDS(BITS, BYTES, WORDS, PAD, Ctx)                                                                    \
+      BITS (Ctx, Buttons, USB_HID_USAGE_PAGE_BUTTON, 1, 3, 0, 1, 1, 3, USB_HID_VARIABLE)                                  \
+      PAD  (Ctx, Pad0, 5)                                                                                                  \
+      BYTES(Ctx, X, USB_HID_USAGE_PAGE_GENERIC_DESKTOP, USB_HID_USAGE_X, USB_HID_USAGE_X, -127, 127, 1, USB_HID_VARIABLE | USB_HID_RELATIVE)
+
+  From this list
+    HID_REPORT_ITEMS (MOUSE_IN_FIELDS, USB_HID_MAIN_INPUT)    emits the descriptor items,
+    HID_REPORT_STRUCT(MOUSE_IN_FIELDS)                        emits the structure members,
+    HID_REPORT_LAYOUT(MOUSE_IN_FIELDS, MOUSE_IN)              emits the bit offsets and
+                                                              MOUSE_IN_NUM_BYTES, and checks the layout,
+    HID_REPORT_PACK  (MOUSE_IN_FIELDS, MOUSE_IN, _Pack, T)    emits static void _Pack(U8 * pDest, const T * pSrc),
+    HID_REPORT_UNPACK(MOUSE_IN_FIELDS, MOUSE_IN, _Unpack, T)  emits static void _Unpack(T * pDest, const U8 * pSrc).
+  All offsets and counts are compile-time constants, so pack and unpack
+  compile to a fixed sequence of shifts, masks and copies without branches.
+*/
+
+#ifndef HID_REPORTDESC_H
+#define HID_REPORTDESC_H
+
+#include <string.h>
+#include "USB_HID.h"
+
+/*********************************************************************
+*
+*       Descriptor items
+*
+*  Each field emits its global items (usage page, logical range,
+*  report size and count) again, so fields do not depend on each
+*  other. Items use 1 byte of data, except the logical range of WORDS.
+*/
+#define HID_ITEMS_BITS(Main, Name, Page, UsageMin, UsageMax, LogMin, LogMax, Size, Count, Flags)  \
+  USB_HID_GLOBAL_USAGE_PAGE + 1,      (U8)(Page),                                                  \
+  USB_HID_LOCAL_USAGE_MINIMUM + 1,    (U8)(UsageMin),                                              \
+  USB_HID_LOCAL_USAGE_MAXIMUM + 1,    (U8)(UsageMax),                                              \
+  USB_HID_GLOBAL_LOGICAL_MINIMUM + 1, (U8)(LogMin),                                                \
+  USB_HID_GLOBAL_LOGICAL_MAXIMUM + 1, (U8)(LogMax),                                                \
+  USB_HID_GLOBAL_REPORT_SIZE + 1,     (U8)(Size),                                                  \
+  USB_HID_GLOBAL_REPORT_COUNT + 1,    (U8)(Count),                                                 \
+  (Main) + 1,                         (U8)(Flags),
+
+#define HID_ITEMS_BYTES(Main, Name, Page, UsageMin, UsageMax, LogMin, LogMax, Count, Flags)        \
+  HID_ITEMS_BITS(Main, Name, Page, UsageMin, UsageMax, LogMin, LogMax, 8, Count, Flags)
+
+#define HID_ITEMS_WORDS(Main, Name, Page, UsageMin, UsageMax, LogMin, LogMax, Count, Flags)        \
+  USB_HID_GLOBAL_USAGE_PAGE + 1,      (U8)(Page),                                                  \
+  USB_HID_LOCAL_USAGE_MINIMUM + 1,    (U8)(UsageMin),                                              \
+  USB_HID_LOCAL_USAGE_MAXIMUM + 1,    (U8)(UsageMax),                                              \
+  USB_HID_GLOBAL_LOGICAL_MINIMUM + 2, (U8)(LogMin), (U8)((unsigned)(LogMin) >> 8),                 \
+  USB_HID_GLOBAL_LOGICAL_MAXIMUM + 2, (U8)(LogMax), (U8)((unsigned)(LogMax) >> 8),                 \
+  USB_HID_GLOBAL_REPORT_SIZE + 1,     16,                                                          \
+  USB_HID_GLOBAL_REPORT_COUNT + 1,    (U8)(Count),                                                 \
+  (Main) + 1,                         (U8)(Flags),
+
+#define HID_ITEMS_PAD(Main, Name, NumBits)                                                          \
+  USB_HID_GLOBAL_REPORT_SIZE + 1,     (U8)(NumBits),                                               \
+  USB_HID_GLOBAL_REPORT_COUNT + 1,    1,                                                           \
+  (Main) + 1,                         USB_HID_CONSTANT,
+
+#define HID_REPORT_ITEMS(FIELDS, Main)   FIELDS(HID_ITEMS_BITS, HID_ITEMS_BYTES, HID_ITEMS_WORDS, HID_ITEMS_PAD, Main)
+
+/*********************************************************************
+*
+*       Structure members
+*/
+#define HID_STRUCT_BITS(Ctx, Name, Page, UsageMin, UsageMax, LogMin, LogMax, Size, Count, Flags)  U8 Name;
+#define HID_STRUCT_BYTES(Ctx, Name, Page, UsageMin, UsageMax, LogMin, LogMax, Count, Flags)       U8 Name[Count];
+#define HID_STRUCT_WORDS(Ctx, Name, Page, UsageMin, UsageMax, LogMin, LogMax, Count, Flags)       U16 Name[Count];
+#define HID_STRUCT_PAD(Ctx, Name, NumBits)
+
+#define HID_REPORT_STRUCT(FIELDS)        FIELDS(HID_STRUCT_BITS, HID_STRUCT_BYTES, HID_STRUCT_WORDS, HID_STRUCT_PAD, _)
+
+/*********************************************************************
+*
+*       Layout
+*
+*  Consecutive enumerators give each field its first bit (<Prefix>_<Name>_OFF).
+*  The next field starts after <Prefix>_<Name>_LAST.
+*/
+#define HID_OFFS_BITS(Prefix, Name, Page, UsageMin, UsageMax, LogMin, LogMax, Size, Count, Flags)  \
+  Prefix##_##Name##_OFF, Prefix##_##Name##_LAST = Prefix##_##Name##_OFF + (Size) * (Count) - 1,
+#define HID_OFFS_BYTES(Prefix, Name, Page, UsageMin, UsageMax, LogMin, LogMax, Count, Flags)       \
+  Prefix##_##Name##_OFF, Prefix##_##Name##_LAST = Prefix##_##Name##_OFF + 8 * (Count) - 1,
+#define HID_OFFS_WORDS(Prefix, Name, Page, UsageMin, UsageMax, LogMin, LogMax, Count, Flags)       \
+  Prefix##_##Name##_OFF, Prefix##_##Name##_LAST = Prefix##_##Name##_OFF + 16 * (Count) - 1,
+#define HID_OFFS_PAD(Prefix, Name, NumBits)                                                         \
+  Prefix##_##Name##_OFF, Prefix##_##Name##_LAST = Prefix##_##Name##_OFF + (NumBits) - 1,
+
+#define HID_CHECK_RANGE(Name, LogMin, LogMax)                                                       \
+  _Static_assert(((LogMin) >= -128) && ((LogMax) <= 127) && ((LogMin) <= (LogMax)), #Name ": logical range must fit into 1 byte");
+#define HID_CHECK_BITS(Prefix, Name, Page, UsageMin, UsageMax, LogMin, LogMax, Size, Count, Flags) \
+  _Static_assert(((Prefix##_##Name##_OFF % 8) + (Size) * (Count)) <= 8, #Name ": bit field must not cross a byte boundary");   \
+  HID_CHECK_RANGE(Name, LogMin, LogMax)
+#define HID_CHECK_BYTES(Prefix, Name, Page, UsageMin, UsageMax, LogMin, LogMax, Count, Flags)      \
+  _Static_assert((Prefix##_##Name##_OFF % 8) == 0, #Name ": byte field must start on a byte boundary");                       \
+  HID_CHECK_RANGE(Name, LogMin, LogMax)
+#define HID_CHECK_WORDS(Prefix, Name, Page, UsageMin, UsageMax, LogMin, LogMax, Count, Flags)      \
+  _Static_assert((Prefix##_##Name##_OFF % 8) == 0, #Name ": word field must start on a byte boundary");                       \
+  _Static_assert(((LogMin) >= -32768) && ((LogMax) <= 32767) && ((LogMin) <= (LogMax)), #Name ": logical range must fit into 2 bytes");
+#define HID_CHECK_PAD(Prefix, Name, NumBits)
+
+#define HID_REPORT_LAYOUT(FIELDS, Prefix)                                                           \
+  enum {                                                                                            \
+    FIELDS(HID_OFFS_BITS, HID_OFFS_BYTES, HID_OFFS_WORDS, HID_OFFS_PAD, Prefix)                     \
+    Prefix##_NUM_BITS,                                                                              \
+    Prefix##_NUM_BYTES = Prefix##_NUM_BITS / 8                                                      \
+  };                                                                                                \
+  _Static_assert((Prefix##_NUM_BITS % 8) == 0, #Prefix ": report must be a multiple of 8 bits");   \
+  FIELDS(HID_CHECK_BITS, HID_CHECK_BYTES, HID_CHECK_WORDS, HID_CHECK_PAD, Prefix)
+
+/*********************************************************************
+*
+*       Pack / unpack
+*
+*  The generated functions work on pDest and pSrc.
+*/
+#define HID_MASK(NumBits)                ((1u << (NumBits)) - 1u)
+
+#define HID_PACK_BITS(Prefix, Name, Page, UsageMin, UsageMax, LogMin, LogMax, Size, Count, Flags)  \
+  pDest[Prefix##_##Name##_OFF / 8] |= (U8)((pSrc->Name & HID_MASK((Size) * (Count))) << (Prefix##_##Name##_OFF % 8));
+#define HID_PACK_BYTES(Prefix, Name, Page, UsageMin, UsageMax, LogMin, LogMax, Count, Flags)       \
+  memcpy(&pDest[Prefix##_##Name##_OFF / 8], pSrc->Name, (Count));
+#define HID_PACK_WORDS(Prefix, Name, Page, UsageMin, UsageMax, LogMin, LogMax, Count, Flags)       \
+  { unsigned i; for (i = 0; i < (Count); i++) {                                                     \
+      pDest[Prefix##_##Name##_OFF / 8 + 2 * i]     = (U8)pSrc->Name[i];                             \
+      pDest[Prefix##_##Name##_OFF / 8 + 2 * i + 1] = (U8)(pSrc->Name[i] >> 8);                      \
+  } }
+#define HID_PACK_PAD(Prefix, Name, NumBits)
+
+#define HID_UNPACK_BITS(Prefix, Name, Page, UsageMin, UsageMax, LogMin, LogMax, Size, Count, Flags) \
+  pDest->Name = (U8)((pSrc[Prefix##_##Name##_OFF / 8] >> (Prefix##_##Name##_OFF % 8)) & HID_MASK((Size) * (Count)));
+#define HID_UNPACK_BYTES(Prefix, Name, Page, UsageMin, UsageMax, LogMin, LogMax, Count, Flags)     \
+  memcpy(pDest->Name, &pSrc[Prefix##_##Name##_OFF / 8], (Count));
+#define HID_UNPACK_WORDS(Prefix, Name, Page, UsageMin, UsageMax, LogMin, LogMax, Count, Flags)     \
+  { unsigned i; for (i = 0; i < (Count); i++) {                                                     \
+      pDest->Name[i] = (U16)(pSrc[Prefix##_##Name##_OFF / 8 + 2 * i] | (pSrc[Prefix##_##Name##_OFF / 8 + 2 * i + 1] << 8)); \
+  } }
+#define HID_UNPACK_PAD(Prefix, Name, NumBits)
+
+#define HID_REPORT_PACK(FIELDS, Prefix, Func, Type)                                                 \
+  static void Func(U8 * pDest, const Type * pSrc) {                                                 \
+    memset(pDest, 0, Prefix##_NUM_BYTES);                                                           \
+    FIELDS(HID_PACK_BITS, HID_PACK_BYTES, HID_PACK_WORDS, HID_PACK_PAD, Prefix)                     \
+  }
+
+#define HID_REPORT_UNPACK(FIELDS, Prefix, Func, Type)                                               \
+  static void Func(Type * pDest, const U8 * pSrc) {                                                 \
+    FIELDS(HID_UNPACK_BITS, HID_UNPACK_BYTES, HID_UNPACK_WORDS, HID_UNPACK_PAD, Prefix)             \
+  }
+
+#endif  // HID_REPORTDESC_H
+
+/*************************** End of file ****************************/
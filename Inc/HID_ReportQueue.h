@@ -0,0 +1,85 @@
+/*********************************************************************
+-------------------------- END-OF-HEADER -----------------------------
+File    : HID_ReportQueue.h
+Purpose : Non-blocking queue of HID input reports for an interrupt
+          IN endpoint.
+*/
+
+#ifndef HID_REPORTQUEUE_H
+#define HID_REPORTQUEUE_H
+
+#include "USB.h"
+
+/*********************************************************************
+*
+*       Types, global
+*
+**********************************************************************
+*/
+
+//
+// Tries to merge a new report into the last queued report which has
+// not been handed to the USB stack yet.
+// Returns 1 if pNew has been merged into pQueued, 0 otherwise.
+//
+typedef int  HID_RQ_COALESCE_FUNC(U8 * pQueued, const U8 * pNew, unsigned NumBytes);
+
+//
+// Called from the USB interrupt after a report has been sent (Status == 0)
+// or the queue has been flushed because of a failed transfer (Status < 0).
+//
+typedef void HID_RQ_ON_SENT_FUNC(void * pContext, int Status);
+
+typedef struct {
+  U32 NumQueued;        // Reports accepted by HID_RQ_Put() into a free slot.
+  U32 NumCoalesced;     // Reports merged into an already queued report.
+  U32 NumDropped;       // Reports lost because the queue was full or a transfer failed.
+  U32 NumSent;          // Reports successfully transferred to the host.
+  U32 MaxDepth;         // Highest number of reports in the queue, including the one in flight.
+} HID_RQ_STATS;
+
+typedef struct {
+  USB_ASYNC_IO_CONTEXT   AsyncContext;
+  U8                   * pBuffer;       // NumReports * ReportSize bytes.
+  unsigned               ReportSize;
+  unsigned               NumReports;
+  unsigned               EPIndex;       // Interrupt IN endpoint returned by USBD_AddEPEx().
+  unsigned               RdIndex;       // Slot of the report in flight or next to send.
+  unsigned               WrIndex;       // Next free slot.
+  volatile unsigned      Depth;         // Number of occupied slots, including the one in flight.
+  volatile U8            IsBusy;        // A transfer of the slot at RdIndex is in progress.
+  U32                    QueuedSeq;     // Sequence number of the newest report in a slot, counts from 1.
+  volatile U32           SentSeq;       // Sequence number of the last report fetched by the host.
+  HID_RQ_COALESCE_FUNC * pfCoalesce;
+  HID_RQ_ON_SENT_FUNC  * pfOnSent;
+  void                 * pOnSentContext;
+  HID_RQ_STATS           Stats;
+} HID_REPORT_QUEUE;
+
+/*********************************************************************
+*
+*       API functions / Function prototypes
+*
+**********************************************************************
+*/
+#if defined(__cplusplus)
+  extern "C" {
+#endif
+
+void     HID_RQ_Init            (HID_REPORT_QUEUE * pQueue, unsigned EPIndex, U8 * pBuffer, unsigned ReportSize, unsigned NumReports);
+void     HID_RQ_SetCoalesceFunc (HID_REPORT_QUEUE * pQueue, HID_RQ_COALESCE_FUNC * pf);
+void     HID_RQ_SetOnSent       (HID_REPORT_QUEUE * pQueue, HID_RQ_ON_SENT_FUNC * pf, void * pContext);
+int      HID_RQ_Put             (HID_REPORT_QUEUE * pQueue, const void * pReport);
+unsigned HID_RQ_GetDepth        (const HID_REPORT_QUEUE * pQueue);
+unsigned HID_RQ_GetNumFree      (const HID_REPORT_QUEUE * pQueue);
+void     HID_RQ_GetStats        (const HID_REPORT_QUEUE * pQueue, HID_RQ_STATS * pStats);
+U32      HID_RQ_GetQueuedSeq    (const HID_REPORT_QUEUE * pQueue);
+U32      HID_RQ_GetSentSeq      (const HID_REPORT_QUEUE * pQueue);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif  // HID_REPORTQUEUE_H
+
+/*************************** End of file ****************************/
@@ -0,0 +1,75 @@
+/*********************************************************************
+-------------------------- END-OF-HEADER -----------------------------
+File    : KeyEventRing.h
+Purpose : Lock-free single-producer/single-consumer ring of key events.
+*/
+
+#ifndef KEYEVENTRING_H
+#define KEYEVENTRING_H
+
+/*********************************************************************
+*
+*       Defines, configurable
+*
+**********************************************************************
+*/
+
+//
+// Memory barrier between writing an event and publishing the position
+// (DMB on Cortex-M). Plain C otherwise, so the ring builds on a host.
+//
+#ifndef KEY_RING_BARRIER
+  #if defined(__GNUC__)
+    #define KEY_RING_BARRIER()  __atomic_thread_fence(__ATOMIC_SEQ_CST)
+  #else
+    #error "KEY_RING_BARRIER() has to be defined for this compiler"
+  #endif
+#endif
+
+/*********************************************************************
+*
+*       Types, global
+*
+**********************************************************************
+*/
+
+typedef struct {
+  unsigned long TimeStamp;      // DWT cycle counter at the first edge of the key press or release.
+  unsigned char KeyIndex;       // BSP_KEY_S, BSP_KEY_T, BSP_KEY_M or a matrix key.
+  unsigned char IsPressed;      // 1: Key pressed, 0: Key released.
+} KEY_EVENT;
+
+//
+// WrPos is only written by the producer, RdPos only by the consumer.
+// Both are free running, the slot is selected by masking with NumEvents.
+//
+typedef struct {
+  KEY_EVENT *       paEvent;
+  unsigned          NumEvents;  // Power of 2.
+  volatile unsigned WrPos;
+  volatile unsigned RdPos;
+  volatile unsigned NumDropped; // Events lost because the ring was full.
+} KEY_RING;
+
+/*********************************************************************
+*
+*       API functions / Function prototypes
+*
+**********************************************************************
+*/
+#if defined(__cplusplus)
+  extern "C" {
+#endif
+
+void     KEY_RING_Init          (KEY_RING * pRing, KEY_EVENT * paEvent, unsigned NumEvents);
+int      KEY_RING_Put           (KEY_RING * pRing, const KEY_EVENT * pEvent);
+int      KEY_RING_Get           (KEY_RING * pRing, KEY_EVENT * pEvent);
+unsigned KEY_RING_GetNumDropped (const KEY_RING * pRing);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif  // KEYEVENTRING_H
+
+/*************************** End of file ****************************/
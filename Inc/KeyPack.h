@@ -0,0 +1,61 @@
+/*********************************************************************
+-------------------------- END-OF-HEADER -----------------------------
+File    : KeyPack.h
+Purpose : Turns text into boot keyboard reports.
+*/
+
+#ifndef KEYPACK_H
+#define KEYPACK_H
+
+/*********************************************************************
+*
+*       Defines, fixed
+*
+**********************************************************************
+*/
+
+//
+// Key array slots of the boot keyboard report.
+//
+#define KEY_PACK_NUM_SLOTS   6u
+
+/*********************************************************************
+*
+*       Types, global
+*
+**********************************************************************
+*/
+
+//
+// Sends one report: modifier byte and NumKeys usage IDs (0..KEY_PACK_NUM_SLOTS).
+//
+typedef void KEY_PACK_SEND_FUNC(void * pContext, unsigned char Modifier, const unsigned char * pKeys, unsigned NumKeys);
+
+typedef struct {
+  KEY_PACK_SEND_FUNC * pfSend;
+  void *               pContext;
+  unsigned             KeysPerReport;
+  unsigned             NumLastKeys;
+  unsigned char        abLastKeys[KEY_PACK_NUM_SLOTS];       // Keys of the last report sent.
+} KEY_PACK;
+
+/*********************************************************************
+*
+*       API functions / Function prototypes
+*
+**********************************************************************
+*/
+#if defined(__cplusplus)
+  extern "C" {
+#endif
+
+void     KEY_PACK_Init   (KEY_PACK * pPack, unsigned KeysPerReport, KEY_PACK_SEND_FUNC * pfSend, void * pContext);
+unsigned KEY_PACK_Output (KEY_PACK * pPack, const char * sString);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif  // KEYPACK_H
+
+/*************************** End of file ****************************/
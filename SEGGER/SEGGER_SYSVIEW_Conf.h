@@ -63,6 +63,7 @@ extern uint32_t SystemCoreClock;
 #define SEGGER_SYSVIEW_TIMESTAMP_FREQ  SystemCoreClock
 #define SEGGER_SYSVIEW_CPU_FREQ        SystemCoreClock
 #define SEGGER_SYSVIEW_SYSDESC0        "I#15=SysTick"
+#define SEGGER_SYSVIEW_SYSDESC1        "I#56=EXTI15_10,I#71=TIM7,I#83=OTG_FS"
 
 #endif  // SEGGER_SYSVIEW_CONF_H
 
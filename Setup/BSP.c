@@ -32,6 +32,7 @@ Purpose : BSP for the Olimex STM32P407 eval board
 */
 
 #include "BSP.h"
+#include "BSP_TIMER.h"
 #include "stm32f4xx.h"
 
 /*********************************************************************
@@ -88,21 +89,21 @@ void BSP_Init(void) {
   RCC_LEDPORT_ENR  &= ~(1uL << RCC_LEDPORT_BIT);
   RCC_LEDPORT_RSTR &= ~(1uL << RCC_LEDPORT_BIT);
   RCC_LEDPORT_ENR  |=  (1uL << RCC_LEDPORT_BIT);
-  RCC->APB2ENR |= RCC_APB2ENR_SYSCFGEN;
-  SYSCFG->EXTICR[2] |= SYSCFG_EXTICR3_EXTI10_PE|SYSCFG_EXTICR3_EXTI11_PE;
-  SYSCFG->EXTICR[3] |= SYSCFG_EXTICR4_EXTI12_PE;
 
   LED_PORT_MODER &= ~(3uL << (LED0_BIT * 2)) | (3uL << (LED1_BIT * 2))| (3uL << (KEYS_BIT * 2))| (3uL << (KEYT_BIT * 2))| (3uL << (KEYM_BIT * 2));   // Reset mode; sets port to input
   LED_PORT_MODER |=  (1uL << (LED0_BIT * 2)) | (1uL << (LED1_BIT * 2));   // Set to output mode
   LED_PORT_BSRR   =  (0x10000uL << LED0_BIT) | (0x10000uL << LED1_BIT);   // Initially clear LEDs
 
-  //Initialize port for Keys
-  EXTI->PR |= EXTI_PR_PR10|EXTI_PR_PR11|EXTI_PR_PR12;
-  EXTI->FTSR |= EXTI_FTSR_TR10|EXTI_FTSR_TR11|EXTI_FTSR_TR12;
-  EXTI->IMR |= EXTI_IMR_MR10|EXTI_IMR_MR11|EXTI_IMR_MR12;
-  //Interrupt NVIC Enable
-  NVIC_EnableIRQ(EXTI15_10_IRQn);
-;
+  //EXTI and debouncing of the keys are initialized by BSP_KEY_Init()
+  //
+  // Enable the DWT cycle counter, used to time stamp key events
+  //
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL        |= DWT_CTRL_CYCCNTENA_Msk;
+  //
+  // Microsecond one-shot timers, used for the timeouts of the USB stack
+  //
+  BSP_TIMER_Init();
 }
 
 /*********************************************************************
@@ -0,0 +1,192 @@
+/*********************************************************************
+-------------------------- END-OF-HEADER -----------------------------
+File    : BSP_BOOT.c
+Purpose : Boot time line from reset until the USB device is configured
+
+Additional information:
+
+  BSP_BOOT_Start() is the first statement of SystemInit(). It enables
+  the DWT cycle counter and sets it to 0, so all milestones are cycles
+  since reset (plus the few instructions of Reset_Handler).
+
+  SystemInit() runs before the C runtime initializes .data and .bss.
+  The time line is therefore kept in the .non_init section, which is
+  not touched by the runtime. This also keeps it across a warm reset,
+  a magic value tells a valid record from random RAM content after
+  power-on and a boot counter tells resets apart.
+
+  The core runs from the 16 MHz HSI until SetSysClock() has switched
+  to the PLL, the cycles up to BSP_BOOT_CLOCK_READY are converted
+  with HSI_VALUE, all later ones with SystemCoreClock.
+
+  BSP_BOOT_Mark() only records the first time a milestone is reached
+  and may be called from tasks and interrupts.
+*/
+
+#include "BSP_BOOT.h"
+#include "SEGGER_RTT.h"
+#if BSP_BOOT_USE_SYSVIEW
+  #include "SEGGER_SYSVIEW.h"
+#endif
+#include "stm32f4xx.h"   // Device specific header file, contains CMSIS defines.
+
+/*********************************************************************
+*
+*       Defines
+*
+**********************************************************************
+*/
+
+#define BOOT_MAGIC  (0x424F4F54uL)   // "BOOT"
+
+/*********************************************************************
+*
+*       Types, local
+*
+**********************************************************************
+*/
+
+typedef struct {
+  unsigned long Magic;
+  unsigned long NumBoots;                          // Resets since power-on, including this one.
+  unsigned long MarkedMask;                        // Bit n set: Milestone n has been reached.
+  unsigned long aCycles[BSP_BOOT_NUM_MILESTONES];  // DWT cycle counter per milestone.
+} BOOT_TIMELINE;
+
+/*********************************************************************
+*
+*       Static data
+*
+**********************************************************************
+*/
+
+static BOOT_TIMELINE _Timeline __attribute__ ((section (".non_init")));
+
+static const char * const _asName[BSP_BOOT_NUM_MILESTONES] = {
+  "SystemInit",
+  "Clock ready",
+  "main",
+  "OS_InitHW done",
+  "BSP_Init done",
+  "MainTask",
+  "USBD_X_Config",
+  "USBD_X_Config done",
+  "USBD_Start",
+  "USB addressed",
+  "USB configured"
+};
+
+/*********************************************************************
+*
+*       Global functions
+*
+**********************************************************************
+*/
+
+/*********************************************************************
+*
+*       BSP_BOOT_Start()
+*
+*  Function description
+*    Starts the time line. Must be the first call in SystemInit().
+*/
+void BSP_BOOT_Start(void) {
+  unsigned int i;
+
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT       = 0;
+  DWT->CTRL        |= DWT_CTRL_CYCCNTENA_Msk;
+  if (_Timeline.Magic != BOOT_MAGIC) {
+    _Timeline.Magic    = BOOT_MAGIC;
+    _Timeline.NumBoots = 0;
+  }
+  _Timeline.NumBoots++;
+  for (i = 0; i < BSP_BOOT_NUM_MILESTONES; i++) {
+    _Timeline.aCycles[i] = 0;
+  }
+  _Timeline.MarkedMask = (1uL << BSP_BOOT_SYSTEM_INIT);
+}
+
+/*********************************************************************
+*
+*       BSP_BOOT_Mark()
+*
+*  Function description
+*    Records the cycle counter for a milestone, see BSP_BOOT_* in BSP_BOOT.h.
+*
+*  Additional information
+*    Tasks and the USB interrupt mark milestones. The test and update
+*    of MarkedMask is a read-modify-write and runs with all interrupts
+*    disabled (PRIMASK), so no mark of a preempting caller is lost.
+*    PRIMASK also works in SystemInit(), before embOS is initialized.
+*/
+void BSP_BOOT_Mark(unsigned int Milestone) {
+  unsigned long Mask;
+  uint32_t      PriMask;
+
+  if (Milestone < BSP_BOOT_NUM_MILESTONES) {
+    Mask    = 1uL << Milestone;
+    PriMask = __get_PRIMASK();
+    __disable_irq();
+    if ((_Timeline.MarkedMask & Mask) == 0u) {
+      _Timeline.aCycles[Milestone] = DWT->CYCCNT;
+      _Timeline.MarkedMask        |= Mask;
+    }
+    __set_PRIMASK(PriMask);
+  }
+}
+
+/*********************************************************************
+*
+*       BSP_BOOT_GetTimeUs()
+*
+*  Function description
+*    Returns the time of a milestone since reset.
+*
+*  Return value
+*    Time in microseconds, 0 if the milestone has not been reached.
+*/
+unsigned long BSP_BOOT_GetTimeUs(unsigned int Milestone) {
+  unsigned long Cycles;
+  unsigned long ClockReadyCycles;
+
+  if ((Milestone >= BSP_BOOT_NUM_MILESTONES) || ((_Timeline.MarkedMask & (1uL << Milestone)) == 0u)) {
+    return 0;
+  }
+  Cycles = _Timeline.aCycles[Milestone];
+  if ((Milestone <= BSP_BOOT_CLOCK_READY) || ((_Timeline.MarkedMask & (1uL << BSP_BOOT_CLOCK_READY)) == 0u)) {
+    return Cycles / (HSI_VALUE / 1000000u);
+  }
+  ClockReadyCycles = _Timeline.aCycles[BSP_BOOT_CLOCK_READY];
+  return ClockReadyCycles / (HSI_VALUE / 1000000u) + (Cycles - ClockReadyCycles) / (SystemCoreClock / 1000000u);
+}
+
+/*********************************************************************
+*
+*       BSP_BOOT_Print()
+*
+*  Function description
+*    Prints the time line via RTT (and SystemView, if enabled).
+*    Milestones not reached yet are skipped.
+*/
+void BSP_BOOT_Print(void) {
+  unsigned int  i;
+  unsigned long Us;
+  unsigned long PrevUs;
+
+  SEGGER_RTT_printf(0, "Boot #%u time line [us]:\n", (unsigned)_Timeline.NumBoots);
+  PrevUs = 0;
+  for (i = 0; i < BSP_BOOT_NUM_MILESTONES; i++) {
+    if ((_Timeline.MarkedMask & (1uL << i)) == 0u) {
+      continue;
+    }
+    Us = BSP_BOOT_GetTimeUs(i);
+    SEGGER_RTT_printf(0, "  %8u (+%6u)  %s\n", (unsigned)Us, (unsigned)(Us - PrevUs), _asName[i]);
+#if BSP_BOOT_USE_SYSVIEW
+    SEGGER_SYSVIEW_PrintfTarget("Boot %s: %u us (+%u)", _asName[i], (unsigned)Us, (unsigned)(Us - PrevUs));
+#endif
+    PrevUs = Us;
+  }
+}
+
+/*************************** End of file ****************************/
@@ -0,0 +1,93 @@
+/*********************************************************************
+-------------------------- END-OF-HEADER -----------------------------
+File    : BSP_DEBOUNCE.c
+Purpose : Debounce state machine of a single key
+
+Additional information:
+
+  The state machine has no hardware dependencies. BSP_KEY.c feeds it
+  with the pin level sampled once per period, the host test in Host/
+  with synthetic and recorded bounce waveforms.
+
+  A key starts in the released state and is idle, i.e. not sampled.
+  The first falling edge (BSP_DEBOUNCE_OnEdge()) records the time of
+  the press. From then on, BSP_DEBOUNCE_Step() is called once per
+  sample. A change is reported once the level has been the same for
+  DebounceCnt + 1 samples, with the time at which the level first left
+  the previous stable state, bounces included. The key becomes idle
+  again once it is stable released.
+*/
+
+#include "BSP_DEBOUNCE.h"
+
+/*********************************************************************
+*
+*       Global functions
+*
+**********************************************************************
+*/
+
+/*********************************************************************
+*
+*       BSP_DEBOUNCE_OnEdge()
+*
+*  Function description
+*    Starts debouncing an idle key on its first press edge.
+*
+*  Parameters
+*    pState: Key state.
+*    Time  : Time of the edge, e.g. DWT cycle counter.
+*/
+void BSP_DEBOUNCE_OnEdge(BSP_DEBOUNCE_STATE* pState, unsigned long Time) {
+  pState->TimeStamp = Time;
+  pState->LastLevel = 1u;           // Falling edge: key went down.
+  pState->StableCnt = 0;
+}
+
+/*********************************************************************
+*
+*       BSP_DEBOUNCE_Step()
+*
+*  Function description
+*    Processes one sample of a key being debounced.
+*
+*  Parameters
+*    pState     : Key state.
+*    Level      : Sampled level, 1: pressed.
+*    Time       : Time of the sample.
+*    DebounceCnt: Number of samples the level must stay unchanged.
+*
+*  Return value
+*    Combination of BSP_DEBOUNCE_CHANGED and BSP_DEBOUNCE_IDLE.
+*/
+unsigned int BSP_DEBOUNCE_Step(BSP_DEBOUNCE_STATE* pState, unsigned int Level, unsigned long Time, unsigned int DebounceCnt) {
+  unsigned int r;
+
+  if (Level != pState->LastLevel) {
+    //
+    // Level leaves the stable state. A bounce back to the stable level
+    // which does not last the debounce time keeps the first time.
+    //
+    if ((pState->LastLevel == pState->IsPressed) && (pState->StableCnt >= DebounceCnt)) {
+      pState->TimeStamp = Time;
+    }
+    pState->LastLevel = (unsigned char)Level;
+    pState->StableCnt = 0;
+    return 0;
+  }
+  if (pState->StableCnt < DebounceCnt) {
+    pState->StableCnt++;
+    return 0;
+  }
+  r = 0;
+  if (Level != pState->IsPressed) {
+    pState->IsPressed = (unsigned char)Level;
+    r |= BSP_DEBOUNCE_CHANGED;
+  }
+  if (pState->IsPressed == 0u) {
+    r |= BSP_DEBOUNCE_IDLE;
+  }
+  return r;
+}
+
+/*************************** End of file ****************************/
@@ -0,0 +1,392 @@
+/*********************************************************************
+-------------------------- END-OF-HEADER -----------------------------
+File    : BSP_IRQ.c
+Purpose : IRQ entry latency test
+
+Additional information:
+
+  The interrupt priorities of the project are defined in BSP_IRQ.h.
+  With BSP_IRQ_MEASURE_LATENCY, each handler records the DWT cycle
+  counter first thing via BSP_IRQ_ENTER(). BSP_IRQ_TestLatency() then
+  raises the interrupt at a known time and returns the cycles until
+  the handler was entered:
+
+  - Interrupts whose handler returns without a flag set are pended by
+    software (EXTI15_10, TIM2, USART3, OTG_FS).
+  - SysTick can not be pended without an extra OS tick. The test waits
+    for the next reload, which happens when the down counter reaches 0.
+  - TIM7 scans the next key matrix row on every entry. The test waits
+    for the next update event, derived from the 1 MHz counter.
+
+  The result includes the time the interrupt waits for handlers of the
+  same or a higher priority and for embOS critical sections, so the
+  test shows the effect of the priority plan when run under load.
+  It must be called from a task.
+
+  A test from a task never runs inside a critical section of another
+  task. BSP_IRQ_StartProbe() therefore pends one interrupt from TIM6,
+  a zero latency interrupt which preempts every critical section, at
+  pseudo-random times and records the max. entry latency. Run with
+  the application under load, this covers the critical sections of the
+  USB stack: With USBD_OS_USE_USBD_X_INTERRUPT == 0 they mask all embOS
+  interrupts and show up in the USART3 latency, with 1 only OTG_FS.
+*/
+
+#include "BSP_IRQ.h"
+#include "RTOS.h"
+#include "SEGGER_RTT.h"
+#include "stm32f4xx.h"   // Device specific header file, contains CMSIS defines.
+
+/*********************************************************************
+*
+*       Compile time checks
+*
+**********************************************************************
+*/
+
+#if (BSP_IRQ_PRIO_BITS != __NVIC_PRIO_BITS)
+  #error "BSP_IRQ_PRIO_BITS does not match the device"
+#endif
+#if (BSP_IRQ_PRIO_8BIT(BSP_IRQ_PRIO_EMBOS_MIN) < OS_IPL_THRESHOLD)
+  #error "BSP_IRQ_PRIO_EMBOS_MIN is a zero latency level"
+#endif
+
+#if BSP_IRQ_MEASURE_LATENCY
+
+/*********************************************************************
+*
+*       Defines
+*
+**********************************************************************
+*/
+
+#define TRIGGER_PEND      (0u)   // Pended by software.
+#define TRIGGER_SYSTICK   (1u)   // Next SysTick reload.
+#define TRIGGER_TIM7      (2u)   // Next TIM7 update event.
+
+#define SYSTICK_MARGIN    (200u) // Min. cycles until the reload, the test needs some to start.
+
+#define PROBE_TIMER_CLOCK (SystemCoreClock / 2u)   // APB1 timer clock (APB1 prescaler 4)
+
+/*********************************************************************
+*
+*       Types, local
+*
+**********************************************************************
+*/
+
+typedef struct {
+  IRQn_Type    IRQn;
+  unsigned int Prio;
+  unsigned int Trigger;
+  const char * sName;
+} IRQ_INFO;
+
+/*********************************************************************
+*
+*       Static data
+*
+**********************************************************************
+*/
+
+static const IRQ_INFO _aIRQ[BSP_IRQ_NUM_IDS] = {
+  { SysTick_IRQn,   BSP_IRQ_PRIO_SYSTICK,    TRIGGER_SYSTICK, "SysTick"           },
+  { EXTI15_10_IRQn, BSP_IRQ_PRIO_KEY_EXTI,   TRIGGER_PEND,    "EXTI15_10 (keys)"  },
+  { TIM7_IRQn,      BSP_IRQ_PRIO_KEY_MATRIX, TRIGGER_TIM7,    "TIM7 (key matrix)" },
+  { TIM2_IRQn,      BSP_IRQ_PRIO_TIMER,      TRIGGER_PEND,    "TIM2 (timers)"     },
+  { USART3_IRQn,    BSP_IRQ_PRIO_UART,       TRIGGER_PEND,    "USART3 (embOSView)"},
+  { OTG_FS_IRQn,    BSP_IRQ_PRIO_USB,        TRIGGER_PEND,    "OTG_FS (USB)"      }
+};
+
+static volatile unsigned long _aEntryCycles[BSP_IRQ_NUM_IDS];  // DWT cycle counter at the last entry.
+static volatile unsigned long _aNumEntries[BSP_IRQ_NUM_IDS];
+static unsigned long          _aMaxLatency[BSP_IRQ_NUM_IDS];   // Max. result of BSP_IRQ_TestLatency().
+
+static volatile unsigned int  _ProbeId = BSP_IRQ_NUM_IDS;      // Interrupt pended by the probe, BSP_IRQ_NUM_IDS: none.
+static volatile unsigned char _IsProbePending;
+static volatile unsigned long _ProbeStartCycles;
+static unsigned int           _ProbePeriodUs;
+static unsigned int           _ProbeSeed = 1u;
+static volatile unsigned long _aProbeMax[BSP_IRQ_NUM_IDS];     // Max. entry latency seen by the probe.
+static volatile unsigned long _aProbeNum[BSP_IRQ_NUM_IDS];
+
+/*********************************************************************
+*
+*       Prototypes
+*
+**********************************************************************
+*/
+
+void TIM6_DAC_IRQHandler(void);
+
+/*********************************************************************
+*
+*       Local functions
+*
+**********************************************************************
+*/
+
+/*********************************************************************
+*
+*       _WaitEntry()
+*
+*  Function description
+*    Waits until the handler has been entered after NumEntries entries.
+*/
+static void _WaitEntry(unsigned int Id, unsigned long NumEntries) {
+  while (_aNumEntries[Id] == NumEntries) {
+  }
+}
+
+/*********************************************************************
+*
+*       _TestPend()
+*/
+static long _TestPend(unsigned int Id) {
+  unsigned long NumEntries;
+  unsigned long Start;
+
+  if (NVIC_GetEnableIRQ(_aIRQ[Id].IRQn) == 0u) {
+    return -1;
+  }
+  NumEntries = _aNumEntries[Id];
+  Start      = DWT->CYCCNT;
+  NVIC_SetPendingIRQ(_aIRQ[Id].IRQn);
+  _WaitEntry(Id, NumEntries);
+  return (long)(_aEntryCycles[Id] - Start);
+}
+
+/*********************************************************************
+*
+*       _TestSysTick()
+*
+*  Function description
+*    The SysTick counter runs with the core clock, the reload is
+*    exactly Value cycles ahead.
+*/
+static long _TestSysTick(void) {
+  unsigned long NumEntries;
+  unsigned long Start;
+  unsigned long Value;
+
+  do {
+    OS_INT_IncDI();
+    Value      = SysTick->VAL;
+    Start      = DWT->CYCCNT;
+    NumEntries = _aNumEntries[BSP_IRQ_ID_SYSTICK];
+    OS_INT_DecRI();
+  } while (Value < SYSTICK_MARGIN);
+  _WaitEntry(BSP_IRQ_ID_SYSTICK, NumEntries);
+  return (long)(_aEntryCycles[BSP_IRQ_ID_SYSTICK] - Start - Value);
+}
+
+/*********************************************************************
+*
+*       _TestTIM7()
+*
+*  Function description
+*    TIM7 counts microseconds from 0 to ARR. The test starts right
+*    after the counter has changed, the update event is then
+*    ARR - CNT + 1 microseconds ahead.
+*/
+static long _TestTIM7(void) {
+  unsigned long NumEntries;
+  unsigned long Start;
+  unsigned long Count;
+
+  if ((NVIC_GetEnableIRQ(TIM7_IRQn) == 0u) || ((TIM7->CR1 & TIM_CR1_CEN) == 0u)) {
+    return -1;
+  }
+  do {
+    Count = TIM7->CNT;
+    while (TIM7->CNT == Count) {
+    }
+    OS_INT_IncDI();
+    Start      = DWT->CYCCNT;
+    Count      = TIM7->CNT;
+    NumEntries = _aNumEntries[BSP_IRQ_ID_KEY_MATRIX];
+    OS_INT_DecRI();
+  } while (Count >= TIM7->ARR);        // Too close to the update event.
+  _WaitEntry(BSP_IRQ_ID_KEY_MATRIX, NumEntries);
+  return (long)(_aEntryCycles[BSP_IRQ_ID_KEY_MATRIX] - Start) - (long)((TIM7->ARR - Count + 1u) * (SystemCoreClock / 1000000u));
+}
+
+/*********************************************************************
+*
+*       Global functions
+*
+**********************************************************************
+*/
+
+/*********************************************************************
+*
+*       BSP_IRQ_OnEnter()
+*
+*  Function description
+*    Records the entry of a handler, called via BSP_IRQ_ENTER().
+*/
+void BSP_IRQ_OnEnter(unsigned int Id) {
+  unsigned long Cycles;
+
+  Cycles            = DWT->CYCCNT;
+  _aEntryCycles[Id] = Cycles;
+  _aNumEntries[Id]++;
+  if ((Id == _ProbeId) && (_IsProbePending != 0u)) {
+    Cycles -= _ProbeStartCycles;
+    if (Cycles > _aProbeMax[Id]) {
+      _aProbeMax[Id] = Cycles;
+    }
+    _aProbeNum[Id]++;
+    _IsProbePending = 0;
+  }
+}
+
+/*********************************************************************
+*
+*       BSP_IRQ_StartProbe()
+*
+*  Function description
+*    Starts pending an interrupt from TIM6 at pseudo-random intervals
+*    and recording its entry latency, see BSP_IRQ_GetProbeLatency().
+*
+*  Parameters
+*    Id       : BSP_IRQ_ID_*, interrupt to probe. Must return without
+*               a flag set (not SysTick or TIM7).
+*    PeriodUs : Average probe interval in microseconds, >= 2.
+*/
+void BSP_IRQ_StartProbe(unsigned int Id, unsigned int PeriodUs) {
+  if ((Id >= BSP_IRQ_NUM_IDS) || (_aIRQ[Id].Trigger != TRIGGER_PEND) || (PeriodUs < 2u)) {
+    return;
+  }
+  _ProbeId        = Id;
+  _ProbePeriodUs  = PeriodUs;
+  _IsProbePending = 0;
+  RCC->APB1ENR   |= RCC_APB1ENR_TIM6EN;
+  TIM6->CR1       = 0;
+  TIM6->PSC       = (PROBE_TIMER_CLOCK / 1000000u) - 1u;   // 1 MHz timer clock
+  TIM6->ARR       = PeriodUs - 1u;
+  TIM6->EGR       = TIM_EGR_UG;
+  TIM6->SR        = 0;
+  TIM6->DIER      = TIM_DIER_UIE;
+  TIM6->CR1       = TIM_CR1_ARPE | TIM_CR1_CEN;
+  NVIC_SetPriority(TIM6_DAC_IRQn, BSP_IRQ_PRIO_PROBE);
+  NVIC_EnableIRQ(TIM6_DAC_IRQn);
+}
+
+/*********************************************************************
+*
+*       BSP_IRQ_GetProbeLatency()
+*
+*  Function description
+*    Returns the max. entry latency seen by the probe in DWT cycles.
+*
+*  Parameters
+*    Id          : BSP_IRQ_ID_*.
+*    pNumSamples : Receives the number of probes. May be NULL.
+*/
+unsigned long BSP_IRQ_GetProbeLatency(unsigned int Id, unsigned long * pNumSamples) {
+  if (Id >= BSP_IRQ_NUM_IDS) {
+    return 0;
+  }
+  if (pNumSamples != NULL) {
+    *pNumSamples = _aProbeNum[Id];
+  }
+  return _aProbeMax[Id];
+}
+
+/*********************************************************************
+*
+*       TIM6_DAC_IRQHandler()
+*
+*  Function description
+*    Load probe, zero latency interrupt: must not call embOS.
+*    Pends the probed interrupt unless the last probe is outstanding
+*    and sets a pseudo-random next interval, so the probes do not lock
+*    to the phase of periodic activity like the OS tick.
+*/
+void TIM6_DAC_IRQHandler(void) {
+  unsigned int Id;
+
+  TIM6->SR = 0;
+  Id       = _ProbeId;
+  if ((Id < BSP_IRQ_NUM_IDS) && (_IsProbePending == 0u) && (NVIC_GetEnableIRQ(_aIRQ[Id].IRQn) != 0u)) {
+    _IsProbePending   = 1;
+    _ProbeStartCycles = DWT->CYCCNT;
+    NVIC_SetPendingIRQ(_aIRQ[Id].IRQn);
+  }
+  _ProbeSeed ^= _ProbeSeed << 13;
+  _ProbeSeed ^= _ProbeSeed >> 17;
+  _ProbeSeed ^= _ProbeSeed << 5;
+  TIM6->ARR   = _ProbePeriodUs / 2u + _ProbeSeed % _ProbePeriodUs;   // Takes effect with the next update (ARPE).
+}
+
+/*********************************************************************
+*
+*       BSP_IRQ_TestLatency()
+*
+*  Function description
+*    Raises an interrupt and measures the time until its handler runs.
+*
+*  Parameters
+*    Id : BSP_IRQ_ID_*.
+*
+*  Return value
+*    Entry latency in DWT cycles, 0 if the interrupt is not in use.
+*
+*  Additional information
+*    Must be called from a task with interrupts enabled. The result of
+*    the TIM7 test has a resolution of one timer tick (1 us).
+*/
+unsigned long BSP_IRQ_TestLatency(unsigned int Id) {
+  long r;
+
+  if (Id >= BSP_IRQ_NUM_IDS) {
+    return 0;
+  }
+  switch (_aIRQ[Id].Trigger) {
+  case TRIGGER_SYSTICK:
+    r = _TestSysTick();
+    break;
+  case TRIGGER_TIM7:
+    r = _TestTIM7();
+    break;
+  default:
+    r = _TestPend(Id);
+    break;
+  }
+  if (r < 0) {
+    return 0;
+  }
+  if ((unsigned long)r > _aMaxLatency[Id]) {
+    _aMaxLatency[Id] = (unsigned long)r;
+  }
+  return (unsigned long)r;
+}
+
+/*********************************************************************
+*
+*       BSP_IRQ_PrintLatency()
+*
+*  Function description
+*    Tests all interrupts of the project and prints the results via RTT.
+*/
+void BSP_IRQ_PrintLatency(void) {
+  unsigned int  Id;
+  unsigned long Cycles;
+
+  SEGGER_RTT_printf(0, "IRQ entry latency [cycles]:\n");
+  for (Id = 0; Id < BSP_IRQ_NUM_IDS; Id++) {
+    Cycles = BSP_IRQ_TestLatency(Id);
+    SEGGER_RTT_printf(0, "  %-18s prio %2u: %5u (max. %u)\n",
+                      _aIRQ[Id].sName, _aIRQ[Id].Prio, (unsigned)Cycles, (unsigned)_aMaxLatency[Id]);
+  }
+  Id = _ProbeId;
+  if (Id < BSP_IRQ_NUM_IDS) {
+    SEGGER_RTT_printf(0, "  %-18s under load: max. %u (%u probes)\n",
+                      _aIRQ[Id].sName, (unsigned)_aProbeMax[Id], (unsigned)_aProbeNum[Id]);
+  }
+}
+
+#endif  // BSP_IRQ_MEASURE_LATENCY
+
+/*************************** End of file ****************************/
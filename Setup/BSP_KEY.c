@@ -0,0 +1,487 @@
+/*********************************************************************
+-------------------------- END-OF-HEADER -----------------------------
+File    : BSP_KEY.c
+Purpose : Debounced key input
+
+Additional information:
+
+  Device : STM32F407
+  Board  : PCBtech STM32F407VET6
+
+  Key | Pin  | EXTI line
+  ======================
+  S   | PE10 | 10
+  T   | PE11 | 11
+  M   | PE12 | 12
+
+  The keys are active low. The first falling edge of a key raises
+  EXTI15_10 which masks the line of this key, so contact bounce does not
+  cause further interrupts. The pin is then sampled from an embOS
+  software timer once per system tick. A press or release is reported
+  when the pin shows the same level for the debounce time. The EXTI line
+  is unmasked again once the key is stable released. The debounce state
+  machine itself is in BSP_DEBOUNCE.c.
+
+  Optionally (BSP_KEY_MATRIX_ENABLE), a key matrix is scanned from the
+  TIM7 interrupt, one row per interrupt. The rows are open-drain outputs
+  driven low one at a time, the columns are inputs with pull-ups.
+  After a complete scan the new bitmap is debounced, checked for
+  ghosting and compared to the previous one. Only changed keys are
+  reported. Diodes in series with the keys avoid ghosting completely;
+  without them, a key completing a rectangle of three pressed keys
+  can not be distinguished from a ghost and is held back until the
+  rectangle is resolved.
+
+  Matrix | Pins
+  ===========================================
+  Rows   | PD0..PD(BSP_KEY_MATRIX_NUM_ROWS - 1)
+  Cols   | PD8..PD(8 + BSP_KEY_MATRIX_NUM_COLS - 1)
+
+  PD8/PD9 are the USART3 pins of embOSView, so the matrix can not be
+  used together with OS_VIEW_IF_UART (checked in RTOSInit_STM32F4xx.c).
+*/
+
+#include <string.h>
+#include "BSP_KEY.h"
+#include "BSP_DEBOUNCE.h"
+#include "RTOS.h"
+#include "BSP_IRQ.h"
+#include "stm32f4xx.h"   // Device specific header file, contains CMSIS defines.
+
+/*********************************************************************
+*
+*       Defines
+*
+**********************************************************************
+*/
+
+#define KEY_PORT_IDR          (GPIOE->IDR)
+#define KEY_FIRST_BIT         (10u)
+#define KEY_EXTI_MASK         (EXTI_IMR_MR10 | EXTI_IMR_MR11 | EXTI_IMR_MR12)
+#define KEY_SAMPLE_PERIOD     (1u)    // Sample period in system ticks
+
+#define MATRIX_PORT           (GPIOD)
+#define MATRIX_PORT_BSRR      (*(volatile unsigned long*)&MATRIX_PORT->BSRRL)   // 32-bit access to BSRRL/BSRRH
+#define MATRIX_RCC_BIT        (RCC_AHB1ENR_GPIODEN)
+#define MATRIX_FIRST_COL_BIT  (8u)
+#define MATRIX_ROW_MASK       ((1u << BSP_KEY_MATRIX_NUM_ROWS) - 1u)
+#define MATRIX_COL_MASK       ((1u << BSP_KEY_MATRIX_NUM_COLS) - 1u)
+#define MATRIX_TIMER          (TIM7)
+#define MATRIX_TIMER_IRQn     (TIM7_IRQn)
+#define MATRIX_TIMER_CLOCK    (SystemCoreClock / 2u)   // APB1 timer clock (APB1 prescaler 4)
+
+#if BSP_KEY_MATRIX_ENABLE
+  #if (BSP_KEY_MATRIX_NUM_ROWS < 1u) || (BSP_KEY_MATRIX_NUM_ROWS > 8u) || (BSP_KEY_MATRIX_NUM_COLS < 1u) || (BSP_KEY_MATRIX_NUM_COLS > 8u)
+    #error "Key matrix supports 1..8 rows and 1..8 columns"
+  #endif
+#endif
+
+/*********************************************************************
+*
+*       Types, local
+*
+**********************************************************************
+*/
+
+/*********************************************************************
+*
+*       Static data
+*
+**********************************************************************
+*/
+
+static BSP_KEY_CB*       _pfKeyCB;
+static BSP_DEBOUNCE_STATE _aKey[BSP_KEY_NUM_EXTI];  // TimeStamp is the DWT cycle counter.
+static volatile unsigned _ActiveMask;      // Keys currently sampled by the timer, EXTI masked.
+static unsigned int      _DebounceCnt;     // Debounce time in samples.
+static OS_TIMER          _Timer;
+#if BSP_KEY_MATRIX_ENABLE
+static unsigned char     _aMatrixRaw[BSP_KEY_MATRIX_NUM_ROWS];     // Column bitmap per row of the scan in progress.
+static unsigned char     _aMatrixLast[BSP_KEY_MATRIX_NUM_ROWS];    // Previous complete scan.
+static unsigned char     _aMatrixState[BSP_KEY_MATRIX_NUM_ROWS];   // Debounced and reported state.
+static unsigned int      _MatrixRow;                               // Row currently driven low.
+static unsigned int      _MatrixStableCnt;
+static unsigned long     _ScanCycles;                              // Cycles spent in the ISR for the last complete scan.
+static unsigned long     _ScanCyclesAcc;
+static unsigned long     _ScanCyclesMax;
+#endif
+
+/*********************************************************************
+*
+*       Prototypes
+*
+*  Declare ISR handler here to avoid "no prototype" warning.
+*  They are not declared in any CMSIS header.
+*
+**********************************************************************
+*/
+
+#if defined(__cplusplus)
+  extern "C" {                // Make sure we have C-declarations in C++ programs.
+#endif
+
+void EXTI15_10_IRQHandler(void);
+#if BSP_KEY_MATRIX_ENABLE
+void TIM7_IRQHandler(void);
+#endif
+
+#if defined(__cplusplus)
+}                             // Make sure we have C-declarations in C++ programs.
+#endif
+
+/*********************************************************************
+*
+*       Local functions
+*
+**********************************************************************
+*/
+
+/*********************************************************************
+*
+*       _Sample()
+*
+*  Function description
+*    Software timer routine. Samples all keys that are currently
+*    being debounced and reports stable state changes.
+*/
+static void _Sample(void) {
+  BSP_DEBOUNCE_STATE* pKey;
+  unsigned long       Now;
+  unsigned int        Pins;
+  unsigned int        i;
+  unsigned int        Level;
+  unsigned int        Result;
+
+  Now  = DWT->CYCCNT;
+  Pins = KEY_PORT_IDR;
+  for (i = 0; i < BSP_KEY_NUM_EXTI; i++) {
+    if ((_ActiveMask & (1u << i)) == 0u) {
+      continue;
+    }
+    pKey   = &_aKey[i];
+    Level  = ((Pins & (1u << (KEY_FIRST_BIT + i))) == 0u) ? 1u : 0u;
+    Result = BSP_DEBOUNCE_Step(pKey, Level, Now, _DebounceCnt);
+    if ((Result & BSP_DEBOUNCE_CHANGED) && _pfKeyCB) {
+      _pfKeyCB(i, pKey->IsPressed, pKey->TimeStamp);
+    }
+    if (Result & BSP_DEBOUNCE_IDLE) {
+      //
+      // Stable released: hand the key back to the EXTI edge detection.
+      //
+      _ActiveMask &= ~(1u << i);
+      EXTI->PR     = (1uL << (KEY_FIRST_BIT + i));
+      EXTI->IMR   |= (1uL << (KEY_FIRST_BIT + i));
+    }
+  }
+  if (_ActiveMask != 0u) {
+    OS_TIMER_Restart(&_Timer);
+  }
+}
+
+#if BSP_KEY_MATRIX_ENABLE
+/*********************************************************************
+*
+*       _MatrixRemoveGhosts()
+*
+*  Function description
+*    Holds back key changes which can not be told apart from ghosts.
+*
+*  Parameters
+*    pNew: Debounced bitmap of the current scan, modified in place.
+*
+*  Additional information
+*    Without diodes, three pressed keys at three corners of a rectangle
+*    make the fourth corner read as pressed as well. Whenever two rows
+*    share two or more pressed columns, the keys in these columns of
+*    both rows keep their previously reported state.
+*/
+static void _MatrixRemoveGhosts(unsigned char* pNew) {
+  unsigned int  r0;
+  unsigned int  r1;
+  unsigned char Common;
+
+  for (r0 = 0; r0 < BSP_KEY_MATRIX_NUM_ROWS; r0++) {
+    for (r1 = r0 + 1u; r1 < BSP_KEY_MATRIX_NUM_ROWS; r1++) {
+      Common = pNew[r0] & pNew[r1];
+      if ((Common & (Common - 1u)) != 0u) {       // At least 2 columns in common?
+        pNew[r0] = (pNew[r0] & ~Common) | (_aMatrixState[r0] & Common);
+        pNew[r1] = (pNew[r1] & ~Common) | (_aMatrixState[r1] & Common);
+      }
+    }
+  }
+}
+
+/*********************************************************************
+*
+*       _MatrixOnScanComplete()
+*
+*  Function description
+*    Debounces a complete scan and reports every key that changed.
+*/
+static void _MatrixOnScanComplete(unsigned long TimeStamp) {
+  unsigned char aNew[BSP_KEY_MATRIX_NUM_ROWS];
+  unsigned char Diff;
+  unsigned int  r;
+  unsigned int  c;
+
+  if (memcmp(_aMatrixRaw, _aMatrixLast, sizeof(_aMatrixRaw)) != 0) {
+    memcpy(_aMatrixLast, _aMatrixRaw, sizeof(_aMatrixRaw));
+    _MatrixStableCnt = 0;
+    return;
+  }
+  if (_MatrixStableCnt < BSP_KEY_MATRIX_DEBOUNCE_SCANS) {
+    _MatrixStableCnt++;
+    return;
+  }
+  memcpy(aNew, _aMatrixRaw, sizeof(aNew));
+  _MatrixRemoveGhosts(aNew);
+  for (r = 0; r < BSP_KEY_MATRIX_NUM_ROWS; r++) {
+    Diff = aNew[r] ^ _aMatrixState[r];
+    if (Diff == 0u) {
+      continue;
+    }
+    _aMatrixState[r] = aNew[r];
+    for (c = 0; Diff != 0u; c++) {
+      if (Diff & (1u << c)) {
+        Diff &= ~(1u << c);
+        if (_pfKeyCB) {
+          _pfKeyCB(BSP_KEY_MATRIX_FIRST + r * BSP_KEY_MATRIX_NUM_COLS + c, (aNew[r] >> c) & 1u, TimeStamp);
+        }
+      }
+    }
+  }
+}
+
+/*********************************************************************
+*
+*       _MatrixInit()
+*
+*  Function description
+*    Configures the matrix pins and starts the scan timer.
+*/
+static void _MatrixInit(void) {
+  unsigned int i;
+
+  RCC->AHB1ENR |= MATRIX_RCC_BIT;
+  for (i = 0; i < BSP_KEY_MATRIX_NUM_ROWS; i++) {
+    MATRIX_PORT->MODER   = (MATRIX_PORT->MODER & ~(3uL << (i * 2u))) | (1uL << (i * 2u));  // Output
+    MATRIX_PORT->OTYPER |= (1uL << i);                                                     // Open-drain
+  }
+  MATRIX_PORT_BSRR = MATRIX_ROW_MASK;                                                      // All rows released
+  for (i = MATRIX_FIRST_COL_BIT; i < MATRIX_FIRST_COL_BIT + BSP_KEY_MATRIX_NUM_COLS; i++) {
+    MATRIX_PORT->MODER &= ~(3uL << (i * 2u));                                              // Input
+    MATRIX_PORT->PUPDR  = (MATRIX_PORT->PUPDR & ~(3uL << (i * 2u))) | (1uL << (i * 2u));   // Pull-up
+  }
+  _MatrixRow        = 0;
+  MATRIX_PORT_BSRR  = (0x10000uL << _MatrixRow);                                           // Drive first row low
+  RCC->APB1ENR            |= RCC_APB1ENR_TIM7EN;
+  MATRIX_TIMER->PSC        = (MATRIX_TIMER_CLOCK / 1000000u) - 1u;                          // 1 MHz timer clock
+  MATRIX_TIMER->ARR        = BSP_KEY_MATRIX_ROW_PERIOD_US - 1u;
+  MATRIX_TIMER->EGR        = TIM_EGR_UG;
+  MATRIX_TIMER->SR         = 0;
+  MATRIX_TIMER->DIER       = TIM_DIER_UIE;
+  MATRIX_TIMER->CR1        = TIM_CR1_CEN;
+  NVIC_SetPriority(MATRIX_TIMER_IRQn, BSP_IRQ_PRIO_KEY_MATRIX);                            // Same as SysTick, see BSP_KEY_CB
+  NVIC_EnableIRQ(MATRIX_TIMER_IRQn);
+}
+#endif
+
+/*********************************************************************
+*
+*       Global functions, IRQ handler
+*
+**********************************************************************
+*/
+
+/*********************************************************************
+*
+*       EXTI15_10_IRQHandler()
+*
+*  Function description
+*    Key edge interrupt handler.
+*
+*  Additional information
+*    Masks the EXTI line of every key with a pending edge and starts
+*    sampling it, so each press costs a single interrupt.
+*    _ActiveMask and _aKey[] are shared with _Sample() without locking.
+*    This is safe as long as this interrupt and SysTick, which runs the
+*    embOS software timers, have the same preemption priority.
+*/
+void EXTI15_10_IRQHandler(void) {
+  unsigned long Now;
+  unsigned int  Pending;
+  unsigned int  i;
+
+  BSP_IRQ_ENTER(BSP_IRQ_ID_KEY_EXTI);
+  OS_INT_EnterNestable();
+  Now       = DWT->CYCCNT;
+  Pending   = EXTI->PR & EXTI->IMR & KEY_EXTI_MASK;   // Lines masked while debouncing may still latch an edge.
+  EXTI->IMR &= ~Pending;
+  EXTI->PR   = Pending;              // Write 1 to clear only the lines handled here.
+  for (i = 0; i < BSP_KEY_NUM_EXTI; i++) {
+    if (Pending & (1uL << (KEY_FIRST_BIT + i))) {
+      BSP_DEBOUNCE_OnEdge(&_aKey[i], Now);
+      _ActiveMask |= (1u << i);
+    }
+  }
+  if (Pending != 0u) {
+    OS_TIMER_Start(&_Timer);
+  }
+  OS_INT_LeaveNestable();
+}
+
+#if BSP_KEY_MATRIX_ENABLE
+/*********************************************************************
+*
+*       TIM7_IRQHandler()
+*
+*  Function description
+*    Key matrix scan interrupt handler.
+*
+*  Additional information
+*    Reads the columns of the row driven low by the previous
+*    interrupt, which gives the lines a full row period to settle,
+*    then drives the next row. The cycles spent in this handler are
+*    summed up per complete scan, see BSP_KEY_GetScanCycles().
+*/
+void TIM7_IRQHandler(void) {
+  unsigned long t0;
+  unsigned int  Row;
+
+  BSP_IRQ_ENTER(BSP_IRQ_ID_KEY_MATRIX);
+  OS_INT_EnterNestable();
+  t0                = DWT->CYCCNT;
+  MATRIX_TIMER->SR  = 0;
+  Row               = _MatrixRow;
+  _aMatrixRaw[Row]  = (unsigned char)(~(MATRIX_PORT->IDR >> MATRIX_FIRST_COL_BIT) & MATRIX_COL_MASK);
+  _MatrixRow        = (Row + 1u < BSP_KEY_MATRIX_NUM_ROWS) ? Row + 1u : 0u;
+  MATRIX_PORT_BSRR  = (1uL << Row) | (0x10000uL << _MatrixRow);
+  if (_MatrixRow == 0u) {
+    _MatrixOnScanComplete(t0);
+  }
+  _ScanCyclesAcc += DWT->CYCCNT - t0;
+  if (_MatrixRow == 0u) {
+    _ScanCycles    = _ScanCyclesAcc;
+    _ScanCyclesAcc = 0;
+    if (_ScanCycles > _ScanCyclesMax) {
+      _ScanCyclesMax = _ScanCycles;
+    }
+  }
+  OS_INT_LeaveNestable();
+}
+#endif
+
+/*********************************************************************
+*
+*       Global functions
+*
+**********************************************************************
+*/
+
+/*********************************************************************
+*
+*       BSP_KEY_Init()
+*
+*  Function description
+*    Initializes the EXTI lines of the keys and the debounce timer.
+*
+*  Additional information
+*    Must be called after OS_Init() and after the key port has been
+*    clocked and configured as input by BSP_Init().
+*/
+void BSP_KEY_Init(void) {
+  OS_TIMER_Create(&_Timer, _Sample, KEY_SAMPLE_PERIOD);
+  BSP_KEY_SetDebounceTime(BSP_KEY_DEBOUNCE_MS);
+  RCC->APB2ENR |= RCC_APB2ENR_SYSCFGEN;
+  SYSCFG->EXTICR[2] |= SYSCFG_EXTICR3_EXTI10_PE | SYSCFG_EXTICR3_EXTI11_PE;
+  SYSCFG->EXTICR[3] |= SYSCFG_EXTICR4_EXTI12_PE;
+  EXTI->PR    = KEY_EXTI_MASK;
+  EXTI->FTSR |= KEY_EXTI_MASK;
+  EXTI->IMR  |= KEY_EXTI_MASK;
+  //
+  // The key ISR calls embOS functions, so it must run at an embOS managed priority
+  //
+  NVIC_SetPriority(EXTI15_10_IRQn, BSP_IRQ_PRIO_KEY_EXTI);
+  NVIC_EnableIRQ(EXTI15_10_IRQn);
+#if BSP_KEY_MATRIX_ENABLE
+  _MatrixInit();
+#endif
+}
+
+/*********************************************************************
+*
+*       BSP_KEY_SetCallback()
+*
+*  Function description
+*    Sets the callback which is called for every debounced press
+*    and release.
+*
+*  Parameters
+*    pf: Pointer to the callback function, may be NULL.
+*/
+void BSP_KEY_SetCallback(BSP_KEY_CB* pf) {
+  _pfKeyCB = pf;
+}
+
+/*********************************************************************
+*
+*       BSP_KEY_SetDebounceTime()
+*
+*  Function description
+*    Configures the debounce time.
+*
+*  Parameters
+*    ms: Time [ms] a key must be stable before a state change is reported.
+*/
+void BSP_KEY_SetDebounceTime(unsigned int ms) {
+  _DebounceCnt = (unsigned int)OS_TIME_Convertms2Ticks(ms) / KEY_SAMPLE_PERIOD;
+}
+
+/*********************************************************************
+*
+*       BSP_KEY_IsPressed()
+*
+*  Function description
+*    Returns the debounced state of a key.
+*
+*  Return value
+*    == 0: Key released.
+*    == 1: Key pressed.
+*/
+int BSP_KEY_IsPressed(unsigned int KeyIndex) {
+  if (KeyIndex < BSP_KEY_NUM_EXTI) {
+    return _aKey[KeyIndex].IsPressed;
+  }
+#if BSP_KEY_MATRIX_ENABLE
+  if (KeyIndex < BSP_KEY_NUM_KEYS) {
+    KeyIndex -= BSP_KEY_MATRIX_FIRST;
+    return (_aMatrixState[KeyIndex / BSP_KEY_MATRIX_NUM_COLS] >> (KeyIndex % BSP_KEY_MATRIX_NUM_COLS)) & 1;
+  }
+#endif
+  return 0;
+}
+
+#if BSP_KEY_MATRIX_ENABLE
+/*********************************************************************
+*
+*       BSP_KEY_GetScanCycles()
+*
+*  Function description
+*    Returns the CPU cycles spent in the scan interrupt per complete
+*    matrix scan (all rows).
+*
+*  Parameters
+*    pLast: [OUT] Cycles of the last complete scan. May be NULL.
+*    pMax : [OUT] Maximum cycles of any scan so far. May be NULL.
+*/
+void BSP_KEY_GetScanCycles(unsigned long* pLast, unsigned long* pMax) {
+  if (pLast) {
+    *pLast = _ScanCycles;
+  }
+  if (pMax) {
+    *pMax = _ScanCyclesMax;
+  }
+}
+#endif
+
+/*************************** End of file ****************************/
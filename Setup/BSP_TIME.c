@@ -0,0 +1,196 @@
+/*********************************************************************
+-------------------------- END-OF-HEADER -----------------------------
+File    : BSP_TIME.c
+Purpose : 64-bit millisecond / microsecond time base
+
+Additional information:
+
+  The time is kept in the DWT cycle counter, which is enabled by
+  BSP_BOOT_Start(). BSP_TIME_OnTick() is called by SysTick_Handler()
+  and moves a snapshot forward: the cycle counter at the tick, the
+  time in us and ms at that moment and the cycles resp. us which
+  were not enough for the next full us resp. ms. A reader adds the
+  cycles elapsed since the last tick, so the 32-bit cycle counter
+  only has to be sampled more often than it wraps (25 s at 168 MHz).
+
+  Cycles are converted with a multiplication by the reciprocal of
+  the divisor: n / d == (n * ceil(2^32 / d)) >> 32 for n < 2^32 / d.
+  The snapshot keeps n below one tick worth of cycles, far below
+  that limit. The core clock must be a whole number of MHz.
+
+  There is no lock: The writer fills the snapshot which is not in
+  use and then publishes it by incrementing the generation counter.
+  A reader retries if the generation changed while it copied the
+  snapshot. Both functions may be called from tasks and from any
+  interrupt, the time is monotonic as long as SysTick is running.
+*/
+
+#include "BSP_TIME.h"
+#include "stm32f4xx.h"   // Device specific header file, contains CMSIS defines.
+
+/*********************************************************************
+*
+*       Types, local
+*
+**********************************************************************
+*/
+
+typedef struct {
+  unsigned long long Us;          // Time in us at Cycles.
+  unsigned long long Ms;          // Time in ms at Cycles.
+  uint32_t           Cycles;      // DWT cycle counter at the last tick.
+  uint32_t           RemCycles;   // Cycles counted neither in Us nor in Ms, < one us.
+  uint32_t           RemUs;       // Microseconds not counted in Ms, < one ms.
+} TIME_SNAPSHOT;
+
+/*********************************************************************
+*
+*       Static data
+*
+**********************************************************************
+*/
+
+static TIME_SNAPSHOT     _aSnapshot[2];
+static volatile uint32_t _Generation;      // _aSnapshot[_Generation & 1] is valid.
+static uint32_t          _CyclesPerUs;
+static uint32_t          _RecipCyclesPerUs; // ceil(2^32 / _CyclesPerUs)
+static uint32_t          _RecipUsPerMs;     // ceil(2^32 / 1000)
+
+/*********************************************************************
+*
+*       Local functions
+*
+**********************************************************************
+*/
+
+/*********************************************************************
+*
+*       _Div()
+*
+*  Function description
+*    Divides by multiplying with a reciprocal computed by BSP_TIME_Init().
+*/
+static uint32_t _Div(uint32_t n, uint32_t Recip) {
+  return (uint32_t)(((unsigned long long)n * Recip) >> 32);
+}
+
+/*********************************************************************
+*
+*       _Read()
+*
+*  Function description
+*    Copies a consistent snapshot and samples the cycle counter.
+*
+*  Return value
+*    Cycles elapsed since the snapshot plus its remaining cycles.
+*/
+static uint32_t _Read(TIME_SNAPSHOT * pSnapshot) {
+  uint32_t Generation;
+  uint32_t Now;
+
+  do {
+    Generation = _Generation;
+    __COMPILER_BARRIER();
+    *pSnapshot = _aSnapshot[Generation & 1u];
+    Now        = DWT->CYCCNT;
+    __COMPILER_BARRIER();
+  } while (Generation != _Generation);
+  return pSnapshot->RemCycles + (Now - pSnapshot->Cycles);
+}
+
+/*********************************************************************
+*
+*       Global functions
+*
+**********************************************************************
+*/
+
+/*********************************************************************
+*
+*       BSP_TIME_Init()
+*
+*  Function description
+*    Starts the time base at 0. Called by OS_InitHW() once
+*    SystemCoreClock is up to date.
+*/
+void BSP_TIME_Init(void) {
+  TIME_SNAPSHOT * pSnapshot;
+
+  _CyclesPerUs      = SystemCoreClock / 1000000u;
+  _RecipCyclesPerUs = (uint32_t)((0x100000000uLL + _CyclesPerUs - 1u) / _CyclesPerUs);
+  _RecipUsPerMs     = (uint32_t)((0x100000000uLL + 1000u - 1u) / 1000u);
+  pSnapshot         = &_aSnapshot[(_Generation + 1u) & 1u];
+  pSnapshot->Us        = 0;
+  pSnapshot->Ms        = 0;
+  pSnapshot->Cycles    = DWT->CYCCNT;
+  pSnapshot->RemCycles = 0;
+  pSnapshot->RemUs     = 0;
+  __COMPILER_BARRIER();
+  _Generation++;
+}
+
+/*********************************************************************
+*
+*       BSP_TIME_OnTick()
+*
+*  Function description
+*    Moves the snapshot to the current time. Called by SysTick_Handler(),
+*    must not be called from anywhere else.
+*/
+void BSP_TIME_OnTick(void) {
+  const TIME_SNAPSHOT * pOld;
+  TIME_SNAPSHOT *       pNew;
+  uint32_t              Now;
+  uint32_t              Cycles;
+  uint32_t              Us;
+  uint32_t              Ms;
+
+  pOld   = &_aSnapshot[_Generation & 1u];
+  pNew   = &_aSnapshot[(_Generation + 1u) & 1u];
+  Now    = DWT->CYCCNT;
+  Cycles = pOld->RemCycles + (Now - pOld->Cycles);
+  Us     = _Div(Cycles, _RecipCyclesPerUs);
+  pNew->Cycles    = Now;
+  pNew->RemCycles = Cycles - Us * _CyclesPerUs;
+  pNew->Us        = pOld->Us + Us;
+  Us             += pOld->RemUs;
+  Ms              = _Div(Us, _RecipUsPerMs);
+  pNew->RemUs     = Us - Ms * 1000u;
+  pNew->Ms        = pOld->Ms + Ms;
+  __COMPILER_BARRIER();                    // Snapshot complete before it is published.
+  _Generation++;
+}
+
+/*********************************************************************
+*
+*       BSP_TIME_Get_us64()
+*
+*  Function description
+*    Returns the time since BSP_TIME_Init() in microseconds.
+*/
+unsigned long long BSP_TIME_Get_us64(void) {
+  TIME_SNAPSHOT Snapshot;
+  uint32_t      Cycles;
+
+  Cycles = _Read(&Snapshot);
+  return Snapshot.Us + _Div(Cycles, _RecipCyclesPerUs);
+}
+
+/*********************************************************************
+*
+*       BSP_TIME_Get_ms64()
+*
+*  Function description
+*    Returns the time since BSP_TIME_Init() in milliseconds.
+*/
+unsigned long long BSP_TIME_Get_ms64(void) {
+  TIME_SNAPSHOT Snapshot;
+  uint32_t      Cycles;
+  uint32_t      Us;
+
+  Cycles = _Read(&Snapshot);
+  Us     = Snapshot.RemUs + _Div(Cycles, _RecipCyclesPerUs);
+  return Snapshot.Ms + _Div(Us, _RecipUsPerMs);
+}
+
+/*************************** End of file ****************************/
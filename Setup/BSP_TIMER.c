@@ -0,0 +1,246 @@
+/*********************************************************************
+-------------------------- END-OF-HEADER -----------------------------
+File    : BSP_TIMER.c
+Purpose : Microsecond one-shot timers on TIM2
+
+Additional information:
+
+  TIM2 is a 32-bit timer. It counts up freely at 1 MHz and wraps
+  after about 71 minutes. Each of its four compare channels is used as
+  one one-shot timer: BSP_TIMER_Start() sets the compare value to the
+  expiry time and enables the channel interrupt, the interrupt disables
+  it again and calls the callback. Unlike a timeout in embOS ticks, the
+  expiry is not rounded up to the next tick.
+
+  BSP_TIMER_Start() and BSP_TIMER_Stop() may be called from tasks and
+  interrupts. They briefly disable embOS interrupts. Once BSP_TIMER_Stop()
+  has returned, the callback of that timer is not called anymore.
+
+  Zero latency interrupts (BSP_IRQ_PRIO_PROBE) and bus stalls may delay
+  BSP_TIMER_Start() between reading the counter and writing the compare
+  value. If the counter has passed the compare value meanwhile, the
+  match would only happen after the counter wraps. BSP_TIMER_Start()
+  therefore checks the counter again and raises the compare event by
+  software, the timer then expires right away.
+*/
+
+#include "BSP_TIMER.h"
+#include "RTOS.h"        // For OS_INT_Enter()/OS_INT_Leave().
+#include "BSP_IRQ.h"
+#include "stm32f4xx.h"   // Device specific header file, contains CMSIS defines.
+
+/*********************************************************************
+*
+*       Defines
+*
+**********************************************************************
+*/
+
+#define TIMER_FREQ     (1000000u)   // Counter frequency [Hz].
+#define TIMER_MIN_US   (2u)         // Shorter timeouts are extended, the compare must be ahead of the counter.
+
+/*********************************************************************
+*
+*       Static data
+*
+**********************************************************************
+*/
+
+static BSP_TIMER_CB * _apfOnExpire[BSP_TIMER_NUM_CHANNELS];
+static void *         _apContext[BSP_TIMER_NUM_CHANNELS];
+static unsigned       _UsedMask;                          // Bit n set: Channel n has been started.
+static unsigned       _aGeneration[BSP_TIMER_NUM_CHANNELS]; // Incremented per start, tells a stale handle from the current one.
+
+/*********************************************************************
+*
+*       Prototypes
+*
+*  Declare ISR handler here to avoid "no prototype" warning.
+*  They are not declared in any CMSIS header.
+*
+**********************************************************************
+*/
+
+#if defined(__cplusplus)
+  extern "C" {                // Make sure we have C-declarations in C++ programs.
+#endif
+
+void TIM2_IRQHandler(void);
+
+#if defined(__cplusplus)
+}                             // Make sure we have C-declarations in C++ programs.
+#endif
+
+/*********************************************************************
+*
+*       Local functions
+*
+**********************************************************************
+*/
+
+/*********************************************************************
+*
+*       _GetCCR()
+*
+*  Function description
+*    Returns the compare register of a channel.
+*/
+static volatile uint32_t * _GetCCR(unsigned Channel) {
+  return &TIM2->CCR1 + Channel;
+}
+
+/*********************************************************************
+*
+*       _GetTimerClock()
+*
+*  Function description
+*    Returns the input clock of TIM2. The APB1 timer clock is twice
+*    the APB1 clock if APB1 is divided.
+*/
+static uint32_t _GetTimerClock(void) {
+  uint32_t PPRE1;
+
+  PPRE1 = (RCC->CFGR & RCC_CFGR_PPRE1) >> 10;
+  if (PPRE1 < 4u) {
+    return SystemCoreClock;
+  }
+  return (SystemCoreClock >> (PPRE1 - 3u)) * 2u;
+}
+
+/*********************************************************************
+*
+*       Global functions
+*
+**********************************************************************
+*/
+
+/*********************************************************************
+*
+*       TIM2_IRQHandler()
+*
+*  Function description
+*    Calls the callbacks of all expired one-shot timers.
+*/
+void TIM2_IRQHandler(void) {
+  uint32_t       Status;
+  unsigned       Channel;
+  BSP_TIMER_CB * apf[BSP_TIMER_NUM_CHANNELS];
+  void *         apContext[BSP_TIMER_NUM_CHANNELS];
+
+  BSP_IRQ_ENTER(BSP_IRQ_ID_TIMER);
+  OS_EnterNestableInterrupt();
+  OS_INT_IncDI();                          // BSP_TIMER_Start() may be called by a nested interrupt.
+  Status      = TIM2->SR & TIM2->DIER;
+  TIM2->SR    = ~Status;                   // rc_w0: Clear the flags being handled only.
+  TIM2->DIER &= ~Status;                   // CCxIE and CCxIF use the same bit positions.
+  for (Channel = 0; Channel < BSP_TIMER_NUM_CHANNELS; Channel++) {
+    apf[Channel] = NULL;
+    if (Status & (TIM_SR_CC1IF << Channel)) {
+      apf[Channel]       = _apfOnExpire[Channel];
+      apContext[Channel] = _apContext[Channel];
+      _UsedMask         &= ~(1u << Channel);
+    }
+  }
+  OS_INT_DecRI();
+  for (Channel = 0; Channel < BSP_TIMER_NUM_CHANNELS; Channel++) {
+    if (apf[Channel] != NULL) {
+      apf[Channel](apContext[Channel]);
+    }
+  }
+  OS_LeaveNestableInterrupt();
+}
+
+/*********************************************************************
+*
+*       BSP_TIMER_Init()
+*
+*  Function description
+*    Starts TIM2 as free running 1 MHz counter.
+*/
+void BSP_TIMER_Init(void) {
+  RCC->APB1ENR |= RCC_APB1ENR_TIM2EN;
+  (void)RCC->APB1ENR;                      // Read back, ensures the clock is running before the next access.
+  TIM2->CR1   = 0;
+  TIM2->DIER  = 0;
+  TIM2->PSC   = _GetTimerClock() / TIMER_FREQ - 1u;
+  TIM2->ARR   = 0xFFFFFFFFu;
+  TIM2->EGR   = TIM_EGR_UG;                // Load the prescaler.
+  TIM2->SR    = 0;
+  TIM2->CR1   = TIM_CR1_CEN;
+  NVIC_SetPriority(TIM2_IRQn, BSP_IRQ_PRIO_TIMER);
+  NVIC_EnableIRQ(TIM2_IRQn);
+}
+
+/*********************************************************************
+*
+*       BSP_TIMER_Start()
+*
+*  Function description
+*    Starts a one-shot timer.
+*
+*  Parameters
+*    Us        : Time until expiry in microseconds.
+*    pfOnExpire: Called from the TIM2 interrupt on expiry.
+*    pContext  : Passed to pfOnExpire.
+*
+*  Return value
+*    >= 0: Handle of the timer, to be passed to BSP_TIMER_Stop().
+*    <  0: All channels in use.
+*/
+int BSP_TIMER_Start(unsigned long Us, BSP_TIMER_CB * pfOnExpire, void * pContext) {
+  unsigned Channel;
+  uint32_t Compare;
+  int      r;
+
+  if (Us < TIMER_MIN_US) {
+    Us = TIMER_MIN_US;
+  }
+  r = -1;
+  OS_INT_IncDI();
+  for (Channel = 0; Channel < BSP_TIMER_NUM_CHANNELS; Channel++) {
+    if ((_UsedMask & (1u << Channel)) == 0u) {
+      _UsedMask              |= 1u << Channel;
+      _apfOnExpire[Channel]   = pfOnExpire;
+      _apContext[Channel]     = pContext;
+      Compare                 = TIM2->CNT + (uint32_t)Us;
+      *_GetCCR(Channel)       = Compare;
+      TIM2->SR                = ~(TIM_SR_CC1IF << Channel);
+      TIM2->DIER             |= TIM_DIER_CC1IE << Channel;
+      if ((int32_t)(Compare - TIM2->CNT) <= 0) {
+        TIM2->EGR             = TIM_EGR_CC1G << Channel;   // Missed or just matched, sets CCxIF.
+      }
+      _aGeneration[Channel]   = (_aGeneration[Channel] + 1u) & 0xFFFFu;
+      r = (int)((_aGeneration[Channel] << 2) | Channel);
+      break;
+    }
+  }
+  OS_INT_DecRI();
+  return r;
+}
+
+/*********************************************************************
+*
+*       BSP_TIMER_Stop()
+*
+*  Function description
+*    Stops a one-shot timer which has not expired yet. Does nothing
+*    if the timer has already expired, even if its channel has been
+*    started again meanwhile.
+*/
+void BSP_TIMER_Stop(int Handle) {
+  unsigned Channel;
+
+  if (Handle < 0) {
+    return;
+  }
+  Channel = (unsigned)Handle & (BSP_TIMER_NUM_CHANNELS - 1u);
+  OS_INT_IncDI();
+  if (((_UsedMask & (1u << Channel)) != 0u) && (_aGeneration[Channel] == ((unsigned)Handle >> 2))) {
+    TIM2->DIER &= ~(TIM_DIER_CC1IE << Channel);
+    TIM2->SR    = ~(TIM_SR_CC1IF << Channel);
+    _UsedMask  &= ~(1u << Channel);
+  }
+  OS_INT_DecRI();
+}
+
+/*************************** End of file ****************************/
@@ -41,6 +41,7 @@ Additional information:
 
 #include "BSP_UART.h"
 #include "RTOS.h"        // For OS_INT_Enter()/OS_INT_Leave(). Remove this line and OS_INT_* functions if not using OS.
+#include "BSP_IRQ.h"
 #include "stm32f4xx.h"   // Device specific header file, contains CMSIS defines.
 
 /*********************************************************************
@@ -158,6 +159,7 @@ void BSP_UART_IRQHandler(void) {
   unsigned int  Status;
   unsigned char Data;
 
+  BSP_IRQ_ENTER(BSP_IRQ_ID_UART);
   OS_EnterNestableInterrupt();
   Status = USART_SR;                        // Examine status register
   //
@@ -228,23 +230,31 @@ void BSP_UART_Init(unsigned int Unit, unsigned long Baudrate, unsigned char NumD
   //
   RCC_AHB1ENR  |= (1uL <<  3);    // GPIO CLK enable
   RCC_APB1ENR  |= (1uL << 18);    // Enable USART3 clock
-                                  // GPIOC set alternate function for USART3
-  GPIO_AF_HIGH  = (7uL <<  0)     // - Set pin_8 to AF7
+  //
+  // Only pin 8 and 9 of GPIOD are changed, the other pins may be used
+  // by the application.
+  //
+                                  // GPIOD set alternate function for USART3
+  GPIO_AF_HIGH  = (GPIO_AF_HIGH & ~(0xFFuL << 0))
+                | (7uL <<  0)     // - Set pin_8 to AF7
                 | (7uL <<  4);    // - Set pin_9 to AF7
-                                  // GPIOC alternate function mode
-  GPIO_MODER    = (2uL << 16)     // - Pin_8 AF
+                                  // GPIOD alternate function mode
+  GPIO_MODER    = (GPIO_MODER & ~(0xFuL << 16))
+                | (2uL << 16)     // - Pin_8 AF
                 | (2uL << 18);    // - Pin_9 AF
-                                  // GPIOC speed setting
-  GPIO_OSPEEDR  = (2uL << 16)     // - Pin_8 fast speed
+                                  // GPIOD speed setting
+  GPIO_OSPEEDR  = (GPIO_OSPEEDR & ~(0xFuL << 16))
+                | (2uL << 16)     // - Pin_8 fast speed
                 | (2uL << 18);    // - Pin_9 fast speed
-  GPIO_OTYPER   = 0;              // Output type: push-pull for pin_10 and pin_11
+  GPIO_OTYPER  &= ~(3uL << 8);    // Output type: push-pull for pin_8 and pin_9
                                   // Pull-up/pull-down register
-  GPIO_PUPDR    = (1uL << 16)     // - Pin_8 pull-up
+  GPIO_PUPDR    = (GPIO_PUPDR & ~(0xFuL << 16))
+                | (1uL << 16)     // - Pin_8 pull-up
                 | (1uL << 18);    // - Pin_9 pull-up
   //
   // Initialize IRQ.
   //
-  NVIC_SetPriority(BSP_UART_IRQn, (1u << __NVIC_PRIO_BITS) - 2u);
+  NVIC_SetPriority(BSP_UART_IRQn, BSP_IRQ_PRIO_UART);
   NVIC_EnableIRQ(BSP_UART_IRQn);
   //
   // Initialize USART.
@@ -32,6 +32,10 @@ Purpose : Initializes and handles the hardware for embOS
 #include "RTOS.h"
 #include "SEGGER_SYSVIEW.h"
 #include "stm32f4xx.h"
+#include "CDC_Serial.h"    // OS_VIEW_IF_USB_CDC
+#include "BSP.h"           // BSP_MEASURE_TICK_LATENCY
+#include "BSP_TIME.h"
+#include "BSP_IRQ.h"
 
 /*********************************************************************
 *
@@ -45,7 +49,13 @@ Purpose : Initializes and handles the hardware for embOS
 *       System tick settings
 */
 #define OS_TIMER_FREQ  (SystemCoreClock)
-#define OS_TICK_FREQ   (1000u)
+//
+// A higher tick rate gives finer timeouts, USB_OS_TICK_RATE_HZ
+// (USB_OS_embOSv5.c) has to be set to the same value.
+//
+#ifndef   OS_TICK_FREQ
+  #define OS_TICK_FREQ (1000u)
+#endif
 #define OS_INT_FREQ    (OS_TICK_FREQ)
 
 /*********************************************************************
@@ -60,9 +70,21 @@ Purpose : Initializes and handles the hardware for embOS
   #include "JLINKMEM.h"
 #elif (OS_VIEW_IFSELECT == OS_VIEW_IF_UART)
   #include "BSP_UART.h"
+  #include "BSP_KEY.h"
   #define OS_UART      (0u)
   #define OS_BAUDRATE  (38400u)
+  //
+  // USART3 uses PD8 (TX) and PD9 (RX), which are the first key matrix columns.
+  //
+  #if BSP_KEY_MATRIX_ENABLE
+    #error "BSP_KEY_MATRIX_ENABLE can not be used with OS_VIEW_IF_UART, both use PD8/PD9"
+  #endif
 #endif
+//
+// OS_VIEW_IF_USB_CDC: embOSView runs on the CDC-ACM virtual COM port.
+// The application has to add the port with CDC_SERIAL_Add(), see
+// USE_CDC_SERIAL in USB_HID_Keyboard.c.
+//
 
 /*********************************************************************
 *
@@ -75,6 +97,9 @@ Purpose : Initializes and handles the hardware for embOS
 #else
   const OS_U32 OS_JLINKMEM_BufferSize = 0u;   // Buffer not used
 #endif
+#if BSP_MEASURE_TICK_LATENCY
+  static OS_U32 _TickLatencyMax;              // Max. cycles from the SysTick reload until SysTick_Handler() runs.
+#endif
 
 /*********************************************************************
 *
@@ -109,6 +134,19 @@ static int _OS_OnTX(unsigned int Unit) {
 }
 #endif
 
+#if (OS_VIEW_IFSELECT == OS_VIEW_IF_USB_CDC)
+/*********************************************************************
+*
+*       _OS_OnTXCDC()
+*
+*  Function description
+*    Callback wrapper function for the CDC serial module.
+*/
+static int _OS_OnTXCDC(void) {
+  return (int)OS_COM_OnTx();
+}
+#endif
+
 /*********************************************************************
 *
 *       _OS_GetHWTimerCycles()
@@ -153,12 +191,28 @@ static unsigned int _OS_GetHWTimer_IntPending(void) {
 *    This is the hardware timer exception handler.
 */
 void SysTick_Handler(void) {
+#if BSP_MEASURE_TICK_LATENCY
+  OS_U32 Latency;
+#endif
+
+  BSP_IRQ_ENTER(BSP_IRQ_ID_SYSTICK);
+#if BSP_MEASURE_TICK_LATENCY
+  //
+  // The counter has been reloaded when the exception was raised and
+  // counts down since then. Valid as long as the latency is below one tick.
+  //
+  Latency = SysTick->LOAD - SysTick->VAL;
+  if (Latency > _TickLatencyMax) {
+    _TickLatencyMax = Latency;
+  }
+#endif
 #if (OS_SUPPORT_TRACE_API != 0)
   if (SEGGER_SYSVIEW_DWT_IS_ENABLED() == 0u) {
     SEGGER_SYSVIEW_TickCnt++;
   }
 #endif
   OS_INT_EnterNestable();
+  BSP_TIME_OnTick();
   OS_TICK_Handle();
 #if (OS_VIEW_IFSELECT == OS_VIEW_IF_JLINK)
   JLINKMEM_Process();
@@ -166,6 +220,19 @@ void SysTick_Handler(void) {
   OS_INT_LeaveNestable();
 }
 
+#if BSP_MEASURE_TICK_LATENCY
+/*********************************************************************
+*
+*       BSP_GetMaxTickLatency()
+*
+*  Function description
+*    Returns the max. entry latency of SysTick_Handler() in CPU cycles.
+*/
+unsigned long BSP_GetMaxTickLatency(void) {
+  return _TickLatencyMax;
+}
+#endif
+
 /*********************************************************************
 *
 *       OS_InitHW()
@@ -199,7 +266,8 @@ void OS_InitHW(void) {
   //
   SystemCoreClockUpdate();                                        // Update the system clock variable (might not have been set before)
   SysTick_Config(OS_TIMER_FREQ / OS_INT_FREQ);                    // Setup SysTick Timer
-  NVIC_SetPriority(SysTick_IRQn, (1u << __NVIC_PRIO_BITS) - 2u);  // Set the priority higher than the PendSV priority
+  BSP_TIME_Init();                                                // 64-bit time base, advanced by SysTick_Handler()
+  NVIC_SetPriority(SysTick_IRQn, BSP_IRQ_PRIO_SYSTICK);           // Set the priority higher than the PendSV priority, see BSP_IRQ.h
   //
   // Inform embOS about the timer settings
   //
@@ -224,6 +292,9 @@ void OS_InitHW(void) {
   BSP_UART_Init(OS_UART, OS_BAUDRATE, BSP_UART_DATA_BITS_8, BSP_UART_PARITY_NONE, BSP_UART_STOP_BITS_1);
   BSP_UART_SetReadCallback(OS_UART, _OS_OnRX);
   BSP_UART_SetWriteCallback(OS_UART, _OS_OnTX);
+#elif (OS_VIEW_IFSELECT == OS_VIEW_IF_USB_CDC)
+  CDC_SERIAL_SetReadCallback(OS_COM_OnRx);
+  CDC_SERIAL_SetWriteCallback(_OS_OnTXCDC);
 #endif
   OS_INT_DecRI();
 }
@@ -273,6 +344,8 @@ void OS_COM_Send1(OS_U8 c) {
   JLINKMEM_SendChar(c);
 #elif (OS_VIEW_IFSELECT == OS_VIEW_IF_UART)
   BSP_UART_Write1(OS_UART, c);
+#elif (OS_VIEW_IFSELECT == OS_VIEW_IF_USB_CDC)
+  CDC_SERIAL_Write1(c);
 #elif (OS_VIEW_IFSELECT == OS_VIEW_DISABLED)
   OS_USE_PARA(c);          // Avoid compiler warning
   OS_COM_ClearTxActive();  // Let embOS know that Tx is not busy
@@ -17,6 +17,7 @@ Purpose : USB BSP for the ST STM32F4x9I_EVAL board
 
 #include "BSP_USB.h"
 #include "RTOS.h"
+#include "BSP_IRQ.h"
 #include "stm32f4xx.h"     // Device specific header file, contains CMSIS
 
 /*********************************************************************
@@ -25,6 +26,9 @@ Purpose : USB BSP for the ST STM32F4x9I_EVAL board
 *
 **********************************************************************
 */
+#define EP0_MAX_PACKET_SIZE   (64u)
+#define NUM_VECTORS           (16u + (unsigned)FPU_IRQn + 1u)   // System exceptions and device interrupts.
+#define RAM_VECTORS_ALIGN     (512u)                            // VTOR requires the table size rounded up to a power of 2.
 
 /*********************************************************************
 *
@@ -42,6 +46,17 @@ typedef void USB_ISR_HANDLER  (void);
 */
 static USB_ISR_HANDLER * _pfOTG_FSHandler;
 static USB_ISR_HANDLER * _pfOTG_HSHandler;
+static volatile uint32_t _ISRTimeStamp;    // DWT cycle counter at entry of the last USB interrupt.
+static unsigned          _FifoNumINEPs;
+static unsigned          _FifoNumOUTEPs;
+static unsigned          _FifoNumBytesTx;
+static unsigned          _FifoMaxOUTPacketSize = EP0_MAX_PACKET_SIZE;
+#if BSP_USB_USE_RAM_VECTORS
+static uint32_t          _aRamVectors[NUM_VECTORS] __attribute__ ((aligned (RAM_VECTORS_ALIGN)));
+#endif
+#if BSP_USB_MEASURE_ISR_ENTRY
+static volatile uint32_t _ISRCallTimeStamp;  // DWT cycle counter right before the driver handler is called.
+#endif
 
 /*********************************************************************
 *
@@ -70,15 +85,108 @@ void OTG_HS_IRQHandler(void);
 /*********************************************************************
 *
 *       OTG_FS_IRQHandler
+*
+*  Function description
+*    OTG_FS handler of the flash vector table (STM32F40x_Vectors.s).
+*    With BSP_USB_USE_RAM_VECTORS, BSP_USB_InstallISR_Ex() switches
+*    VTOR to _aRamVectors[] before the interrupt is enabled, and
+*    _OTG_FS_ISR() runs from its slot 16 + OTG_FS_IRQn instead. This
+*    handler then only stays in the flash table, which is active until
+*    the switch.
 */
 void OTG_FS_IRQHandler(void) {
+  BSP_IRQ_ENTER(BSP_IRQ_ID_USB);
+  _ISRTimeStamp = DWT->CYCCNT;
   OS_EnterInterrupt(); // Inform embOS that interrupt code is running
   if (_pfOTG_FSHandler) {
+#if BSP_USB_MEASURE_ISR_ENTRY
+    _ISRCallTimeStamp = DWT->CYCCNT;
+#endif
     (_pfOTG_FSHandler)();
   }
   OS_LeaveInterrupt(); // Inform embOS that interrupt code is left
 }
 
+#if BSP_USB_USE_RAM_VECTORS
+/*********************************************************************
+*
+*       _OTG_FS_ISR
+*
+*  Function description
+*    OTG_FS handler entered into the RAM vector table. Only installed
+*    together with the driver handler, so no NULL check is required.
+*/
+static void _OTG_FS_ISR(void) {
+  BSP_IRQ_ENTER(BSP_IRQ_ID_USB);
+  _ISRTimeStamp = DWT->CYCCNT;
+  OS_EnterNestableInterrupt();
+#if BSP_USB_MEASURE_ISR_ENTRY
+  _ISRCallTimeStamp = DWT->CYCCNT;
+#endif
+  _pfOTG_FSHandler();
+  OS_LeaveNestableInterrupt();
+}
+
+/*********************************************************************
+*
+*       _SetRamVector
+*
+*  Function description
+*    Enters a handler into the RAM vector table. On the first call,
+*    the active vector table is copied into RAM and VTOR is switched
+*    to the copy.
+*/
+static void _SetRamVector(int ISRIndex, void (*pfHandler)(void)) {
+  const uint32_t * pSrc;
+  unsigned         i;
+
+  if (SCB->VTOR != (uint32_t)&_aRamVectors[0]) {
+    pSrc = (const uint32_t *)SCB->VTOR;
+    for (i = 0; i < NUM_VECTORS; i++) {
+      _aRamVectors[i] = pSrc[i];
+    }
+    __DMB();
+    SCB->VTOR = (uint32_t)&_aRamVectors[0];
+  }
+  _aRamVectors[16 + ISRIndex] = (uint32_t)pfHandler;
+  __DSB();
+}
+#endif
+
+/*********************************************************************
+*
+*       _InstallISR
+*
+*  Function description
+*    Installs the driver handler and enables the interrupt.
+*
+*  Parameters
+*    ISRIndex : OTG_FS_IRQn or OTG_HS_IRQn.
+*    pfISR    : Driver handler.
+*    Prio     : 8-bit Cortex-M priority, only the upper __NVIC_PRIO_BITS
+*               are implemented. Limited to OS_IPL_THRESHOLD and below
+*               (numerically >=), the handler calls embOS functions.
+*/
+static void _InstallISR(int ISRIndex, void (*pfISR)(void), int Prio) {
+  if (Prio < OS_IPL_THRESHOLD) {
+    Prio = OS_IPL_THRESHOLD;
+  } else if (Prio > 255) {
+    Prio = 255;
+  }
+  NVIC_DisableIRQ((IRQn_Type)ISRIndex);
+  if (ISRIndex == OTG_FS_IRQn) {
+    _pfOTG_FSHandler = pfISR;
+#if BSP_USB_USE_RAM_VECTORS
+    _SetRamVector(ISRIndex, _OTG_FS_ISR);
+#endif
+  }
+  if (ISRIndex == OTG_HS_IRQn) {
+    _pfOTG_HSHandler = pfISR;
+  }
+  NVIC_SetPriority((IRQn_Type)ISRIndex, (uint32_t)Prio >> (8u - __NVIC_PRIO_BITS));
+  NVIC_EnableIRQ((IRQn_Type)ISRIndex);
+}
+
 /*********************************************************************
 *
 *       OTG_HS_IRQHandler
@@ -96,31 +204,167 @@ void OTG_HS_IRQHandler(void) {
 *       BSP_USB_InstallISR_Ex()
 */
 void BSP_USB_InstallISR_Ex(int ISRIndex, void (*pfISR)(void), int Prio){
-  (void)Prio;
-  if (ISRIndex == OTG_FS_IRQn) {
-    _pfOTG_FSHandler = pfISR;
-  }
-  if (ISRIndex == OTG_HS_IRQn) {
-    _pfOTG_HSHandler = pfISR;
-  }
-  NVIC_SetPriority((IRQn_Type)ISRIndex, (1u << __NVIC_PRIO_BITS) - 2u);
+  _InstallISR(ISRIndex, pfISR, Prio);
+}
+
+/*********************************************************************
+*
+*       BSP_USB_EnableInterrupt()
+*/
+void BSP_USB_EnableInterrupt(int ISRIndex) {
   NVIC_EnableIRQ((IRQn_Type)ISRIndex);
 }
 
+/*********************************************************************
+*
+*       BSP_USB_DisableInterrupt()
+*
+*  Function description
+*    Masks the interrupt in the NVIC. Returns after the mask is in
+*    effect, the handler can not start once this function has returned.
+*/
+void BSP_USB_DisableInterrupt(int ISRIndex) {
+  NVIC_DisableIRQ((IRQn_Type)ISRIndex);
+  __DSB();
+  __ISB();
+}
+
 /*********************************************************************
 *
 *       BSP_USBH_InstallISR_Ex()
 */
 void BSP_USBH_InstallISR_Ex(int ISRIndex, void (*pfISR)(void), int Prio){
-  (void)Prio;
-  if (ISRIndex == OTG_FS_IRQn) {
-    _pfOTG_FSHandler = pfISR;
+  _InstallISR(ISRIndex, pfISR, Prio);
+}
+
+/*********************************************************************
+*
+*       BSP_USB_GetISRTimeStamp()
+*
+*  Function description
+*    Returns the DWT cycle counter sampled at entry of the current
+*    or last OTG_FS interrupt. Used to measure the latency from the
+*    reception of a packet to the reaction of the application.
+*/
+unsigned long BSP_USB_GetISRTimeStamp(void) {
+  return _ISRTimeStamp;
+}
+
+#if BSP_USB_MEASURE_ISR_ENTRY
+/*********************************************************************
+*
+*       BSP_USB_MeasureISREntry()
+*
+*  Function description
+*    Pends the OTG_FS interrupt by software and measures the time until
+*    the driver handler is called. Must be called from a task with the
+*    USB interrupt installed and unmasked.
+*
+*  Return value
+*    Entry overhead in DWT cycles, 0 if the interrupt is not enabled.
+*
+*  Additional information
+*    The driver handler finds no interrupt flag set and returns.
+*/
+unsigned long BSP_USB_MeasureISREntry(void) {
+  uint32_t Start;
+
+  if (NVIC_GetEnableIRQ(OTG_FS_IRQn) == 0u) {
+    return 0;
   }
-  if (ISRIndex == OTG_HS_IRQn) {
-    _pfOTG_HSHandler = pfISR;
+  Start = DWT->CYCCNT;
+  NVIC_SetPendingIRQ(OTG_FS_IRQn);
+  __DSB();
+  __ISB();
+  return _ISRCallTimeStamp - Start;
+}
+#endif
+
+/*********************************************************************
+*
+*       BSP_USB_DelayUs()
+*
+*  Function description
+*    Busy waits on the DWT cycle counter. Meant for the short delays
+*    of the controller setup, which are far below one system tick.
+*/
+void BSP_USB_DelayUs(unsigned Us) {
+  uint32_t Start;
+  uint32_t NumCycles;
+
+  Start     = DWT->CYCCNT;
+  NumCycles = Us * (SystemCoreClock / 1000000u);
+  while ((DWT->CYCCNT - Start) < NumCycles) {
   }
-  NVIC_SetPriority((IRQn_Type)ISRIndex, (1u << __NVIC_PRIO_BITS) - 2u);
-  NVIC_EnableIRQ((IRQn_Type)ISRIndex);
+}
+
+/*********************************************************************
+*
+*       BSP_USB_FIFO_AddEP()
+*
+*  Function description
+*    Accounts an endpoint in the FIFO budget. Call once for every
+*    endpoint added with USBD_AddEPEx().
+*
+*  Parameters
+*    InDir         : USB_DIR_IN (1) or USB_DIR_OUT (0).
+*    MaxPacketSize : Max. packet size of the endpoint.
+*/
+void BSP_USB_FIFO_AddEP(int InDir, unsigned MaxPacketSize) {
+  unsigned NumBytes;
+
+  if (InDir != 0) {
+    NumBytes = (MaxPacketSize + 3u) & ~3u;
+    if (NumBytes < BSP_USB_FIFO_MIN_TX_SIZE) {
+      NumBytes = BSP_USB_FIFO_MIN_TX_SIZE;
+    }
+    _FifoNumBytesTx += NumBytes;
+    _FifoNumINEPs++;
+  } else {
+    if (MaxPacketSize > _FifoMaxOUTPacketSize) {
+      _FifoMaxOUTPacketSize = MaxPacketSize;
+    }
+    _FifoNumOUTEPs++;
+  }
+}
+
+/*********************************************************************
+*
+*       BSP_USB_FIFO_GetBudget()
+*
+*  Function description
+*    Returns the FIFO RAM required by the endpoints accounted
+*    with BSP_USB_FIFO_AddEP().
+*
+*  Return value
+*    == 0: Endpoints fit into the FIFO RAM.
+*    <  0: FIFO RAM exceeded.
+*
+*  Additional information
+*    The FIFOs are allocated by the driver. This is the minimum
+*    requirement according to the reference manual (RM0090, OTG_FS
+*    FIFO RAM allocation), in 32-bit words:
+*      RX: (5 * control EPs + 8) + (largest OUT packet / 4 + 1) + 2 * OUT EPs + 1
+*      TX: max. packet size of each IN endpoint, at least 16 words.
+*/
+int BSP_USB_FIFO_GetBudget(BSP_USB_FIFO_BUDGET * pBudget) {
+  unsigned NumWordsRx;
+  unsigned NumBytesUsed;
+
+  NumWordsRx                = (5u * 1u + 8u) + ((_FifoMaxOUTPacketSize + 3u) / 4u + 1u) + 2u * (_FifoNumOUTEPs + 1u) + 1u;
+  pBudget->NumBytesTotal    = BSP_USB_FIFO_SIZE;
+  pBudget->NumBytesRx       = NumWordsRx * 4u;
+  pBudget->NumBytesTx       = EP0_MAX_PACKET_SIZE + _FifoNumBytesTx;
+  pBudget->NumINEPs         = _FifoNumINEPs;
+  pBudget->NumOUTEPs        = _FifoNumOUTEPs;
+  pBudget->MaxOUTPacketSize = _FifoMaxOUTPacketSize;
+  NumBytesUsed              = pBudget->NumBytesRx + pBudget->NumBytesTx;
+  if (NumBytesUsed > BSP_USB_FIFO_SIZE) {
+    pBudget->NumBytesFree = 0;
+    return -1;
+  }
+  pBudget->NumBytesFree = BSP_USB_FIFO_SIZE - NumBytesUsed;
+  return 0;
 }
 
 /****** End Of File *************************************************/
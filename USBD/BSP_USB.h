@@ -50,6 +50,45 @@ extern "C" {  /* Make sure we have C-declarations in C++ programs */
   #endif
 #endif
 
+//
+// Dedicated FIFO RAM of the OTG_FS controller, shared by the RX FIFO
+// and the TX FIFOs of all IN endpoints.
+//
+#define BSP_USB_FIFO_SIZE          (1280u)
+#define BSP_USB_FIFO_MIN_TX_SIZE   (64u)     // 16 words, minimum depth of a TX FIFO.
+
+//
+// If set to 1, BSP_USB_InstallISR_Ex() copies the vector table into RAM
+// and enters the OTG_FS handler directly, instead of going through
+// OTG_FS_IRQHandler() and a NULL-checked function pointer.
+//
+#ifndef BSP_USB_USE_RAM_VECTORS
+  #define BSP_USB_USE_RAM_VECTORS    (1)
+#endif
+//
+// If set to 1, BSP_USB_MeasureISREntry() measures the cycles from
+// pending the OTG_FS interrupt until the driver handler is called.
+//
+#ifndef BSP_USB_MEASURE_ISR_ENTRY
+  #define BSP_USB_MEASURE_ISR_ENTRY  (0)
+#endif
+
+/*********************************************************************
+*
+*       Types
+*
+**********************************************************************
+*/
+typedef struct {
+  unsigned NumBytesTotal;       // FIFO RAM of the controller.
+  unsigned NumBytesRx;          // Required by the shared RX FIFO.
+  unsigned NumBytesTx;          // Required by the TX FIFOs, including control endpoint 0.
+  unsigned NumBytesFree;        // Left for further endpoints, 0 if the budget is exceeded.
+  unsigned NumINEPs;            // IN endpoints added, without endpoint 0.
+  unsigned NumOUTEPs;           // OUT endpoints added, without endpoint 0.
+  unsigned MaxOUTPacketSize;    // Largest OUT packet including endpoint 0.
+} BSP_USB_FIFO_BUDGET;
+
 /*********************************************************************
 *
 *       USBD
@@ -62,6 +101,11 @@ void BSP_USB_ISR_Handler     (void);
 void BSP_USB_Init            (void);
 void BSP_USB_EnableInterrupt (int ISRIndex);
 void BSP_USB_DisableInterrupt(int ISRIndex);
+unsigned long BSP_USB_GetISRTimeStamp(void);
+unsigned long BSP_USB_MeasureISREntry(void);
+void BSP_USB_DelayUs         (unsigned Us);
+void BSP_USB_FIFO_AddEP      (int InDir, unsigned MaxPacketSize);
+int  BSP_USB_FIFO_GetBudget  (BSP_USB_FIFO_BUDGET * pBudget);
 
 /*********************************************************************
 *
@@ -660,6 +660,10 @@ void     USB_OS_IncDI                  (void);
 void     USB_OS_Signal                 (unsigned EPIndex, unsigned TransactCnt);
 void     USB_OS_Wait                   (unsigned EPIndex, unsigned TransactCnt);
 int      USB_OS_WaitTimed              (unsigned EPIndex, unsigned ms, unsigned TransactCnt);
+int      USB_OS_WaitTimed_us           (unsigned EPIndex, unsigned long Us, unsigned TransactCnt);
+void     USB_OS_Delay_us               (unsigned long Us);
+U32      USB_OS_GetWakeLatency         (U32 * pLast, U32 * pMax);   // optional function, activate with USB_OS_MEASURE_WAKE_LATENCY
+U32      USB_OS_GetMaxLockTime         (void);                      // optional function, activate with USB_OS_MEASURE_LOCK_TIME
 void     USB_OS_DeInit                 (void);
 #else
 void     USB_OS_Signal                 (unsigned EPIndex);
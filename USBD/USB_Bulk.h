@@ -0,0 +1,60 @@
+/*********************************************************************
+-------------------------- END-OF-HEADER -----------------------------
+File    : USB_Bulk.h
+Purpose : Public header of the vendor specific bulk component.
+          Only the functions used by the samples are declared,
+          the component itself is part of the emUSB-Device library.
+*/
+
+#ifndef USB_BULK_H          /* Avoid multiple inclusion */
+#define USB_BULK_H
+
+#include "SEGGER.h"
+
+#if defined(__cplusplus)
+extern "C" {     /* Make sure we have C-declarations in C++ programs */
+#endif
+
+/*********************************************************************
+*
+*       Config defaults
+*
+**********************************************************************
+*/
+typedef int USB_BULK_HANDLE;
+
+/*********************************************************************
+*
+*       Types
+*
+**********************************************************************
+*/
+/*********************************************************************
+*
+*       USB_BULK_INIT_DATA
+*
+*   Description
+*     Initialization data for the vendor specific interface.
+*     The interface has class, subclass and protocol 0xFF.
+*/
+typedef struct {
+  U8 EPIn;             // Bulk IN endpoint returned by USBD_AddEPEx(), 0 if not used.
+  U8 EPOut;            // Bulk OUT endpoint returned by USBD_AddEPEx(), 0 if not used.
+} USB_BULK_INIT_DATA;
+
+/*********************************************************************
+*
+*       API functions
+*
+**********************************************************************
+*/
+void            USBD_BULK_Init                  (void);
+USB_BULK_HANDLE USBD_BULK_Add                   (const USB_BULK_INIT_DATA * pInitData);
+
+#if defined(__cplusplus)
+  }              /* Make sure we have C-declarations in C++ programs */
+#endif
+
+#endif                 /* Avoid multiple inclusion */
+
+/*************************** End of file ****************************/
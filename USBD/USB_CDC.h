@@ -0,0 +1,60 @@
+/*********************************************************************
+-------------------------- END-OF-HEADER -----------------------------
+File    : USB_CDC.h
+Purpose : Public header of the communication device class.
+          Only the functions used by the samples are declared,
+          the component itself is part of the emUSB-Device library.
+*/
+
+#ifndef USB_CDC_H          /* Avoid multiple inclusion */
+#define USB_CDC_H
+
+#include "SEGGER.h"
+
+#if defined(__cplusplus)
+extern "C" {     /* Make sure we have C-declarations in C++ programs */
+#endif
+
+/*********************************************************************
+*
+*       Config defaults
+*
+**********************************************************************
+*/
+typedef int USB_CDC_HANDLE;
+
+/*********************************************************************
+*
+*       Types
+*
+**********************************************************************
+*/
+/*********************************************************************
+*
+*       USB_CDC_INIT_DATA
+*
+*   Description
+*     Initialization data for the CDC-ACM interfaces
+*     (communication interface and data interface).
+*/
+typedef struct {
+  U8 EPIn;             // Bulk IN endpoint returned by USBD_AddEPEx().
+  U8 EPOut;            // Bulk OUT endpoint returned by USBD_AddEPEx().
+  U8 EPInt;            // Interrupt IN endpoint for notifications returned by USBD_AddEPEx().
+} USB_CDC_INIT_DATA;
+
+/*********************************************************************
+*
+*       API functions
+*
+**********************************************************************
+*/
+USB_CDC_HANDLE USBD_CDC_Add                    (const USB_CDC_INIT_DATA * pInitData);
+
+#if defined(__cplusplus)
+  }              /* Make sure we have C-declarations in C++ programs */
+#endif
+
+#endif                 /* Avoid multiple inclusion */
+
+/*************************** End of file ****************************/
@@ -47,6 +47,27 @@ Purpose : Config file. Modify to reflect your configuration
   #endif
 #endif
 
+//
+// If set to 1, critical sections of the stack only mask the OTG_FS
+// interrupt (USBD_X_DisableInterrupt() in USB_Config_ST_STM32F407.c)
+// instead of all embOS interrupts, SysTick and UART are serviced
+// meanwhile. USB_OS_IncDI() then does nothing in any interrupt, so no
+// interrupt other than OTG_FS may call the stack, HID_RQ_*() or
+// HID_SCHED_*(): TIM2 and USART3 preempt OTG_FS (BSP_IRQ.h) and the
+// SysTick level handlers are preempted by it. USBD_OS_STACK_ONLY_IN_USB_ISR
+// has to be set to 1 to confirm this, debug builds check it at run time.
+// SHOW_IRQ_LATENCY in USB_HID_Keyboard.c measures the effect on USART3.
+//
+#ifndef USBD_OS_USE_USBD_X_INTERRUPT
+  #define USBD_OS_USE_USBD_X_INTERRUPT  0
+#endif
+#ifndef USBD_OS_STACK_ONLY_IN_USB_ISR
+  #define USBD_OS_STACK_ONLY_IN_USB_ISR 0
+#endif
+#if (USBD_OS_USE_USBD_X_INTERRUPT > 0) && (USBD_OS_STACK_ONLY_IN_USB_ISR == 0)
+  #error "USBD_OS_USE_USBD_X_INTERRUPT leaves the stack unprotected against other interrupts, set USBD_OS_STACK_ONLY_IN_USB_ISR once none of them calls it"
+#endif
+
 //
 // Configure profiling support.
 //
@@ -20,6 +20,8 @@ Purpose : Config file for ST MB1045.
 
 #include "USB.h"
 #include "BSP_USB.h"
+#include "BSP_BOOT.h"
+#include "BSP_IRQ.h"
 
 /*********************************************************************
 *
@@ -28,7 +30,16 @@ Purpose : Config file for ST MB1045.
 **********************************************************************
 */
 #define USB_ISR_ID    (67)
-#define USB_ISR_PRIO  254
+#define USB_ISR_PRIO  BSP_IRQ_PRIO_8BIT(BSP_IRQ_PRIO_USB)
+//
+// Delays of the OTG_FS controller setup [us]. The reference manual
+// (RM0090, RCC) requires no reset pulse width and only two AHB cycles
+// between enabling a peripheral clock and accessing the peripheral,
+// the read-back of the RCC register covers that. The core soft reset
+// and the wait for AHB idle are done by the driver.
+//
+#define OTG_RESET_HOLD_US      1u
+#define OTG_RESET_RECOVERY_US  10u
 
 /*********************************************************************
 *
@@ -125,15 +136,56 @@ Purpose : Config file for ST MB1045.
 *       _EnableISR
 */
 static void _EnableISR(USB_ISR_HANDLER * pfISRHandler) {
+  BSP_BOOT_Mark(BSP_BOOT_USBD_START);
   BSP_USB_InstallISR_Ex(USB_ISR_ID, pfISRHandler, USB_ISR_PRIO);
 }
 
+/*********************************************************************
+*
+*       _OnStateChange
+*
+*  Function description
+*    Records the enumeration milestones of the boot time line.
+*/
+static void _OnStateChange(void * pContext, U8 NewState) {
+  USB_USE_PARA(pContext);
+  if (NewState & USB_STAT_ADDRESSED) {
+    BSP_BOOT_Mark(BSP_BOOT_USB_ADDRESSED);
+  }
+  if (NewState & USB_STAT_CONFIGURED) {
+    BSP_BOOT_Mark(BSP_BOOT_USB_CONFIGURED);
+  }
+}
+
 /*********************************************************************
 *
 *       Public code
 *
 **********************************************************************
 */
+/*********************************************************************
+*
+*       USBD_X_EnableInterrupt
+*
+*  Function description
+*    Unmasks the OTG_FS interrupt. Used by the OS layer to leave a
+*    critical section of the stack if USBD_OS_USE_USBD_X_INTERRUPT is set.
+*/
+void USBD_X_EnableInterrupt(void) {
+  BSP_USB_EnableInterrupt(USB_ISR_ID);
+}
+
+/*********************************************************************
+*
+*       USBD_X_DisableInterrupt
+*
+*  Function description
+*    Masks the OTG_FS interrupt only, all other interrupts stay enabled.
+*/
+void USBD_X_DisableInterrupt(void) {
+  BSP_USB_DisableInterrupt(USB_ISR_ID);
+}
+
 /*********************************************************************
 *
 *       Setup which target USB driver shall be used
@@ -144,8 +196,9 @@ static void _EnableISR(USB_ISR_HANDLER * pfISRHandler) {
 *       USBD_X_Config
 */
 void USBD_X_Config(void) {
-  volatile unsigned int v;
+  static USB_HOOK _UsbStateHook;
 
+  BSP_BOOT_Mark(BSP_BOOT_USBD_CONFIG);
   RCC_AHB1ENR |= 0
               | (1 <<  0)  // GPIOAEN: IO port B clock enable
               ;
@@ -157,21 +210,25 @@ void USBD_X_Config(void) {
   GPIOA_PUPDR   &=  ~(0x0FUL << 22);
   GPIOA_AFRH     =   (GPIOA_AFRH  & ~(0xFFUL << 12)) | (0xAAUL << 12);
 
-  // Enable clock for OTG_HS.
+  // Enable clock for OTG_FS.
   RCC_AHB2ENR    |=  (1UL << 7);
-  for (v = 0; v < 1000000; v++);
+  (void)RCC_AHB2ENR;                  // Read back, ensures the clock is running before the next access.
 
   // Reset OTGFS clock.
 
   RCC_AHB2RSTR   |=  (1UL << 7);
-  for (v = 0; v < 5000000; v++);
+  (void)RCC_AHB2RSTR;
+  BSP_USB_DelayUs(OTG_RESET_HOLD_US);
   RCC_AHB2RSTR   &= ~(1UL << 7);
-  for (v = 0; v < 4000000; v++);
+  (void)RCC_AHB2RSTR;
+  BSP_USB_DelayUs(OTG_RESET_RECOVERY_US);
 
   // Add driver.
 
   USBD_AddDriver(&USB_Driver_ST_STM32F4xxFS);
   USBD_SetISRMgmFuncs(_EnableISR, USB_OS_IncDI, USB_OS_DecRI);
+  USBD_RegisterSCHook(&_UsbStateHook, _OnStateChange, NULL);
+  BSP_BOOT_Mark(BSP_BOOT_USBD_CONFIG_END);
 }
 
 /*************************** End of file ****************************/
@@ -30,6 +30,8 @@ Purpose : Kernel abstraction for embOS version >= 5.0
 
 #include "USB.h"
 #include "RTOS.h"
+#include "BSP_TIME.h"
+#include "BSP_TIMER.h"
 
 /*********************************************************************
 *
@@ -43,6 +45,54 @@ Purpose : Kernel abstraction for embOS version >= 5.0
 #ifndef USB_OS_TICK_RATE_HZ
   #define USB_OS_TICK_RATE_HZ     1000u
 #endif
+//
+// Signaling of transfer completions:
+//   1: One auto-reset event object and one transaction counter per endpoint.
+//      USB_OS_Signal() stores the counter and sets the event, a waiting
+//      task is woken once, nothing is copied.
+//   0: One mailbox per endpoint, as shipped with emUSB-Device.
+//
+#ifndef USB_OS_USE_EVENT_OBJ
+  #define USB_OS_USE_EVENT_OBJ    1
+#endif
+//
+// If set to 1, the time from USB_OS_Signal() until the waiting task
+// runs is measured with the DWT cycle counter, see USB_OS_GetWakeLatency().
+// Requires USB_OS_USE_EVENT_OBJ.
+//
+#ifndef USB_OS_MEASURE_WAKE_LATENCY
+  #define USB_OS_MEASURE_WAKE_LATENCY  0
+#endif
+//
+// If set to 1, the longest critical section of the stack (outermost
+// USB_OS_IncDI() until USB_OS_DecRI()) is measured with the DWT cycle
+// counter, see USB_OS_GetMaxLockTime(). Without USBD_OS_USE_USBD_X_INTERRUPT
+// this is the latency the stack adds to all embOS interrupts.
+//
+#ifndef USB_OS_MEASURE_LOCK_TIME
+  #define USB_OS_MEASURE_LOCK_TIME     0
+#endif
+
+//
+// If set to 1, timeouts use the microsecond one-shot timers of
+// BSP_TIMER.c and are exact instead of rounded up to embOS ticks.
+// Timeouts above USB_OS_HW_TIMER_MAX_MS still use embOS ticks.
+// Requires USB_OS_USE_EVENT_OBJ.
+//
+#ifndef USB_OS_USE_HW_TIMER
+  #define USB_OS_USE_HW_TIMER          1
+#endif
+#ifndef USB_OS_HW_TIMER_MAX_MS
+  #define USB_OS_HW_TIMER_MAX_MS       1000u
+#endif
+
+#if USB_OS_USE_HW_TIMER && (USB_OS_USE_EVENT_OBJ == 0)
+  #error "USB_OS_USE_HW_TIMER requires USB_OS_USE_EVENT_OBJ"
+#endif
+
+#if USB_OS_MEASURE_WAKE_LATENCY || USB_OS_MEASURE_LOCK_TIME || (USBD_OS_USE_USBD_X_INTERRUPT > 0)
+  #include "stm32f4xx.h"   // DWT cycle counter, IPSR.
+#endif
 
 #if !defined(USB_IS_IN_INT) && USBD_OS_USE_USBD_X_INTERRUPT > 0
   #if USBD_OS_USE_ISR_FLAG
@@ -52,6 +102,19 @@ Purpose : Kernel abstraction for embOS version >= 5.0
   #endif
 #endif
 
+/*********************************************************************
+*
+*       Types
+*
+**********************************************************************
+*/
+#if USB_OS_USE_HW_TIMER
+typedef struct {
+  OS_EVENT *  pEvent;                // Event the waiting task blocks on.
+  volatile U8 IsExpired;             // Set by the one-shot timer.
+} TIMED_WAIT;
+#endif
+
 /*********************************************************************
 *
 *       Static data
@@ -59,11 +122,163 @@ Purpose : Kernel abstraction for embOS version >= 5.0
 **********************************************************************
 */
 
+#if USB_OS_USE_EVENT_OBJ
+static OS_EVENT     _aEvent[USB_NUM_EPS + USB_EXTRA_EVENTS];
+static volatile U32 _aTransactCnt[USB_NUM_EPS + USB_EXTRA_EVENTS];   // Last transaction signaled per endpoint. A 32-bit store is atomic.
+#if USB_OS_MEASURE_WAKE_LATENCY
+static volatile U32 _aSignalCycles[USB_NUM_EPS + USB_EXTRA_EVENTS];
+static U32          _WakeCyclesLast;
+static U32          _WakeCyclesMax;
+static U32          _NumWakes;
+#endif
+#else
 static OS_MAILBOX _aMailBox[USB_NUM_EPS + USB_EXTRA_EVENTS];
 static U32        _aMBBuffer[USB_NUM_EPS + USB_EXTRA_EVENTS];
+#endif
 #if USBD_OS_USE_USBD_X_INTERRUPT > 0
   static OS_MUTEX _Sema;
 #endif
+#if USB_OS_MEASURE_LOCK_TIME
+static unsigned     _LockCnt;
+static U32          _LockStartCycles;
+static U32          _LockCyclesMax;
+#endif
+
+/*********************************************************************
+*
+*       Static code
+*
+**********************************************************************
+*/
+#if USB_OS_MEASURE_LOCK_TIME
+/*********************************************************************
+*
+*       _OnLock
+*
+*  Function description
+*    Starts the measurement when the outermost critical section is entered.
+*/
+static void _OnLock(void) {
+  if (_LockCnt++ == 0u) {
+    _LockStartCycles = DWT->CYCCNT;
+  }
+}
+
+/*********************************************************************
+*
+*       _OnUnlock
+*
+*  Function description
+*    Ends the measurement when the outermost critical section is left.
+*/
+static void _OnUnlock(void) {
+  U32 Cycles;
+
+  if (--_LockCnt == 0u) {
+    Cycles = DWT->CYCCNT - _LockStartCycles;
+    if (Cycles > _LockCyclesMax) {
+      _LockCyclesMax = Cycles;
+    }
+  }
+}
+#endif
+
+#if USB_OS_USE_EVENT_OBJ
+/*********************************************************************
+*
+*       _IsSignaled
+*
+*  Function description
+*    Checks whether a transaction has been signaled.
+*/
+static int _IsSignaled(unsigned EPIndex, unsigned TransactCnt) {
+  return _aTransactCnt[EPIndex] == (U32)TransactCnt;
+}
+
+#if USB_OS_MEASURE_WAKE_LATENCY
+/*********************************************************************
+*
+*       _CountWake
+*
+*  Function description
+*    Records the wake latency after a task has been blocked.
+*/
+static void _CountWake(unsigned EPIndex) {
+  U32 Cycles;
+
+  Cycles          = DWT->CYCCNT - _aSignalCycles[EPIndex];
+  _WakeCyclesLast = Cycles;
+  if (Cycles > _WakeCyclesMax) {
+    _WakeCyclesMax = Cycles;
+  }
+  _NumWakes++;
+}
+#endif
+#endif
+
+/*********************************************************************
+*
+*       _WaitTimedTicks
+*
+*  Function description
+*    USB_OS_WaitTimed() with the timeout rounded up to embOS ticks.
+*/
+static int _WaitTimedTicks(unsigned EPIndex, unsigned ms, unsigned TransactCnt) {
+#if USB_OS_USE_EVENT_OBJ
+  OS_TIME Timeout;
+  OS_TIME Start;
+  OS_TIME Elapsed;
+
+#if USB_OS_TICK_RATE_HZ != 1000u
+  ms = (ms * USB_OS_TICK_RATE_HZ + 999u) / 1000u;
+#endif
+  Timeout = (OS_TIME)ms;
+  Start   = OS_TIME_GetTicks();
+  while (_IsSignaled(EPIndex, TransactCnt) == 0) {
+    Elapsed = OS_TIME_GetTicks() - Start;
+    if (Elapsed >= Timeout) {
+      return 1;
+    }
+    if (OS_EVENT_GetTimed(&_aEvent[EPIndex], Timeout - Elapsed) != 0) {
+      return _IsSignaled(EPIndex, TransactCnt) ? 0 : 1;
+    }
+#if USB_OS_MEASURE_WAKE_LATENCY
+    if (_IsSignaled(EPIndex, TransactCnt)) {
+      _CountWake(EPIndex);
+    }
+#endif
+  }
+  return 0;
+#else
+  U32 Tmp;
+  char r;
+
+#if USB_OS_TICK_RATE_HZ != 1000u
+  ms = (ms * USB_OS_TICK_RATE_HZ + 999u) / 1000u;
+#endif
+  do {
+    r = OS_MAILBOX_GetTimed(&_aMailBox[EPIndex], &Tmp, ms);
+  } while (r == '\0' && Tmp != TransactCnt);
+  return r;
+#endif
+}
+
+#if USB_OS_USE_HW_TIMER
+/*********************************************************************
+*
+*       _OnTimeout
+*
+*  Function description
+*    Called from the TIM2 interrupt when a timed wait expires.
+*/
+static void _OnTimeout(void * pContext) {
+  TIMED_WAIT * pWait;
+
+  pWait            = (TIMED_WAIT *)pContext;
+  pWait->IsExpired = 1;
+  OS_EVENT_Set(pWait->pEvent);
+}
+#endif
 
 /*********************************************************************
 *
@@ -86,9 +301,16 @@ void USB_OS_Init(void) {
     USB_PANIC("Setting of USB_OS_TICK_RATE_HZ does not match OS configuration");
   }
 #endif
+#if USB_OS_USE_EVENT_OBJ
+  for (i = 0; i < SEGGER_COUNTOF(_aEvent); i++) {
+    OS_EVENT_CreateEx(&_aEvent[i], OS_EVENT_RESET_MODE_AUTO);
+    _aTransactCnt[i] = 0xFFFFFFFFu;                // Matches no transaction.
+  }
+#else
   for (i = 0; i < SEGGER_COUNTOF(_aMailBox); i++) {
     OS_MAILBOX_Create(_aMailBox + i, sizeof(U32), 1, _aMBBuffer + i);
   }
+#endif
 #if USBD_OS_USE_USBD_X_INTERRUPT > 0
   OS_MUTEX_Create(&_Sema);
 #endif
@@ -105,9 +327,15 @@ void USB_OS_Init(void) {
 void USB_OS_DeInit(void) {
   unsigned i;
 
+#if USB_OS_USE_EVENT_OBJ
+  for (i = 0; i < SEGGER_COUNTOF(_aEvent); i++) {
+    OS_EVENT_Delete(&_aEvent[i]);
+  }
+#else
   for (i = 0; i < SEGGER_COUNTOF(_aMailBox); i++) {
     OS_MAILBOX_Delete(&_aMailBox[i]);
   }
+#endif
 #if USBD_OS_USE_USBD_X_INTERRUPT > 0
   OS_MUTEX_Delete(&_Sema);
 #endif
@@ -129,11 +357,19 @@ void USB_OS_DeInit(void) {
 *    service routine.
 */
 void USB_OS_Signal(unsigned EPIndex, unsigned TransactCnt) {
+#if USB_OS_USE_EVENT_OBJ
+#if USB_OS_MEASURE_WAKE_LATENCY
+  _aSignalCycles[EPIndex] = DWT->CYCCNT;
+#endif
+  _aTransactCnt[EPIndex] = TransactCnt;
+  OS_EVENT_Set(&_aEvent[EPIndex]);
+#else
   U32 Tmp = TransactCnt;
 
   while (OS_MAILBOX_Put(&_aMailBox[EPIndex], &Tmp) != 0) {
     OS_MAILBOX_Clear(&_aMailBox[EPIndex]);
   }
+#endif
 }
 
 /*********************************************************************
@@ -154,11 +390,26 @@ void USB_OS_Signal(unsigned EPIndex, unsigned TransactCnt) {
 *    This routine is called from a task.
 */
 void USB_OS_Wait(unsigned EPIndex, unsigned TransactCnt) {
+#if USB_OS_USE_EVENT_OBJ
+  //
+  // The event may still be set by an earlier transaction which nobody
+  // waited for. This costs one extra pass, never a retry in the ISR.
+  //
+  while (_IsSignaled(EPIndex, TransactCnt) == 0) {
+    OS_EVENT_GetBlocked(&_aEvent[EPIndex]);
+#if USB_OS_MEASURE_WAKE_LATENCY
+    if (_IsSignaled(EPIndex, TransactCnt)) {
+      _CountWake(EPIndex);
+    }
+#endif
+  }
+#else
   U32 Tmp;
 
   do {
     OS_MAILBOX_GetBlocked(&_aMailBox[EPIndex], &Tmp);
   } while (Tmp != TransactCnt);
+#endif
 }
 
 /*********************************************************************
@@ -186,17 +437,97 @@ void USB_OS_Wait(unsigned EPIndex, unsigned TransactCnt) {
 *    routines.
 */
 int USB_OS_WaitTimed(unsigned EPIndex, unsigned ms, unsigned TransactCnt) {
-  U32 Tmp;
-  char r;
+#if USB_OS_USE_HW_TIMER
+  if (ms <= USB_OS_HW_TIMER_MAX_MS) {
+    return USB_OS_WaitTimed_us(EPIndex, (unsigned long)ms * 1000u, TransactCnt);
+  }
+#endif
+  return _WaitTimedTicks(EPIndex, ms, TransactCnt);
+}
 
-#if USB_OS_TICK_RATE_HZ != 1000u
-  ms = (ms * USB_OS_TICK_RATE_HZ + 999u) / 1000u;
+/*********************************************************************
+*
+*        USB_OS_WaitTimed_us
+*
+*  Function description
+*    Same as USB_OS_WaitTimed() with a timeout in microseconds.
+*
+*  Return value
+*    == 0:        Task was signaled within the given timeout.
+*    == 1:        Timeout occurred.
+*
+*  Additional information
+*    Without USB_OS_USE_HW_TIMER, or if all one-shot timers are in use,
+*    the timeout is rounded up to embOS ticks.
+*/
+int USB_OS_WaitTimed_us(unsigned EPIndex, unsigned long Us, unsigned TransactCnt) {
+#if USB_OS_USE_HW_TIMER
+  TIMED_WAIT Wait;
+  int        hTimer;
+  int        r;
+
+  if (_IsSignaled(EPIndex, TransactCnt)) {
+    return 0;
+  }
+  Wait.pEvent    = &_aEvent[EPIndex];
+  Wait.IsExpired = 0;
+  hTimer = BSP_TIMER_Start(Us, _OnTimeout, &Wait);
+  if (hTimer >= 0) {
+    r = 0;
+    while (_IsSignaled(EPIndex, TransactCnt) == 0) {
+      if (Wait.IsExpired) {
+        r = 1;
+        break;
+      }
+      OS_EVENT_GetBlocked(Wait.pEvent);
+#if USB_OS_MEASURE_WAKE_LATENCY
+      if (_IsSignaled(EPIndex, TransactCnt)) {
+        _CountWake(EPIndex);
+      }
 #endif
-  do {
-    r = OS_MAILBOX_GetTimed(&_aMailBox[EPIndex], &Tmp, ms);
-  } while (r == '\0' && Tmp != TransactCnt);
-  return r;
+    }
+    BSP_TIMER_Stop(hTimer);
+    return r;
+  }
+#endif
+  return _WaitTimedTicks(EPIndex, (unsigned)((Us + 999u) / 1000u), TransactCnt);
+}
+
+#if USB_OS_MEASURE_LOCK_TIME
+/*********************************************************************
+*
+*        USB_OS_GetMaxLockTime
+*
+*  Function description
+*    Returns the longest critical section of the stack in DWT cycles.
+*/
+U32 USB_OS_GetMaxLockTime(void) {
+  return _LockCyclesMax;
+}
+#endif
+
+#if USB_OS_USE_EVENT_OBJ && USB_OS_MEASURE_WAKE_LATENCY
+/*********************************************************************
+*
+*        USB_OS_GetWakeLatency
+*
+*  Function description
+*    Returns the time from USB_OS_Signal() until the waiting task ran,
+*    measured for every wait which actually blocked.
+*
+*  Parameters
+*    pLast: Receives the last latency in DWT cycles.
+*    pMax:  Receives the max. latency in DWT cycles.
+*
+*  Return value
+*    Number of measured wakes.
+*/
+U32 USB_OS_GetWakeLatency(U32 * pLast, U32 * pMax) {
+  *pLast = _WakeCyclesLast;
+  *pMax  = _WakeCyclesMax;
+  return _NumWakes;
 }
+#endif
 
 /*********************************************************************
 *
@@ -223,11 +554,17 @@ void USB_OS_DecRI(void) {
 #if USBD_OS_USE_USBD_X_INTERRUPT > 0
   if (!USB_IS_IN_INT()) {
     if (OS_MUTEX_GetValue(&_Sema) == 1) {
+#if USB_OS_MEASURE_LOCK_TIME
+      _OnUnlock();
+#endif
       USBD_X_EnableInterrupt();
     }
     OS_MUTEX_Unlock(&_Sema);
   }
 #else
+#if USB_OS_MEASURE_LOCK_TIME
+  _OnUnlock();
+#endif
   OS_INT_DecRI();
 #endif
 }
@@ -257,10 +594,22 @@ void USB_OS_IncDI(void) {
   if (!USB_IS_IN_INT()) {
     if (OS_MUTEX_LockBlocked(&_Sema) == 1) {
       USBD_X_DisableInterrupt();
+#if USB_OS_MEASURE_LOCK_TIME
+      _OnLock();
+#endif
     }
+  } else if (__get_IPSR() != (U32)((int)OTG_FS_IRQn + 16)) {
+    //
+    // Nothing is locked here, any other interrupt may preempt OTG_FS
+    // or be preempted by it. See USBD_OS_STACK_ONLY_IN_USB_ISR.
+    //
+    USB_PANIC("USB_OS_IncDI: Stack called from an interrupt other than OTG_FS");
   }
 #else
   OS_INT_IncDI();
+#if USB_OS_MEASURE_LOCK_TIME
+  _OnLock();
+#endif
 #endif
 }
 
@@ -281,6 +630,42 @@ void USB_OS_Delay(int ms) {
   OS_TASK_Delay(ms);
 }
 
+/*********************************************************************
+*
+*       USB_OS_Delay_us
+*
+*  Function description
+*    Delays for a given number of microseconds.
+*
+*  Additional information
+*    Without USB_OS_USE_HW_TIMER, or if all one-shot timers are in use,
+*    the delay is rounded up to embOS ticks.
+*/
+void USB_OS_Delay_us(unsigned long Us) {
+#if USB_OS_USE_HW_TIMER
+  OS_EVENT   Event;
+  TIMED_WAIT Wait;
+  int        hTimer;
+
+  if (Us <= (unsigned long)USB_OS_HW_TIMER_MAX_MS * 1000u) {
+    OS_EVENT_CreateEx(&Event, OS_EVENT_RESET_MODE_AUTO);
+    Wait.pEvent    = &Event;
+    Wait.IsExpired = 0;
+    hTimer = BSP_TIMER_Start(Us, _OnTimeout, &Wait);
+    if (hTimer >= 0) {
+      while (Wait.IsExpired == 0u) {
+        OS_EVENT_GetBlocked(&Event);
+      }
+    }
+    OS_EVENT_Delete(&Event);
+    if (hTimer >= 0) {
+      return;
+    }
+  }
+#endif
+  USB_OS_Delay((int)((Us + 999u) / 1000u));
+}
+
 /*********************************************************************
 *
 *        USB_OS_GetTickCnt
@@ -293,25 +678,13 @@ void USB_OS_Delay(int ms) {
 */
 U32 USB_OS_GetTickCnt(void) {
 #if USB_OS_TICK_RATE_HZ > 1000
-  U32        Ticks;
-  static U32 HighTickBits = 0;
-  static U32 LastTicks    = 0;
-
-  Ticks = OS_TIME_GetTicks32();
   //
-  // The value returned must use the full value range of an U32 before wrapping around,
-  // in order to allow calculation of correct time differences.
-  // When dividing OS_TIME_GetTicks32(), the upper bits are lost,
-  // so we have to simulate them.
+  // Taken from the 64-bit time base instead of dividing the tick counter
+  // and simulating its upper bits. Lock-free, so the stack may call this
+  // from its interrupt while a task does the same. The lower 32 bits use
+  // the full value range of an U32 before wrapping around.
   //
-  if (Ticks < LastTicks) {
-    //
-    // Wrap around of OS_TIME_GetTicks32() value occurred
-    //
-    HighTickBits += 0xFFFFFFFF / (USB_OS_TICK_RATE_HZ / 1000) + 1;
-  }
-  LastTicks = Ticks;
-  return HighTickBits + Ticks / (USB_OS_TICK_RATE_HZ / 1000);
+  return (U32)BSP_TIME_Get_ms64();
 #else
   //
   // Case USB_OS_TICK_RATE_HZ <= 1000: